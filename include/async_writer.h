@@ -0,0 +1,124 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+#ifndef ASYNC_WRITER_H
+#define ASYNC_WRITER_H
+
+#include <stdio.h>
+#include <vector>
+#include <atomic>
+#include <thread>
+
+#include "spsc_queue.h"
+
+#define ASYNC_BUFFERS 8 ///<Default number of buffers
+#define ASYNC_BUFFER_SIZE (1<<16) ///<Default size of each buffer in bytes
+
+
+/*! AsyncWriter class
+ * Moves file output out of the simulation thread. Records are copied into preallocated buffers (one in use per file)
+ * and full buffers are handed to a dedicated I/O thread through a lock-free queue, empty buffers come back through a second one.
+ * Memory is bounded by the number of buffers: when all of them are waiting to be written the producer waits (backpressure).
+ * write, printf and flush must be called from a single thread.
+ */
+class AsyncWriter
+{
+	/*!
+	 Output buffer, belongs either to the producer or to the I/O thread.
+	*/
+	struct Buffer
+	{
+		FILE * f; ///<Destination file
+		size_t used; ///<Bytes in use
+		char * data; ///<Buffer memory
+	};
+
+	/*!
+	 File being written and its current buffer.
+	*/
+	struct Stream
+	{
+		FILE * f; ///<File stream
+		int current; ///<Buffer being filled
+	};
+
+	size_t buffer_size; ///<Size of each buffer in bytes
+	std::vector<char> storage; ///<Memory of all buffers
+	std::vector<Buffer> buffers; ///<Buffers
+	std::vector<Stream> streams; ///<Files in use since the last flush
+	std::vector<int> spare; ///<Empty buffers owned by the producer
+
+	SPSCQueue<int> full; ///<Buffers ready to be written, producer to I/O thread
+	SPSCQueue<int> written; ///<Written buffers, I/O thread to producer
+	std::atomic<int> pending; ///<Buffers handed to the I/O thread and not yet written
+	std::atomic<bool> running; ///<False when the I/O thread must finish
+	long stalls; ///<Times the producer waited for a free buffer
+	std::thread io; ///<I/O thread
+
+public:
+	/*! AsyncWriter constructor
+	* @brief Allocates the buffers and starts the I/O thread.
+	* @param n_buffers Number of buffers, at least one more than the number of files written at the same time
+	* @param buffer_size Size of each buffer in bytes
+	*/
+	AsyncWriter(int n_buffers=ASYNC_BUFFERS,size_t buffer_size=ASYNC_BUFFER_SIZE);
+
+	/*!
+	* @brief Writes the pending data and stops the I/O thread.
+	*/
+	~AsyncWriter();
+
+	/*!
+	* @brief Copies n bytes to the buffer of f.
+	* @param f File stream
+	* @param data Bytes to write
+	* @param n Number of bytes
+	*/
+	void write(FILE * f,const void * data,size_t n);
+
+	/*!
+	* @brief Formatted output to the buffer of f, same as fprintf.
+	* @param f File stream
+	* @param fmt printf format
+	* @return Number of characters written
+	*/
+	int printf(FILE * f,const char * fmt,...) __attribute__((format(printf,3,4)));
+
+	/*!
+	* @brief Hands all buffers to the I/O thread, waits until they are written and flushes the files.
+	* Files can be closed after it returns.
+	*/
+	void flush();
+
+	long getStalls(){return stalls;} ///< Number of waits for a free buffer getter
+
+private:
+	/*!
+	* @brief Returns the stream of f, adding it if it is not in use.
+	*/
+	Stream & stream(FILE * f);
+
+	/*!
+	* @brief Gets an empty buffer, waiting for the I/O thread if there is none.
+	* @return Buffer index
+	*/
+	int acquire();
+
+	/*!
+	* @brief Hands the current buffer of s to the I/O thread and acquires a new one.
+	*/
+	void submit(Stream & s);
+
+	/*!
+	* @brief I/O thread loop.
+	*/
+	void run();
+};
+
+#endif
@@ -0,0 +1,111 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+#ifndef BURST_ANALYSIS_H
+#define BURST_ANALYSIS_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <deque>
+
+#include "spike_events.h"
+
+#define BURST_ISI 500.0 ///<Default maximum interval between spikes of the same burst in ms
+
+
+/*! BurstAnalysis class
+ * Online analysis of the sequence of bursts (e.g. N1M, N2v and N3t), fed with the spike events as a SpikeSink and passing them on to another sink.
+ * Spikes of a neuron closer than max_isi belong to the same burst. A cycle goes from the start of a burst of the first neuron of the sequence
+ * (the reference) to the start of its next burst, and in each cycle the burst of each neuron is the first one starting after the burst of the
+ * previous neuron. One line is written per cycle:
+ *	cycle t <neuron>_period <neuron>_duration <neuron>_spikes ... <a>_<b>_interval <a>_<b>_delay ...
+ * Periods are measured between the burst starts of a neuron in consecutive cycles, intervals between the starts of consecutive neurons and delays
+ * from the end of one burst to the start of the next one. The last pair goes from the last neuron to the reference burst of the next cycle.
+ * Values that can not be measured (e.g. a neuron without burst in a cycle) are written as nan. Times in ms.
+ * A cycle is written once its bursts are closed, i.e. after the next spike of each neuron or at finish. Only the bursts of the current cycles are kept.
+ */
+class BurstAnalysis : public SpikeSink
+{
+	/*!
+	 Burst of a neuron.
+	*/
+	struct Burst
+	{
+		double start; ///<First spike time
+		double end; ///<Last spike time
+		int spikes; ///<Number of spikes
+	};
+
+	std::vector<int> seq; ///<Neurons of the sequence, the first one is the reference
+	std::vector<std::string> names; ///<Names of the neurons of the sequence
+	std::vector<int> seq_index; ///<Position in seq of each neuron, -1 if not analysed
+	double max_isi; ///<Maximum interval between spikes of a burst
+	std::vector<std::deque<Burst> > closed; ///<Closed bursts of each neuron of the sequence not yet assigned to a written cycle
+	std::vector<Burst> open; ///<Burst in progress of each neuron of the sequence (spikes 0 if none)
+	std::vector<double> last_start; ///<Burst start of each neuron in the previous cycle, nan if none
+	long cycle; ///<Cycles written
+	FILE * f; ///<Cycles file
+	SpikeSink * next; ///<Sink the events are passed on to, NULL to discard them
+
+	/*!
+	* @brief Writes the cycles whose bursts are all closed. The last cycle needs the start of the next reference burst, so it is never written.
+	*/
+	void write_cycles();
+
+public:
+	/*! BurstAnalysis constructor
+	* @param seq Neuron ids of the sequence, the first one is the reference
+	* @param names Neuron names (all neurons, same ids as the simulator)
+	* @param max_isi Maximum interval between spikes of the same burst in ms
+	* @param f Cycles file stream
+	* @param next Sink the events are passed on to, NULL to discard them
+	*/
+	BurstAnalysis(const std::vector<int> &seq,const std::vector<std::string> &names,double max_isi,FILE * f,SpikeSink * next);
+
+	/*!
+	* @brief Changes the cycles file and the next sink, e.g. for a copy that continues the analysis of a shared simulation prefix.
+	*/
+	void set_output(FILE * f,SpikeSink * next){this->f=f;this->next=next;}
+
+	/*!
+	* @brief Writes the columns line of the cycles file. The header of the next sink is written by its owner, so a resumed run can start a new cycles file.
+	*/
+	void write_header(const char * columns,const char * params);
+
+	/*!
+	* @brief Groups the events in bursts, writes the cycles completed and passes the events on to the next sink.
+	*/
+	void write(const SpikeEvent * events,int n);
+
+	/*!
+	* @brief Closes the bursts in progress and writes the remaining complete cycles. Call after the last simulate.
+	*/
+	void finish();
+
+	FILE * getFile(){return next ? next->getFile() : NULL;}
+
+	long getNCycles(){return cycle;} ///< Cycles written
+
+	/*!
+	* @brief Neurons of the feeding sequence N1M, N2v and N3t: the first neuron of each type present in types.
+	* @param types Neuron type of each neuron
+	*/
+	static std::vector<int> feeding_sequence(const std::vector<int> &types);
+
+	/*!
+	* @brief Neuron ids from a comma separated list of names.
+	* @param list Names, e.g. "N1M,N2v,N3t"
+	* @param names Neuron names
+	* @return Ids, empty if a name is not found (a message is printed)
+	*/
+	static std::vector<int> parse_sequence(const char * list,const std::vector<std::string> &names);
+};
+
+#endif
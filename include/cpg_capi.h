@@ -0,0 +1,139 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+#ifndef CPG_CAPI_H
+#define CPG_CAPI_H
+
+/*
+ C interface of the simulator, built as libcpg.so (make lib), to drive simulations from other languages without starting a process and parsing
+ its files (see utils/cpg.py). A handle owns a CPGSimulator. Samples and spikes are written straight to buffers given by the caller, each call
+ continues from the state reached by the previous one and the currents can be changed between calls.
+ Functions returning a pointer return NULL on error and the rest a negative value, a message is printed to stderr.
+ Times in ms, currents in nA and voltages in mV.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct CPGHandle CPGHandle; ///<Simulator handle
+
+/*!Integration methods, same values as CPGSimulator::integrators. Only fixed step methods can be used with cpg_step and cpg_run.*/
+enum cpg_integrators{CPG_EULER,CPG_RUNGE,CPG_ADAPTIVE,CPG_RUSH_LARSEN,CPG_RUSH_LARSEN_MID,CPG_ROSENBROCK,CPG_ADAPTIVE_ROSENBROCK};
+
+/*!
+* @brief Creates a simulator of the feeding CPG, with the Euler integrator and dt 0.01 ms.
+* @param connection Type of connection between neurons, as -connection
+* @param currents Currents of SO, N1M, N2v and N3t, -1 for the one stimulated with the ramp
+* @param min_c Ramp minimum current (unused without a -1 current)
+* @param max_c Ramp maximum current
+* @param stim_inc Ramp current increment
+* @param stim_dur Duration of each ramp step in ms
+* @return Handle, NULL on error
+*/
+CPGHandle * cpg_create(int connection,const double * currents,double min_c,double max_c,double stim_inc,double stim_dur);
+
+/*!
+* @brief Creates a simulator of a network file (see NetworkTopology::load), with its currents, the Euler integrator and dt 0.01 ms.
+* @param file Network file name
+* @return Handle, NULL on error
+*/
+CPGHandle * cpg_create_network(const char * file);
+
+/*!
+* @brief Frees a handle.
+*/
+void cpg_destroy(CPGHandle * h);
+
+/*!
+* @brief Number of neurons, the voltage columns of the samples.
+*/
+int cpg_n_neurons(CPGHandle * h);
+
+/*!
+* @brief Name of neuron i, valid while the handle exists. NULL if out of range.
+*/
+const char * cpg_neuron_name(CPGHandle * h,int i);
+
+/*!
+* @brief Sets the integrator and time step of the next calls. Changing them in the middle of a simulation is allowed, the state is kept.
+* @param integrator Integration method from cpg_integrators, a fixed step one
+* @param dt Time step in ms
+* @return 0, -1 on error
+*/
+int cpg_configure(CPGHandle * h,int integrator,double dt);
+
+/*!
+* @brief Steps the network in parallel (see CPGSimulator::set_threads).
+* @param n_threads Number of threads including the calling one, 0 to disable the parallel stepping
+* @return 0, -1 on error
+*/
+int cpg_set_threads(CPGHandle * h,int n_threads);
+
+/*!
+* @brief Changes the current values for the next calls.
+* @param currents One per neuron (same order as the names), -1 for the one stimulated with the ramp
+* @param n Number of values, must be cpg_n_neurons
+* @return 0, -1 on error
+*/
+int cpg_set_currents(CPGHandle * h,const double * currents,int n);
+
+/*!
+* @brief Adds the items of a stimulation protocol file on top of the current values (see StimProtocol::load), kept by cpg_set_currents.
+* @param file Protocol file name
+* @return 0, -1 on error (a message is printed)
+*/
+int cpg_load_protocol(CPGHandle * h,const char * file);
+
+/*!
+* @brief Reads the gating functions from lookup tables in every simulator of the process (see CPGSimulator::use_gating_tables).
+* @param cubic 1 for cubic interpolation, 0 for linear
+* @param step Table step in mV
+* @return Maximum absolute error of the tables
+*/
+double cpg_use_gating_tables(int cubic,double step);
+
+/*!
+* @brief Simulated time in ms.
+*/
+double cpg_time(CPGHandle * h);
+
+/*!
+* @brief Steps the network without output, e.g. to skip the transient.
+* @param steps Steps to do
+* @return Steps done, -1 on error
+*/
+long cpg_step(CPGHandle * h,long steps);
+
+/*!
+* @brief Steps the network writing samples and spikes to the caller buffers. A sample is taken each decimation steps (as the trace file with
+* decimation 4). Stops early if the next sample does not fit in max_samples. Spikes after the first max_spikes are counted but not stored.
+* Any buffer may be NULL to skip it.
+* @param steps Steps to do
+* @param decimation Steps per sample
+* @param t Sample times, max_samples long
+* @param v Voltages, row major max_samples x cpg_n_neurons
+* @param c Current value of each sample, as the last column of the trace file, max_samples long
+* @param max_samples Samples that fit in t, v and c
+* @param n_samples Set to the number of samples taken
+* @param spike_t Spike times, max_spikes long
+* @param spike_v Spike peak voltages, max_spikes long
+* @param spike_neuron Spike neuron ids, max_spikes long
+* @param max_spikes Spikes that fit in spike_t, spike_v and spike_neuron
+* @param n_spikes Set to the number of spikes detected, more than max_spikes if some were not stored
+* @return Steps done, -1 on error
+*/
+long cpg_run(CPGHandle * h,long steps,int decimation,double * t,double * v,double * c,long max_samples,long * n_samples,
+	double * spike_t,double * spike_v,int * spike_neuron,long max_spikes,long * n_spikes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
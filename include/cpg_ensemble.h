@@ -0,0 +1,154 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+#ifndef CPG_ENSEMBLE_H
+#define CPG_ENSEMBLE_H
+
+#include <stdio.h>
+#include <vector>
+
+#include "cpg_simulator.h"
+
+
+/*! CPGEnsemble class
+ * Integrates many independent copies of the 4 neuron circuit at the same time.
+ * Instances share the topology given by the connection type and differ in their current values and synaptic conductances.
+ * Variables are stored in structure-of-arrays form: each variable of each neuron (or synapse) is a contiguous array with one element per instance,
+ * so every equation is evaluated in a loop over instances that the compiler vectorizes (see ensemble target in the Makefile).
+ */
+class CPGEnsemble
+{
+	friend class CPGBench; ///<Microbenchmarks of the integration functions (src/bench_main.cpp)
+
+	/*!
+	 Synapse description shared by all instances. Same order as in CPGSimulator::init.
+	*/
+	struct SynapseDesc
+	{
+		int pos; ///<Post-synaptic neuron
+		int pre; ///<Pre-synaptic neuron
+		double conduc_syn; ///<Default maximal conductance
+		double activation_syn; ///<Activation time constant
+		double Esyn; ///<Reversal potential
+	};
+
+	int connection; ///<Type of connection in the CPG
+	int n_inst; ///<Number of instances
+	int n_blocks; ///<Number of variables per instance (neurons+synapses)
+	std::vector<SynapseDesc> syns; ///<Synapses in the circuit
+
+	std::vector<double> c_values; ///<Current values, N_NEU per instance
+	std::vector<double> conduc; ///<Synaptic conductances, syns.size() x n_inst
+	RampGenerator rg; ///<RampGenerator object, contains ramp stimulation
+	std::vector<StimProtocol> protocols; ///<Injected currents of each instance, built as in CPGSimulator (currents, ramp and satiated window)
+
+	std::vector<double> v_variables; ///<State, n_blocks x n_inst. Neuron k variable x in block k*N_VARS+x, synapse m variable x in N_NEU*N_VARS+2*m+x
+	std::vector<double> v_apoyo; ///<Intermediate state buffer for the Runge-Kutta stages
+	std::vector<double> v_retorno; ///<Differential equations return buffer
+	std::vector<double> v_k; ///<Runge-Kutta stages buffer, 6 x n_blocks x n_inst
+	std::vector<double> dv; ///<Last soma derivative, N_NEU x n_inst
+	std::vector<double> isyn; ///<Last synaptic current, N_NEU x n_inst
+	std::vector<double> i_ext; ///<Injected current at the current stage, N_NEU x n_inst
+
+public:
+	/*! CPGEnsemble constructor
+	* @brief Creates an empty ensemble with the synapses given by the connection type.
+	* @param connection type of connection between neurons (same as CPGSimulator)
+	* @param rg RampGenerator object, contains ramp stimulation routines
+	*/
+	CPGEnsemble(int connection, RampGenerator rg);
+
+	/*!
+	* @brief Adds a new instance to the ensemble. Must be called before simulate.
+	* @param c_values Current value vector (same ids as neurons vector)
+	* @param conductances Synaptic conductances in the order shown by print. If empty, the default values are used.
+	* @return index of the instance or -1 if the vectors have wrong sizes.
+	*/
+	int add_instance(const std::vector<double> &c_values, const std::vector<double> &conductances);
+
+	int getNInstances(){return n_inst;} ///< Number of instances getter
+	int getNSynapses(){return syns.size();} ///< Number of synapses getter
+
+	/*!
+	* @brief Simulates all instances. Each instance writes the same output format as CPGSimulator::simulate in its own streams.
+	* @param f File streams, one per instance
+	* @param f_spks Spikes file streams, one per instance
+	* @param iters Iterations of the simulation
+	* @param dt Time step
+	* @param integration Integration Method
+	* @param satiated_ini Start instant of satiated activity (in iterations)
+	* @param satiated_end End instant of satiated activity (in iterations)
+	*/
+	void simulate(std::vector<FILE *> &f,std::vector<FILE *> &f_spks,double iters,double dt,CPGSimulator::integrators integration,double satiated_ini,double satiated_end);
+
+	/*!
+	* @brief Prints the synapses of the circuit with its default conductances.
+	*/
+	void print();
+
+private:
+	/*!
+	* @brief Allocates the state and stage buffers and sets initial values for all instances.
+	*/
+	void init_state();
+
+	/*!
+	* @brief Sets the injected current of every neuron and instance from the protocols at _time. It is held during the whole step, as in CPGSimulator.
+	* @param _time Current time instant
+	*/
+	void set_iext(double _time);
+
+	/*!
+	* @brief Evaluates the differential equations of every instance.
+	* @param _time Current time instant
+	* @param vars state array (n_blocks x n_inst)
+	* @param fvec return array (n_blocks x n_inst)
+	*/
+	void diffs(double _time, const double * vars, double * fvec);
+
+	/*!
+	* @brief Euler step for all instances.
+	* @param _time Current time instant
+	* @param dt Time step
+	*/
+	void update_euler(double _time, double dt);
+
+	/*!
+	* @brief Runge-Kutta step for all instances, same scheme as CPGSimulator::intey.
+	* @param _time Current time instant
+	* @param dt Time step
+	*/
+	void update_runge(double _time, double dt);
+
+	/*!
+	* @brief Writes the trace line of one instance.
+	* @param f File stream
+	* @param inst Instance index
+	* @param t time instant
+	* @param c current value
+	*/
+	void write(FILE *f,int inst,double t,double c);
+
+	/*!
+	* @brief Detects spikes of one instance and writes their events, same events as CPGSimulator::detect_spikes.
+	* @param sink Spikes sink of the instance
+	* @param inst Instance index
+	* @param prevs vector of derivate previous values (N_NEU x n_inst)
+	* @param t time value
+	* @param h time since the previous call
+	*/
+	void detect_spikes(SpikeSink &sink,int inst,std::vector<double> &prevs,double t,double h);
+
+	double * var(double * vars,int neu,int x){return vars+(neu*N_VARS+x)*n_inst;} ///< Block of variable x of neuron neu
+	const double * var(const double * vars,int neu,int x){return vars+(neu*N_VARS+x)*n_inst;} ///< Block of variable x of neuron neu
+	double * syn_var(double * vars,int m,int x){return vars+(N_NEU*N_VARS+m*2+x)*n_inst;} ///< Block of variable x of synapse m
+	const double * syn_var(const double * vars,int m,int x){return vars+(N_NEU*N_VARS+m*2+x)*n_inst;} ///< Block of variable x of synapse m
+};
+
+#endif
@@ -7,10 +7,22 @@
 	Please, if you use this implementation cite the two papers above in your work. 
 *************************************************************/
 
+#ifndef CPG_SIMULATOR_H
+#define CPG_SIMULATOR_H
 
 #include "vavoulis_synapse.h"
 #include "vavoulis_neuron.h"
 #include "ramp_generator.h"
+#include "stim_protocol.h"
+#include "async_writer.h"
+#include "spike_events.h"
+#include "network_topology.h"
+#include "step_pool.h"
+#include "sim_stats.h"
+#include "trace_codec.h"
+#include "shm_stream.h"
+
+#include <memory>
 
 #define SPIKE_TH -50.0
 #define MIN_SPIKE_CHANGE 0.001
@@ -19,23 +31,102 @@
 #define N_NEU 4
 #define N_VARS 6
 
+#define OUT_DECIMATION 4 ///<One output line is written each OUT_DECIMATION steps
+#define BIN_MAGIC "CPGTRACE"
+#define BIN_VERSION 1
+#define BIN_ALIGN 64
+#define CKPT_MAGIC "CPGSNAP\n" ///<First 8 bytes of a checkpoint file
+#define CKPT_VERSION 2
+#define BLOCK_BYTES (32*1024) ///<Size of the integration buffers of a neuron block in the parallel stepping, about the L1 data cache
+
 /*! CPGSimulator class
  * Complete circuit class defines neurons and synapses between them to simulate the circuit activity.
  */
 class CPGSimulator
 {
+	friend class CPGBench; ///<Microbenchmarks of the integration functions (src/bench_main.cpp)
+
+	/*!
+	 State of the simulation loop, saved in checkpoints together with the variables of neurons and synapses.
+	*/
+	struct RunState
+	{
+		long iter; ///<Iterations done (steps in the adaptive integrators)
+		double t; ///<Time in ms
+		double h; ///<Next time step of the adaptive integrators
+		double t_out; ///<Next output instant of the adaptive integrators and of the dense output
+		double t_ckpt; ///<Next checkpoint instant of the adaptive integrators
+		int serie; ///<Output decimation counter
+		double c; ///<Current value written in the output file
+		std::vector<double> prevs; ///<Previous dV of each neuron, for spike detection
+	};
 
 	std::vector<VavoulisModel > neurons; ///<Vector of neurons 
 	int n_neurons; ///<number of neurons initialized
-	std::vector<vector< VavoulisSynapse> > syns;///<Vector of synapses vector associated to each neuron
+	std::vector<VavoulisSynapse> synapses; ///<Synapses ordered by post-synaptic neuron: neuron i receives [syn_ptr[i],syn_ptr[i+1])
+	std::vector<int> syn_ptr; ///<First synapse of each neuron in synapses, n_neurons+1 long (CSR row pointers)
+	std::vector<int> syn_pre; ///<Pre-synaptic neuron of each synapse
+	std::vector<std::string> names; ///<Neuron names
 	std::vector<double> c_values; ///<Current value vector (same ids as neurons vector)
 	RampGenerator rg; ///<RampGenerator object, contains ramp stimulation
-	int connection; ///<Type of connection in the CPG
+	StimProtocol protocol; ///<Injected currents compiled from c_values, rg, the protocol file and the satiated window
+	int connection; ///<Type of connection in the CPG, -1 for networks given as a NetworkTopology
+	uint64_t topology_hash; ///<NetworkTopology::hash of the network, saved in checkpoints
+	int i_report; ///<Neuron whose current value is written in the output file when there is no ramp (the first N1M)
+	std::vector<double> out_vals; ///<Output record buffer
+	std::vector<char> out_line; ///<ASCII output line buffer
+
+	int n_state; ///<Total number of variables (neurons+synapses) in the flat state vector
+	std::vector<int> offsets; ///<Index of the first variable of each neuron in the flat state vector
+	std::vector<double> v_variables; ///<Flat state vector used by intey (see intey for the layout)
+	std::vector<double> v_apoyo; ///<Intermediate state buffer for the Runge-Kutta stages
+	std::vector<double> v_retorno; ///<Differential equations return buffer
+	std::vector<double> v_k; ///<Runge-Kutta stages buffer, 6 x n_state
+	std::vector<double> v_error; ///<Second solution of the embedded Runge-Kutta pair, used to estimate the error
+	std::vector<double> v_tau; ///<Time constants of the gating and synaptic variables (0 for voltages), 2 x n_state, used by the Rush-Larsen integrators
+	std::vector<double> v_jac; ///<Jacobian of diffs (row major, n_state x n_state) followed by the LU factors of I/(gamma*dt)-J, used by the Rosenbrock integrators (allocated on first use)
+	std::vector<int> v_pivots; ///<Row permutation of the LU factorization
+	std::vector<double> v_dense; ///<States at the start and at the end of the step and interpolated state of the dense output, 3 x n_state
+
+	std::shared_ptr<StepPool> pool; ///<Threads of the parallel stepping, NULL to step the whole network in the calling thread
+	std::vector<int> block_ptr; ///<Neuron blocks of the parallel stepping: block b has neurons [block_ptr[b],block_ptr[b+1])
+	std::vector<int> thread_block; ///<Blocks of each thread: thread t owns blocks [thread_block[t],thread_block[t+1])
+	std::vector<double> v_pre; ///<Presynaptic voltages of the parallel stepping, two buffers of n_neurons (written in one stage, read in the next)
+
+	double rtol; ///<Relative tolerance for the adaptive integrator
+	double atol; ///<Absolute tolerance for the adaptive integrator
+	double dt_max; ///<Maximum time step for the adaptive integrator
+
+	int format; ///<Output file format (see formats)
+	double delta_res; ///<Quantization step of the DELTA format, 0 for bit-exact values
+	double out_interval; ///<Time between trace records in ms, interpolated within the steps (see set_output_interval), 0 for one record each OUT_DECIMATION steps
+	DeltaEncoder delta; ///<Records of the DELTA block in progress
+	AsyncWriter * writer; ///<Asynchronous output stage, NULL to write directly with stdio
+	SpikeSink * spike_sink; ///<Destination of spike events, NULL for the ascii spikes file given to simulate
+	SpikeRing spike_ring; ///<Spike events not yet sent to the sink
+	ShmPublisher * publisher; ///<Live stream of the records in shared memory, NULL for none
+	SimStats * stats; ///<Profiling counters updated by simulate, NULL to disable them
+
+	RunState run; ///<Simulation loop state
+	bool resumed; ///<run was loaded by load_checkpoint, the next simulate continues from it
+	std::string ckpt_file; ///<Checkpoint file, empty for no checkpoints
+	double ckpt_interval; ///<Simulated time between checkpoints in ms, 0 to write it only at the end
 
 public:
 	/*!Integration methods types
+	* RUSH_LARSEN: gating and synaptic variables are integrated exactly over the step as x_inf+(x-x_inf)*exp(-dt/tau) and voltages with forward Euler.
+	* RUSH_LARSEN_MID: second order version, both are computed at the midpoint of the step.
+	* ROSENBROCK: linearly implicit 4th order method with a finite differences Jacobian, for stiff problems.
+	* ADAPTIVE_ROSENBROCK: ROSENBROCK with step size control as in ADAPTIVE, the error is estimated with its embedded 3rd order solution.
 	*/
-	enum integrators{EULER,RUNGE,n_integrators};
+	enum integrators{EULER,RUNGE,ADAPTIVE,RUSH_LARSEN,RUSH_LARSEN_MID,ROSENBROCK,ADAPTIVE_ROSENBROCK,n_integrators};
+	/*!Output file formats
+	* ASCII: one line per record, space separated values.
+	* BIN32/BIN64: text header padded to BIN_ALIGN bytes followed by fixed-width records. Time is always float64, the rest of the columns float32 or float64.
+	* NONE: no trace is written and the trace file given to simulate may be NULL, e.g. when only the spikes or the cycles analysis are needed.
+	* DELTA: header as the binary formats (magic CPGDELTA) followed by compressed blocks of records (see DeltaEncoder), values quantized to a resolution or bit-exact.
+	*/
+	enum formats{ASCII,BIN32,BIN64,NONE,DELTA,n_formats};
 	CPGSimulator(); ///< Void constructor
 
 	/*! CPGSimulator constructor
@@ -46,6 +137,36 @@ public:
 	*/
 	CPGSimulator(int connection, std::vector<double> c_values,RampGenerator rg);
 
+	/*! CPGSimulator constructor
+	* @brief Creates a new simulator for an arbitrary network using init method.
+	* @param net Neurons and synapses
+	* @param c_values Current value vector (same ids as net neurons), usually net.currents
+	* @param rg RampGenerator object, contains ramp stimulation routines
+	*/
+	CPGSimulator(const NetworkTopology &net, std::vector<double> c_values,RampGenerator rg);
+
+	/*!
+	* @brief Returns a copy that continues from the state reached by the last simulate: its next simulate starts at the same time and iteration, 
+	* with the same results as if the original had not stopped (as load_checkpoint). The asynchronous writer, spike sink, checkpoint and threads are not copied.
+	* Each copy is independent, so the common prefix of several protocols can be simulated once and its branches run in parallel threads.
+	*/
+	CPGSimulator branch() const;
+
+	/*!
+	* @brief Changes the current values (same ids as neurons vector), e.g. to apply a different current step in each branch.
+	* Items loaded with load_protocol are kept.
+	*/
+	void setCurrents(const std::vector<double> &c_values){this->c_values=c_values;protocol.set_currents(c_values,rg);}
+
+	/*!
+	* @brief Adds the steps, ramps, pulse trains and satiated windows of a protocol file on top of the current values (see StimProtocol::load).
+	* @param file Protocol file name
+	* @return 1 on success, 0 on error (a message is printed)
+	*/
+	int load_protocol(const char * file){return protocol.load(file,names);}
+
+	StimProtocol & getProtocol(){return protocol;} ///< Stimulation protocol, e.g. to hold closed-loop currents or set the satiated window
+
 	/*!
 	* @brief Assign attributes value depending on the connection type
 	* @param connection type of connection between neurons
@@ -54,6 +175,19 @@ public:
 	*/
 	int init(int connection, std::vector<double> c_values,RampGenerator rg);
 
+	/*!
+	* @brief Creates the neurons and synapses of a network. Synapses keep the CSR layout of net, so each neuron reads its synapses 
+	* from a contiguous range and the pre-synaptic voltage by index. The output file has the time, the voltage of every neuron and the current value.
+	* @param net Neurons and synapses
+	* @param c_values Current value vector (same ids as net neurons), usually net.currents
+	* @param rg RampGenerator object, contains ramp stimulation routines
+	*/
+	int init(const NetworkTopology &net, std::vector<double> c_values,RampGenerator rg);
+
+	int getNNeurons(){return n_neurons;} ///< Number of neurons
+	const std::vector<std::string> & getNames(){return names;} ///< Neuron names (same ids as neurons vector)
+	std::vector<int> getTypes(); ///< Neuron types from VavoulisModel::types (same ids as neurons vector)
+
 	/*!
 	* @brief Simulates activity in the CPG from the initialized CPGSimulator. 
 	* @param f File stream
@@ -61,11 +195,149 @@ public:
 	* @param iters Iterations of the simulation
 	* @param dt Time step
 	* @param integration Integration Method
-	* @param satiated_ini Start instant of satiated activity (in iterations)
-	* @param satiated_end End instant of satiated activity (in iterations)
+	* @param satiated_ini Start instant of satiated activity (in iterations), -1 for none. When any of them is given it replaces the satiated window of the protocol.
+	* @param satiated_end End instant of satiated activity (in iterations), -1 for no end
 	*/
 	void simulate(FILE * f,FILE * f_spks,double iters,double dt,integrators integration,double statiated_ini,double satiated_end);
 
+	/*!
+	* @brief Steps the network writing the samples to caller buffers instead of files, for programs that embed the simulator (see cpg_capi.h).
+	* The first call after init starts at t=0 and each call continues from the state reached by the previous one (or by simulate and load_checkpoint),
+	* so current values can be changed with setCurrents between calls. Currents follow the protocol (with the satiated window of the last simulate,
+	* none by default). Checkpoints and stats are not used.
+	* A sample is taken each decimation steps before the step, as the records of the trace file (same records when decimation is OUT_DECIMATION).
+	* Stops early when max_samples are taken and the next one does not fit. Only fixed step integrators.
+	* @param steps Steps to do
+	* @param dt Time step
+	* @param integration Integration method, not ADAPTIVE nor ADAPTIVE_ROSENBROCK
+	* @param decimation Steps per sample
+	* @param t_out Time of each sample, max_samples long (NULL to skip)
+	* @param v_out Voltage of each neuron in each sample, row major max_samples x getNNeurons() (NULL to skip)
+	* @param c_out Current value of each sample as in the trace file, max_samples long (NULL to skip)
+	* @param max_samples Samples that fit in the buffers
+	* @param n_samples Set to the number of samples taken
+	* @param sink Spike events destination, all events are sent to it before returning
+	* @return Steps done, -1 for an adaptive integrator or decimation < 1
+	*/
+	long advance(long steps,double dt,integrators integration,int decimation,double * t_out,double * v_out,double * c_out,long max_samples,long * n_samples,SpikeSink &sink);
+
+	/*!
+	* @brief Sets the step size control parameters of the ADAPTIVE and ADAPTIVE_ROSENBROCK integrators.
+	* @param rtol Relative tolerance
+	* @param atol Absolute tolerance
+	* @param dt_max Maximum time step
+	*/
+	void set_tolerances(double rtol,double atol,double dt_max);
+
+	/*!
+	* @brief Steps the network in parallel. Neurons are split in blocks whose integration buffers fit in BLOCK_BYTES, each thread owns a 
+	* contiguous range of blocks and computes the equations and the stage update of one block before the next, while it is in cache.
+	* Neurons only see each other through the presynaptic voltage, which is copied once per stage to a double-buffered array: the stage 
+	* reads one buffer and writes the other, so a single barrier per stage is enough.
+	* Used by EULER, RUSH_LARSEN and RUNGE, the rest of integrators step in the calling thread. RUNGE and RUSH_LARSEN give the same results as 
+	* without threads. EULER uses the voltages at the start of the step for every synapse instead of the in-place sweep (where each neuron sees the 
+	* already updated values of the previous ones), so it differs from the serial Euler within the integration error. In all cases the results do 
+	* not depend on the number of threads.
+	* @param n_threads Number of threads including the calling one, 0 to disable the parallel stepping
+	*/
+	void set_threads(int n_threads);
+
+	/*!
+	* @brief Sets the output file format.
+	* @param format Format from formats
+	* @param resolution Quantization step of the voltages and current in the DELTA format (time is always kept bit-exact), 0 for bit-exact values
+	*/
+	void set_format(formats format,double resolution=DELTA_RESOLUTION){this->format=format;this->delta_res=resolution;delta.init(0,resolution);}
+
+	/*!
+	* @brief Writes the trace of simulate at a fixed interval of simulated time instead of each OUT_DECIMATION steps, so its resolution does not depend
+	* on the time step (also with the adaptive integrators). Records at the multiples of interval are interpolated within the step that contains them:
+	* RUNGE and ADAPTIVE use a third order interpolant built from the stages of the step, the rest of integrators interpolate linearly between the
+	* states at both ends of the step. The current value is the one of that step. Call before the first simulate (or before resuming, with the same interval).
+	* @param interval Time between records in ms, 0 (default) for one record each OUT_DECIMATION steps
+	*/
+	void set_output_interval(double interval){out_interval=interval;}
+	double getOutputInterval(){return out_interval;} ///< Time between trace records in ms, 0 if decimated by steps
+
+	/*!
+	* @brief Sends trace and spikes records through an asynchronous writer instead of writing them from the simulation thread.
+	* simulate flushes the writer before returning, so files can be closed afterwards.
+	* @param writer AsyncWriter object, NULL to go back to direct output
+	*/
+	void set_writer(AsyncWriter * writer){this->writer=writer;}
+
+	/*!
+	* @brief Sends spike events to sink instead of the ascii spikes file given to simulate (f_spks is then ignored).
+	* @param sink SpikeSink object (e.g. BinSpikeSink), NULL to go back to the ascii file
+	*/
+	void set_spike_sink(SpikeSink * sink){this->spike_sink=sink;}
+
+	/*!
+	* @brief Publishes the trace records written by simulate in shared memory, decimated, with the voltage of every neuron and the current value
+	* ("t V... c", also with the NONE format). Spikes are published by using the publisher as spike sink too. Not copied by branch.
+	* @param publisher Opened publisher with getNNeurons()+2 columns, NULL to stop publishing
+	*/
+	void set_publisher(ShmPublisher * publisher){this->publisher=publisher;}
+
+	/*!
+	* @brief Enables the profiling counters: simulate adds to stats the time spent in each phase of the loop, its wall-clock and CPU time,
+	* steps, evaluations of the equations, exp calls, spikes and bytes written. With the asynchronous writer it is flushed at the start of simulate,
+	* so bytes are counted from there.
+	* @param stats SimStats object, NULL to disable them
+	*/
+	void set_stats(SimStats * stats){this->stats=stats;}
+
+	/*!
+	* @brief Enables checkpoints: the complete state (variables of neurons and synapses, time, iteration, spike detection
+	* and the offsets of the output files) is saved in file every interval ms of simulated time and at the end of simulate.
+	* The stimulation protocol only depends on time, so its phase is restored with it.
+	* @param file Checkpoint file name, NULL to disable checkpoints
+	* @param interval Simulated time between checkpoints in ms, 0 to write it only at the end
+	*/
+	void set_checkpoint(const char * file,double interval);
+
+	/*!
+	* @brief Loads a checkpoint written by a simulator with the same network (connection, or neurons and synapses), integrator and dt. The next simulate continues from it, with 
+	* the same results as the original run if the rest of the parameters are the same. Current values are taken from this simulator, so the same 
+	* snapshot can start variants with different stimulation.
+	* @param file Checkpoint file name
+	* @param integration Integration method of the next simulate
+	* @param dt Time step of the next simulate
+	* @param offsets Set to the size of the trace and spikes files when the checkpoint was written, if not NULL
+	* @return 1 on success, 0 on error (a message is printed)
+	*/
+	int load_checkpoint(const char * file,integrators integration,double dt,long * offsets);
+
+	/*!
+	* @brief Simulated time in ms, after simulate or load_checkpoint.
+	*/
+	double getTime(){return run.t;}
+
+	/*!
+	* @brief Reads the gating functions of all neurons and synapses from lookup tables instead of evaluating exp (see GatingTable). Affects every simulator in the program.
+	* @param interp Interpolation type
+	* @param step Table step in mV
+	* @param worst Set to the name of the function with the maximum error, if not NULL.
+	* @return Maximum absolute error of the tables.
+	*/
+	static double use_gating_tables(GatingTable::interpolations interp,double step,const char ** worst);
+
+	/*!
+	* @brief Writes the output file header. In ASCII format the columns line, in binary formats a self-describing text header:
+	*	CPGTRACE <version>
+	*	header_size <bytes>
+	*	columns <name>:<numpy type> ...
+	*	dt <dt>
+	*	decimation <steps per record>
+	*	<params lines>
+	* padded with spaces to a multiple of BIN_ALIGN bytes and ending in a new line, so records can be memory mapped from header_size.
+	* @param f File stream
+	* @param columns Space separated column names, first is time.
+	* @param dt Time step
+	* @param params Parameters lines ("name value" separated by new lines), written only in binary formats.
+	*/
+	void write_header(FILE *f,const char * columns,double dt,const char * params);
+
 	/*!
 	* @brief Prints CPG components: All neurons and synapses initialized
 	*/
@@ -75,7 +347,43 @@ public:
 private:
 	
 	/*!
-	* @brief General update function, this function call either update_euler or update_runge
+	* @brief Sets the simulation loop state to the start of a run: time and iteration 0 and no spike detection history.
+	* @param dt Time step
+	*/
+	void reset_run(double dt);
+
+	/*!
+	* @brief Simulation loop for the ADAPTIVE and ADAPTIVE_ROSENBROCK integrators. The step size changes each step, so output is driven by time instead of iterations. 
+	* A line is written each 4*dt, as in the fixed step methods. Steps end at the changes of the stimulation protocol, so currents are constant within a step.
+	* @param f File stream
+	* @param sink Spikes sink
+	* @param integration Integration Method
+	* @param t_end Simulation duration in ms
+	* @param dt Initial time step
+	*/
+	void simulate_adaptive(FILE * f,SpikeSink &sink,integrators integration,double t_end,double dt);
+
+	/*!
+	* @brief Writes a checkpoint in the file set by set_checkpoint. Pending spikes and output are flushed first, so the offsets of the output files 
+	* saved in the checkpoint are the point to continue from. The snapshot is written to a temporary file and renamed, so a run killed while writing 
+	* keeps the previous one.
+	* @param f Trace file stream
+	* @param sink Spikes sink
+	* @param integration Integration Method
+	* @param dt Time step
+	* @return 1 on success, 0 on error
+	*/
+	int save_checkpoint(FILE * f,SpikeSink &sink,integrators integration,double dt);
+
+	/*!
+	* @brief Current value reported in the output file, at the last seek of the protocol.
+	* @return Ramp value if any neuron is stimulated by a ramp, current value of neuron i_report otherwise.
+	*/
+	double current_value();
+
+	/*!
+	* @brief General update function, this function call either update_euler or update_runge. The currents are the ones of the
+	* stimulation protocol at its last seek, done by the caller (the simulation loops time it as a phase of its own).
 	* @param _time Current time instant
 	* @param integr Integration Method
 	* @param dt Time step
@@ -94,31 +402,150 @@ private:
 	*/
 	void update_runge(double _time, double dt);
 	/*!
-	* 	@brief Intey auxiliar function, obtains general vectors with the result of each differential equation for each neuron variables and its associated synapses.
+	* @brief Rush-Larsen update function. Variables with the form (x_inf-x)/tau are updated with exp(-dt/tau), voltages with Euler, all from the state at _time.
+	* @param _time Current time instant
+	* @param dt Time step
+	*/
+	void update_rush_larsen(double _time, double dt);
+	/*!
+	* @brief Second order Rush-Larsen update function. A half step of update_rush_larsen gives the midpoint state, 
+	* then x_inf and tau at the midpoint are used for the exponential step and the midpoint derivative for the voltages.
+	* @param _time Current time instant
+	* @param dt Time step
+	*/
+	void update_rush_larsen_mid(double _time, double dt);
+	/*!
+	* @brief Rosenbrock update function (see ros_stages). The Jacobian is computed at the start of each step, then the equations are evaluated again
+	* at the new state so neurons keep its dV for spike detection.
+	* @param _time Current time instant
+	* @param dt Time step
+	*/
+	void update_rosenbrock(double _time, double dt);
+	/*!
+	* @brief Computes the stages of the 4th order Kaps-Rentrop method (Shampine parameters) from v_variables, the Jacobian in v_jac and the equations at v_variables in the fifth n_state block of v_k.
+	* Each stage solves (I/(gamma*dt)-J) g_i = f(y+sum a_ij g_j)+sum c_ij g_j/dt with a single LU factorization and only three evaluations of the equations.
+	* The stimulus is piecewise constant, so the time derivative of f is not included.
+	* The solution is left in v_apoyo and the error estimate (difference with the embedded 3rd order solution) in v_error.
+	* @param _time Current time instant
+	* @param dt Time step
+	*/
+	void ros_stages(double _time, double dt);
+	/*!
+	* @brief Computes the Jacobian of diffs in v_jac by forward differences. Neurons are only coupled through their voltage (synapses read the presynaptic V),
+	* so the same variable of every neuron block is perturbed at once and voltages one by one: max block size - 1 + n_neurons evaluations instead of n_state.
+	* @param _time Current time instant
+	* @param vars flat state array, restored on return
+	* @param f0 diffs at vars
+	*/
+	void jacobian(double _time, double * vars, const double * f0);
+	/*!
+	* @brief Time of the dV values left by the last step (last evaluation of the equations), used for spike interpolation.
+	* @param integration Integration Method
+	* @param _time Step start
+	* @param dt Time step
+	*/
+	double dv_time(integrators integration,double _time,double dt);
+	/*!
+	* @brief Adaptive Runge-Kutta update. Uses the difference between both solutions of the embedded pair in intey as error estimate, 
+	* the step is repeated with a smaller dt until the error is bellow the tolerances set by set_tolerances.
+	* With ADAPTIVE_ROSENBROCK the pair is ros_stages and the Jacobian is computed once per step. The currents are the ones of the protocol
+	* seeked to _time by the caller, constant within the step (the caller limits it to the next change of the protocol).
+	* @param _time Current time instant
+	* @param dt Proposed time step, updated with the proposal for the next step.
+	* @param integration ADAPTIVE or ADAPTIVE_ROSENBROCK
+	* @return Time step used.
+	*/
+	double update_adaptive(double _time, double &dt, integrators integration);
+	/*!
+	* @brief Parallel version of update_euler, update_rush_larsen and update_runge (see set_threads).
+	* @param _time Current time instant
+	* @param integr Integration Method
+	* @param dt Time step
+	*/
+	void update_parallel(double _time, integrators integr, double dt);
+	/*!
+	* @brief Splits the neurons in blocks of at most BLOCK_BYTES of integration buffers and assigns contiguous blocks to the threads of pool.
+	*/
+	void partition();
+	/*!
+	* @brief Computes the flat state layout (offsets and n_state) and allocates the integration buffers, except the Rosenbrock ones. Called once from init.
+	*/
+	void init_state();
+	/*!
+	* @brief Copies neurons and synapses variables into the flat state vector.
+	* @param vars flat state array (n_state long)
+	* @param n0 First neuron
+	* @param n1 Last neuron (not included), -1 for all
+	*/
+	void get_state(double * vars,int n0=0,int n1=-1);
+	/*!
+	* @brief Copies the flat state vector back into neurons and synapses.
+	* @param vars flat state array (n_state long)
+	* @param n0 First neuron
+	* @param n1 Last neuron (not included), -1 for all
+	*/
+	void set_state(const double * vars,int n0=0,int n1=-1);
+	/*!
+	* 	@brief Intey auxiliar function, obtains the flat vector with the result of each differential equation for each neuron variables and its associated synapses.
 	*	@param _time Current time instant
-	* 	@param v_variables general vector matrix with all variables (neuron+synapses)
-	* 	@param v_fvec general return vector matrix with all differential equations value for each variable (neuron+synapses)
+	* 	@param v_variables flat array with all variables (neuron+synapses)
+	* 	@param v_fvec flat return array with all differential equations value for each variable (neuron+synapses)
+	* 	@param v_tau flat return array with the time constant of each variable (0 for voltages), not computed if NULL
+	*	@param n0 First neuron
+	*	@param n1 Last neuron (not included), -1 for all. Only the variables of these neurons are computed.
+	*	@param v_pre presynaptic voltages by neuron index, NULL to read them from v_variables
 	*/
-	void diffs(double _time,const std::vector<std::vector<double > > & v_variables, std::vector<std::vector<double > >  &v_fvec);
+	void diffs(double _time,const double * v_variables, double * v_fvec, double * v_tau=NULL,int n0=0,int n1=-1,const double * v_pre=NULL);
 	/*!
-	* 	@brief Performs Runge-Kutta integration with middle steps. New variable defined with a "global" vector containing both neurons and synapses.
+	* 	@brief Performs Runge-Kutta integration with middle steps. New variable defined with a "global" flat vector containing both neurons and synapses,
+	* 	each neuron starting at offsets[neuron] followed by its synapses variables. 
 	* 	Complete array example with N1M-N2v-N3t connection:
 	* 		SO neuron variables (no synapses):					 v,va,p,q,h,n
 	* 		N1M neuron variables and synapses N1M-N2v;N1M-N3t:	 v,va,p,q,h,n,s,r,s,r
 	* 		N2v variables and synapses N2v-N1M:					 v,va,p,q,h,n,s,r
 	* 		N3t variables and synapses N3t-N1M;N3t-N2v:			 v,va,p,q,h,n,s,r,s,r
+	*	All buffers are preallocated in init_state so no allocation is done in each step.
 	*
 	*	@param _time Current time instant
 	*	@param inc_integracion Time step
 	*/
 	double intey(double _time, double inc_integracion);
 	/*!
-	* @brief Detect possible spikes in each neuron and writes it in the associated spike file. When no spike is found ',' is written in the corresponding column.
-	* @param f_spks Spikes file stream 
+	* 	@brief Computes the Runge-Kutta stages from v_variables. The solution used by intey is left in v_apoyo and the other solution of the pair in v_error.
+	*	@param _time Current time instant
+	*	@param inc_integracion Time step
+	*/
+	void rk_stages(double _time, double inc_integracion);
+	/*!
+	* 	@brief Computes stage s of rk_stages for neurons [n0,n1): the equations at the stage input (v_variables in the first stage, v_apoyo in the rest) 
+	*	and the input of the next stage in v_apoyo (the solutions in the last one).
+	*	@param s Stage, 0 to 5
+	*	@param _time Current time instant
+	*	@param inc_integracion Time step
+	*	@param n0 First neuron
+	*	@param n1 Last neuron (not included)
+	*	@param v_pre presynaptic voltages of the stage input, NULL to read them from the input
+	*	@param v_pre_next set to the voltages of the next stage input of neurons [n0,n1), if not NULL
+	*/
+	void rk_stage(int s, double _time, double inc_integracion, int n0, int n1, const double * v_pre, double * v_pre_next);
+	/*!
+	* @brief Detect spikes in each neuron from the change of sign of its derivative and adds an event to spike_ring with the interpolated peak time and potential.
+	* Nothing is allocated or formatted here, events are sent to the sink when the ring is full and at the end of the simulation.
+	* @param sink Spikes sink
 	* @param prevs vector of derivate previous values 
-	* @param t time value 
+	* @param t time of the dV sample: the step start in Euler (in-place sweep from the state at t), the step end in Runge-Kutta (last stage)
+	* @param h time since the previous call
+	*/
+	void detect_spikes(SpikeSink &sink, std::vector<double> &prevs, double t, double h);
+
+	/*!
+	* @brief Calls to exp and expm1 done by a simulation: gating functions of each evaluation of the equations and, in the Rush-Larsen
+	* integrators, the exponential update of each gating variable. Computed from the counts instead of counting in the equations.
+	* @param integration Integration Method
+	* @param rhs_evals Evaluations of the equations of the whole network
+	* @param steps Integration steps
 	*/
-	void detect_spikes(FILE * f_spks, std::vector<double> &prevs, double t );
+	long exp_calls(integrators integration,long rhs_evals,long steps);
 
 	/*!
 	* @brief Writes V value and Isyn or injected current depending on syns_flag value
@@ -128,4 +555,31 @@ private:
 	*/
 	void write(FILE *f,double t,double c);
 
-};
\ No newline at end of file
+	/*!
+	* @brief Writes the interpolated records of the output instants within the step [t,t+h) just done (see set_output_interval).
+	* The state at the start of the step must be in v_dense, and the stages in v_k for RUNGE and ADAPTIVE.
+	* @param f File stream
+	* @param t Start of the step
+	* @param h Step done
+	* @param integration Integration method of the step
+	* @param c Current value of the step
+	*/
+	void write_dense(FILE *f,double t,double h,integrators integration,double c);
+
+	/*!
+	* @brief Writes a record in f, either directly or through the asynchronous writer.
+	* @param f File stream
+	* @param data Record bytes
+	* @param n Number of bytes
+	*/
+	void out(FILE *f,const void * data,size_t n);
+
+	/*!
+	* @brief Writes the DELTA block in progress, so the file ends in a complete block (at the end of simulate and before checkpoints).
+	* @param f File stream
+	*/
+	void flush_trace(FILE *f);
+
+};
+
+#endif
@@ -0,0 +1,72 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+#ifndef GATING_TABLE_H
+#define GATING_TABLE_H
+
+#include <vector>
+
+#define GATING_VMIN -130.0 ///<Lower voltage of the tables (mV)
+#define GATING_VMAX 70.0 ///<Upper voltage of the tables (mV)
+#define GATING_STEP 0.1 ///<Default table step (mV)
+
+
+/*! GatingTable class
+ * Voltage indexed lookup table of a steady-state or time constant function.
+ * Values are interpolated with a linear or a cubic Hermite polynomial in each cell. Out of [GATING_VMIN,GATING_VMAX) the function is evaluated.
+ */
+class GatingTable
+{
+	const char * name; ///<Function name, for reports
+	double (*exact)(double); ///<Tabulated function
+	double vmin; ///<First voltage of the table
+	double inv_step; ///<1/step
+	int n_cells; ///<Number of cells
+	int order; ///<Coefficients per cell, 2 linear or 4 cubic
+	std::vector<double> coefs; ///<Polynomial coefficients of each cell, lowest degree first
+
+public:
+	/*!Interpolation types
+	*/
+	enum interpolations{LINEAR,CUBIC,n_interpolations};
+
+	/*! GatingTable constructor
+	* @brief Tabulates f in [GATING_VMIN,GATING_VMAX).
+	* @param name Function name
+	* @param f Function to tabulate
+	* @param step Table step in mV
+	* @param interp Interpolation type
+	*/
+	GatingTable(const char * name,double (*f)(double),double step,interpolations interp);
+
+	/*!
+	* @brief Interpolated value of the function at x.
+	*/
+	double operator()(double x) const
+	{
+		double t = (x-vmin)*inv_step;
+		if(!(t >= 0 && t < n_cells)) //Also true for NaN
+			return exact(x);
+		int i = (int)t;
+		double u = t-i;
+		const double * c = &coefs[i*order];
+		if(order == 2)
+			return c[0]+u*c[1];
+		return c[0]+u*(c[1]+u*(c[2]+u*c[3]));
+	}
+
+	/*!
+	* @brief Maximum absolute difference with the function, sampled at samples points per cell.
+	*/
+	double max_error(int samples=16) const;
+
+	const char * getName() const {return name;} ///< Function name getter
+};
+
+#endif
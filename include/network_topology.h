@@ -0,0 +1,127 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+#ifndef NETWORK_TOPOLOGY_H
+#define NETWORK_TOPOLOGY_H
+
+#include "vavoulis_neuron.h"
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+/*! NetworkTopology class
+ * Neurons and synapses of a network of Vavoulis neurons, read from a text file or built for one of the feeding CPG connections.
+ * Synapses are stored in compressed sparse row (CSR) arrays indexed by post-synaptic neuron: the synapses received by neuron i are
+ * [row_ptr[i],row_ptr[i+1]) in pre, g, tau and E, in the order they were added.
+ *
+ * File format, one item per line, '#' starts a comment:
+ *	neuron <name> <type> [current]
+ *	synapse <pre> <post> <g> <tau> <E>
+ * type is SO, N1M, N2v or N3t, current is the injected current (-1 for the ramp, 0 by default). Neurons are referenced by name.
+ * tau accepts fast/slow and E excit/inhib besides numbers (see vavoulis_synapse.h).
+ */
+class NetworkTopology
+{
+	struct PendingSynapse
+	{
+		int pre; ///<Pre-synaptic neuron
+		int post; ///<Post-synaptic neuron
+		double g; ///<Maximal conductance
+		double tau; ///<Activation time constant
+		double E; ///<Reversal potential
+	};
+
+	std::vector<PendingSynapse> pending; ///<Synapses added after the last build
+	std::map<std::string,int> index; ///<Neuron index by name
+
+public:
+	std::vector<std::string> names; ///<Neuron names
+	std::vector<VavoulisModel::types> types; ///<Neuron types
+	std::vector<double> currents; ///<Injected current of each neuron, -1 for the ramp
+
+	std::vector<int> row_ptr; ///<First synapse of each post-synaptic neuron, n_neurons+1 long
+	std::vector<int> pre; ///<Pre-synaptic neuron of each synapse
+	std::vector<double> g; ///<Maximal conductance of each synapse
+	std::vector<double> tau; ///<Activation time constant of each synapse
+	std::vector<double> E; ///<Reversal potential of each synapse
+
+	NetworkTopology(); ///< Empty network
+
+	/*!
+	* @brief Adds a neuron.
+	* @param name Neuron name, must be unique
+	* @param type Neuron type
+	* @param current Injected current, -1 for the ramp
+	* @return Neuron index, -1 if the name is repeated
+	*/
+	int add_neuron(const std::string &name,VavoulisModel::types type,double current);
+
+	/*!
+	* @brief Adds a synapse. It is placed in the CSR arrays by build.
+	* @param pre Pre-synaptic neuron index
+	* @param post Post-synaptic neuron index
+	* @param g Maximal conductance
+	* @param tau Activation time constant
+	* @param E Reversal potential
+	*/
+	void add_synapse(int pre,int post,double g,double tau,double E);
+
+	/*!
+	* @brief Moves the synapses added since the last call to the CSR arrays, keeping the order of the synapses of each post-synaptic neuron.
+	*/
+	void build();
+
+	/*!
+	* @brief Reads a network file (see the class description) and builds it.
+	* @param file File name
+	* @return 1 on success, 0 on error (a message with the line is printed)
+	*/
+	int load(const char * file);
+
+	/*!
+	* @brief Feeding CPG with the synapses of a connection type, as used by CPGSimulator and CPGEnsemble.
+	* Neurons are SO, N1M, N2v and N3t in this order, with current 0. The synapses of each neuron are ordered by connection level.
+	* @param connection type of connection between neurons (0 to 4)
+	*/
+	static NetworkTopology feeding(int connection);
+
+	/*!
+	* @brief 64 bits FNV-1a hash of the neuron types and the CSR synapses (after build). Names and currents are not included.
+	*/
+	uint64_t hash() const;
+
+	int getNNeurons() const {return names.size();} ///< Number of neurons
+	int getNSynapses() const {return pre.size();} ///< Number of synapses (after build)
+
+	/*!
+	* @brief Index of a neuron.
+	* @param name Neuron name
+	* @return Index, -1 if there is no neuron with that name
+	*/
+	int find(const std::string &name) const;
+
+	/*!
+	* @brief Index of the first neuron of a type.
+	* @param type Neuron type
+	* @return Index, -1 if there is no neuron of that type
+	*/
+	int find_type(VavoulisModel::types type) const;
+
+	/*!
+	* @brief Neuron type from its name.
+	* @param name SO, N1M, N2v or N3t (case insensitive)
+	* @param type Set to the type
+	* @return 1 on success, 0 for an unknown name
+	*/
+	static int parse_type(const std::string &name,VavoulisModel::types &type);
+};
+
+#endif
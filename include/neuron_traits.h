@@ -0,0 +1,118 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+#ifndef NEURON_TRAITS_H
+#define NEURON_TRAITS_H
+
+#include <math.h>
+
+#include "vavoulis_neuron.h"
+#include "vec_exp.h"
+
+//Constants and gating functions of each neuron type, set out in Tables 1,2 and 3 in Vavoulis et al.
+//Used as template parameters so each neuron type gets its own equations with no branches (see VavoulisModel::rhs and CPGEnsemble kernels).
+//Slow somatic channel: Ix = g_x * p^3 * [q] * (v - E_x), q only if has_q.
+//Gating functions take the exp as template parameter: LibmExp by default, VecExp in the vectorized CPGEnsemble kernels.
+
+
+/*! NeuronTraits
+ * Somatic channel of each neuron type. Constant time constants have the *_varies flag false, so they are not tabulated.
+ */
+template<int T> struct NeuronTraits;
+
+/*! SO: no slow somatic channel, p and q are not used.
+*/
+template<> struct NeuronTraits<VavoulisModel::SO>
+{
+	static constexpr bool has_p = false; ///<p variable used
+	static constexpr bool has_q = false; ///<q variable used
+	static constexpr bool tau_p_varies = false; ///<tau_p depends on voltage
+	static constexpr bool tau_q_varies = false; ///<tau_q depends on voltage
+	static constexpr double g_x = 0; ///<Slow channel maximal conductance
+	static constexpr double E_x = 0; ///<Slow channel reversal potential
+	static constexpr double g_ecs = g_ec_general; ///<Soma electrical coupling
+	static constexpr double g_eca = g_ec_general; ///<Axon electrical coupling
+
+	template<class E=LibmExp> static double p_inf(double _v){return 0;}
+	template<class E=LibmExp> static double tau_p(double _va){return 1;}
+	template<class E=LibmExp> static double q_inf(double _v){return 0;}
+	template<class E=LibmExp> static double tau_q(double _va){return 1;}
+};
+
+/*! N1M: IACh, p only.
+*/
+template<> struct NeuronTraits<VavoulisModel::N1M>
+{
+	static constexpr bool has_p = true;
+	static constexpr bool has_q = false;
+	static constexpr bool tau_p_varies = false;
+	static constexpr bool tau_q_varies = false;
+	static constexpr double g_x = 200;
+	static constexpr double E_x = -30;
+	static constexpr double g_ecs = g_ec_general;
+	static constexpr double g_eca = g_ec_general;
+
+	template<class E=LibmExp> static double p_inf(double _v){return 1 / (1+E::exp((-38.8 - _v)/10));}
+	template<class E=LibmExp> static double tau_p(double _va){return tau_p_N1M;}
+	template<class E=LibmExp> static double q_inf(double _v){return 0;}
+	template<class E=LibmExp> static double tau_q(double _va){return 1;}
+};
+
+/*! N2v: INaL, p and q with voltage dependent time constants.
+*/
+template<> struct NeuronTraits<VavoulisModel::N2v>
+{
+	static constexpr bool has_p = true;
+	static constexpr bool has_q = true;
+	static constexpr bool tau_p_varies = true;
+	static constexpr bool tau_q_varies = true;
+	static constexpr double g_x = 2;
+	static constexpr double E_x = 55;
+	static constexpr double g_ecs = g_ecs_N2v;
+	static constexpr double g_eca = g_eca_N2v;
+
+	template<class E=LibmExp> static double p_inf(double _v){return 1 / (1+E::exp((-51 - _v)/10.3));}
+	template<class E=LibmExp> static double tau_p(double _va){return 28.3 + 44.1 * E::exp(-(((-11.8 - _va)/26.6)*((-11.8 - _va)/26.6)));}
+	template<class E=LibmExp> static double q_inf(double _v){return 1 / (1+E::exp((-45-_v)/-3));}
+	template<class E=LibmExp> static double tau_q(double _va){return 187.6 + 637.7 * E::exp(-(((-9.5-_va)/23.3)*(((-9.5-_va)/23.3))));}
+};
+
+/*! N3t: IT, p and q.
+*/
+template<> struct NeuronTraits<VavoulisModel::N3t>
+{
+	static constexpr bool has_p = true;
+	static constexpr bool has_q = true;
+	static constexpr bool tau_p_varies = false;
+	static constexpr bool tau_q_varies = false;
+	static constexpr double g_x = 3.27;
+	static constexpr double E_x = 80;
+	static constexpr double g_ecs = g_ec_general;
+	static constexpr double g_eca = g_ec_general;
+
+	template<class E=LibmExp> static double p_inf(double _v){return 1 / (1+E::exp((-61.6 - _v)/5.6));}
+	template<class E=LibmExp> static double tau_p(double _va){return tau_p_N3t;}
+	template<class E=LibmExp> static double q_inf(double _v){return 1 / (1+E::exp((-73.2-_v)/-5.1));}
+	template<class E=LibmExp> static double tau_q(double _va){return tau_q_N3t;}
+};
+
+
+/*! AxonGates
+ * Axonal gating functions, the same for every neuron type.
+ */
+struct AxonGates
+{
+	template<class E=LibmExp> static double h_inf(double _va){return 1/(1 + E::exp((-55.2 - _va)/-7.1));}
+	template<class E=LibmExp> static double tau_h(double _va){return 1.1 + 7.2 * E::exp(-(((-61.3 - _va)/22.7)*((-61.3 - _va)/22.7)));}
+	template<class E=LibmExp> static double n_inf(double _va){return 1/(1 + E::exp((-30 - _va)/17.4));}
+	template<class E=LibmExp> static double tau_n(double _va){return 1.1 + 4.6 * E::exp(-(((-61 - _va)/54.3)*((-61 - _va)/54.3)));}
+	template<class E=LibmExp> static double m_inf(double _va){return 1/(1+E::exp((-34.6-_va)/9.6));}
+};
+
+#endif
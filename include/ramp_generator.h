@@ -47,6 +47,11 @@ class RampGenerator
 		*/	
 		double get_ext(double def, double _time);
 
+		double getMin() const {return min;} ///< Minimum value getter
+		double getMax() const {return max;} ///< Maximum value getter
+		double getStimInc() const {return stim_inc;} ///< Increment getter
+		double getStimDur() const {return stim_dur;} ///< Duration of each value getter
+
 
 		/*!
 		* @brief Prints Ramp Components 
@@ -0,0 +1,191 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+
+#ifndef REALTIME_LOOP_H
+#define REALTIME_LOOP_H
+
+#include <stdio.h>
+#include <time.h>
+#include <math.h>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+
+#include "cpg_simulator.h"
+#include "spsc_queue.h"
+
+#define RT_QUEUE 4096 ///<Records, spike events and inputs that fit in each queue
+#define RT_BUCKETS 24 ///<Buckets of the latency histograms
+
+
+/*! LatencyHistogram class
+ * Histogram of latencies in power of two buckets of microseconds: bucket 0 counts values below 1 us and bucket b values in [2^(b-1),2^b) us,
+ * the last one everything above. Adding a value does not allocate memory.
+ */
+class LatencyHistogram
+{
+	long counts[RT_BUCKETS]; ///<Values in each bucket
+	long n; ///<Number of values
+	double sum; ///<Sum of the values in us
+	double max; ///<Maximum value in us
+
+public:
+	LatencyHistogram(); ///< Void constructor, empty histogram
+
+	/*!
+	* @brief Adds a latency.
+	* @param us Latency in us, negative values count as 0
+	*/
+	void add(double us)
+	{
+		if(us < 0)
+			us = 0;
+		int b = us < 1 ? 0 : ilogb(us)+1;
+		counts[b < RT_BUCKETS ? b : RT_BUCKETS-1]++;
+		n++;
+		sum += us;
+		if(us > max)
+			max = us;
+	}
+
+	long getN(){return n;} ///< Number of values
+
+	/*!
+	* @brief Prints the count, mean and maximum and the non empty buckets.
+	* @param f File stream
+	* @param title Name of the histogram
+	*/
+	void print(FILE * f,const char * title);
+};
+
+
+/*! RealTimeLoop class
+ * Steps a CPGSimulator against the wall clock for closed-loop experiments: every period the control thread wakes up at an absolute deadline
+ * (clock_nanosleep with TIMER_ABSTIME on CLOCK_MONOTONIC), applies the inputs received, advances the simulation period ms (period/dt steps)
+ * and hands the records and spike events to an I/O thread. Inputs, records and spikes go through lock-free SPSCQueue, so the control thread never
+ * waits on files: when a queue is full the record or spike is dropped and counted. Optionally the control thread runs with SCHED_FIFO priority
+ * and the process memory is locked (mlockall), which usually needs root or CAP_SYS_NICE/CAP_IPC_LOCK, otherwise a warning is printed.
+ * Wake-up jitter (wake time minus deadline), compute time per tick and the lateness of the ticks that end after the next release (deadline misses)
+ * are kept in histograms. Only fixed step integrators. The currents of the protocol are compiled for the whole run before starting.
+ */
+class RealTimeLoop
+{
+public:
+	/*!
+	 Closed-loop input: the current of a neuron is held at value from time t (see StimProtocol::hold).
+	*/
+	struct Input
+	{
+		double t; ///<Simulated time in ms from which it applies, inputs in the past are applied at the next tick
+		int neuron; ///<Neuron id
+		double value; ///<Current, NAN to release the neuron to the protocol
+	};
+
+private:
+	/*! QueueSink class
+	 * Spike sink of the control thread, pushes the events to the spikes queue.
+	 */
+	class QueueSink : public SpikeSink
+	{
+		RealTimeLoop * loop; ///<Owner
+	public:
+		QueueSink(RealTimeLoop * loop):loop(loop){}
+		void write_header(const char * columns,const char * params){}
+		void write(const SpikeEvent * events,int n);
+	};
+
+	CPGSimulator * cpg; ///<Simulator
+	double period; ///<Wall-clock and simulated time per tick in ms
+	int priority; ///<SCHED_FIFO priority of the control thread, 0 for the normal scheduler
+	bool lock_memory; ///<Lock the process memory with mlockall during the run
+	int n_neurons; ///<Number of neurons
+	int rec_size; ///<Doubles per record: time, voltage of each neuron and current value
+
+	std::vector<double> slots; ///<Memory of the records, RT_QUEUE slots of rec_size
+	SPSCQueue<int> ready; ///<Slots with a record to write, control to I/O thread
+	SPSCQueue<int> spare; ///<Empty slots, I/O to control thread
+	SPSCQueue<SpikeEvent> spikes; ///<Spike events to write, control to I/O thread
+	SPSCQueue<Input> inputs; ///<Inputs, producer (input thread or push_input) to control thread
+	std::vector<double> tick_t; ///<Times of the records of a tick
+	std::vector<double> tick_v; ///<Voltages of the records of a tick
+	std::vector<double> tick_c; ///<Current values of the records of a tick
+
+	LatencyHistogram jitter; ///<Wake-up latency after the deadline
+	LatencyHistogram compute; ///<Time from the wake-up to the end of the tick
+	LatencyHistogram misses; ///<Time after the next release of the ticks that missed it
+	long ticks; ///<Ticks done
+	long steps_per_tick; ///<Simulation steps per tick
+	long dropped_records; ///<Records not written because the queue was full
+	long dropped_spikes; ///<Spike events not written because the queue was full
+	long applied; ///<Inputs applied
+
+	std::atomic<bool> running; ///<False when the helper threads must finish
+	FILE * f; ///<Trace file stream, NULL for no trace
+	SpikeSink * sink; ///<Spikes sink, written from the I/O thread
+	ShmPublisher * publisher; ///<Live stream of the records, written from the I/O thread, NULL for none
+	FILE * f_in; ///<Inputs file stream, NULL for no input thread
+	std::thread io; ///<I/O thread
+	std::thread in; ///<Input thread
+
+	/*!
+	* @brief I/O thread loop: writes the records as ascii lines to f (and publishes them) and the spike events to sink until the control thread stops and the queues are empty.
+	*/
+	void write_loop();
+
+	/*!
+	* @brief Input thread loop: reads lines "t neuron value" from f_in (neuron by name, value nan to release it) and pushes them to the inputs queue until
+	* the end of the file or of the run. The file may be a named pipe written by the experiment.
+	*/
+	void read_loop();
+
+public:
+	/*! RealTimeLoop constructor
+	* @param cpg Initialized simulator, its state is continued
+	* @param period Wall-clock time per tick in ms, the simulated time advances the same
+	* @param priority SCHED_FIFO priority (1-99) of the control thread, 0 for the normal scheduler
+	* @param lock_memory Lock the process memory during the run
+	*/
+	RealTimeLoop(CPGSimulator * cpg,double period,int priority,bool lock_memory);
+
+	/*!
+	* @brief Adds an input. From a single producer thread, and not while an inputs file is read.
+	* @return false if the queue is full
+	*/
+	bool push_input(const Input &input){return inputs.push(input);}
+
+	/*!
+	* @brief Publishes the records in shared memory too (decimated by the publisher), from the I/O thread.
+	*/
+	void set_publisher(ShmPublisher * publisher){this->publisher=publisher;}
+
+	/*!
+	* @brief Runs n_ticks ticks from the calling thread (the control thread). Records are "t V... c" lines each OUT_DECIMATION steps, the same 
+	* records as advance. Headers are written by the caller.
+	* @param f Trace file stream, NULL for no trace
+	* @param sink Spikes sink, written from the I/O thread
+	* @param f_in Inputs file stream, NULL for none
+	* @param n_ticks Ticks to run
+	* @param dt Time step, period must be a multiple of it
+	* @param integration Integration method, not ADAPTIVE nor ADAPTIVE_ROSENBROCK
+	* @return 1 on success, 0 on error (a message is printed)
+	*/
+	int run(FILE * f,SpikeSink * sink,FILE * f_in,long n_ticks,double dt,CPGSimulator::integrators integration);
+
+	/*!
+	* @brief Prints the report: ticks, deadline misses, dropped records and spikes, inputs and the latency histograms.
+	* @param f File stream, e.g. stdout
+	*/
+	void print(FILE * f);
+
+	long getMisses(){return misses.getN();} ///< Deadline misses
+};
+
+#endif
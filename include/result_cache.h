@@ -0,0 +1,93 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <string>
+#include <vector>
+
+#define CACHE_MODEL_VERSION "vavoulis-2007/1" ///<Stamp of the model in the cache keys, change it when a change in the code changes the results
+#define CACHE_SIZE 1024 ///<Default size limit of the cache in MB
+
+
+/*! ResultCache class
+ * Local cache of simulation results addressed by their inputs. The key is a canonical text with every input that changes the output files
+ * (one "name value" line each, doubles with all their digits and the contents of the input files) and the model version, and each entry is
+ * the directory <dir>/<hash of the key> with the output files and the key, so a hash collision is detected and treated as a miss.
+ * Entries are written in a temporary directory and renamed into place, and the cache is guarded by a lock file (flock): shared while an
+ * entry is copied out and exclusive while one is added and the oldest are evicted, so several processes can use the same directory.
+ * The size is limited by evicting the least recently used entries (the key file is touched on each hit).
+ */
+class ResultCache
+{
+	std::string dir; ///<Cache directory
+	long max_bytes; ///<Size limit
+	int lock_fd; ///<Lock file descriptor, -1 if the cache could not be opened
+
+	/*!
+	* @brief Locks the cache (LOCK_SH or LOCK_EX).
+	*/
+	void lock(int op);
+
+	/*!
+	* @brief Unlocks the cache.
+	*/
+	void unlock();
+
+	/*!
+	* @brief Removes the least recently used entries until the cache fits in max_bytes, and temporary directories of processes that ended.
+	* Called with the exclusive lock.
+	* @param keep Entry that is never removed
+	*/
+	void evict(const std::string &keep);
+
+public:
+	/*! ResultCache constructor
+	* @param dir Cache directory, created if needed
+	* @param max_mb Size limit in MB
+	*/
+	ResultCache(const char * dir,double max_mb=CACHE_SIZE);
+
+	~ResultCache();
+
+	bool isOpen(){return lock_fd >= 0;} ///< False if the directory could not be used (a message is printed)
+
+	/*!
+	* @brief 64 bits FNV-1a hash of a key as 16 hex digits.
+	*/
+	static std::string hash(const std::string &key);
+
+	/*!
+	* @brief Adds a "name value" line with the size and hash of the contents of a file to a key.
+	* @return 0 if the file can not be read
+	*/
+	static int add_file(std::string &key,const char * name,const char * file);
+
+	/*!
+	* @brief Copies the files of an entry to their destinations.
+	* @param key Canonical key of the run
+	* @param files Destination of each file, in the same order as in store
+	* @return 1 if the entry was found and copied, 0 on a miss
+	*/
+	int fetch(const std::string &key,const std::vector<std::string> &files);
+
+	/*!
+	* @brief Adds the output files of a run as the entry of key, replacing a previous one, and evicts old entries.
+	* @param key Canonical key of the run
+	* @param files Output files
+	* @return 1 on success, 0 otherwise (a message is printed)
+	*/
+	int store(const std::string &key,const std::vector<std::string> &files);
+
+	std::string getEntry(const std::string &key){return dir+"/"+hash(key);} ///< Directory of the entry of a key
+};
+
+#endif
@@ -0,0 +1,208 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+
+#ifndef SHM_STREAM_H
+#define SHM_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <atomic>
+
+#include "spike_events.h"
+
+#define SHM_MAGIC "CPGSHM"
+#define SHM_VERSION 1
+#define SHM_HEADER_SIZE 4096 ///<Bytes before the records ring
+#define SHM_COLUMNS 1024 ///<Bytes of the column names in the header
+#define SHM_RECORDS 65536 ///<Default records in the ring
+#define SHM_SPIKES 8192 ///<Default spike events in the ring
+#define SHM_DECIMATION 10 ///<Default trace records per published record
+
+
+/*!
+ Header of the shared memory segment. Offsets in bytes, all values little endian as in the machine:
+	0 magic "CPGSHM", 8 version u32, 12 n_cols u32, 16 rec_capacity u64, 24 spk_capacity u64, 32 rec_offset u64, 40 spk_offset u64,
+	48 dt f8, 56 decimation u32 (steps per record), 60 state u32 (0 running, 1 finished), 64 rec_seq u64, 128 spk_seq u64, 192 columns.
+ Each ring has a sequence counter: 2*n when n elements have been written, 2*n+1 while element n is being written in slot n%capacity.
+ Records are n_cols float64 "t V... c", spikes are 24 bytes t:f8 v:f8 neuron:i4 (and 4 bytes of padding).
+*/
+struct ShmHeader
+{
+	char magic[8]; ///<SHM_MAGIC
+	uint32_t version; ///<SHM_VERSION
+	uint32_t n_cols; ///<Doubles per record
+	uint64_t rec_capacity; ///<Records in the ring
+	uint64_t spk_capacity; ///<Spike events in the ring
+	uint64_t rec_offset; ///<Start of the records ring
+	uint64_t spk_offset; ///<Start of the spikes ring
+	double dt; ///<Time step
+	uint32_t decimation; ///<Steps per published record
+	std::atomic<uint32_t> state; ///<0 running, 1 finished
+	std::atomic<uint64_t> rec_seq; ///<Sequence counter of the records ring
+	char pad_rec[56]; ///<Keeps the counters in different cache lines
+	std::atomic<uint64_t> spk_seq; ///<Sequence counter of the spikes ring
+	char pad_spk[56]; ///<Keeps the counters away from the columns
+	char columns[SHM_COLUMNS]; ///<Space separated column names, first is time
+};
+
+/*!
+ Spike event as stored in the ring.
+*/
+struct ShmSpike
+{
+	double t; ///<Peak time
+	double v; ///<Peak membrane potential
+	int32_t neuron; ///<Neuron id
+	int32_t pad; ///<Padding to 24 bytes
+};
+
+
+/*! ShmPublisher class
+ * Publishes decimated records and spike events of a running simulation in a POSIX shared memory segment (/dev/shm/<name>), so monitors can
+ * attach and follow it live (see ShmReader, shm_monitor and utils/shm_reader.py). Both rings are overwritten in circles and the publisher never 
+ * waits for readers: each element is written in place between two increments of the sequence counter of its ring (a sequence lock), and a reader
+ * that falls behind detects the overwritten elements and skips them.
+ * Records are published from CPGSimulator::write (set_publisher), spikes as a SpikeSink that passes the events on to another sink.
+ * The segment is removed when the publisher is destroyed, readers attached keep their mapping and see the finished state.
+ */
+class ShmPublisher : public SpikeSink
+{
+	std::string name; ///<Segment name
+	ShmHeader * header; ///<Mapped segment
+	size_t size; ///<Segment size in bytes
+	double * records; ///<Records ring
+	ShmSpike * spikes; ///<Spikes ring
+	uint64_t rec_head; ///<Records written
+	uint64_t spk_head; ///<Spike events written
+	int count; ///<Trace records since the last published one
+	int decimation; ///<Trace records per published record
+	SpikeSink * next; ///<Sink the events are passed on to, NULL to discard them
+
+public:
+	/*! ShmPublisher constructor
+	* @param next Sink the events are passed on to, NULL to discard them
+	*/
+	ShmPublisher(SpikeSink * next=NULL);
+
+	/*!
+	* @brief Removes the segment after marking it finished.
+	*/
+	~ShmPublisher();
+
+	/*!
+	* @brief Creates the segment, replacing an old one with the same name.
+	* @param name Segment name, e.g. /cpg_live
+	* @param columns Space separated column names of the records, first is time
+	* @param dt Time step
+	* @param steps Steps between trace records (OUT_DECIMATION)
+	* @param decimation Trace records per published record
+	* @param rec_capacity Records in the ring
+	* @param spk_capacity Spike events in the ring
+	* @return 1 on success, 0 on error (a message is printed)
+	*/
+	int open(const char * name,const char * columns,double dt,int steps,int decimation=SHM_DECIMATION,long rec_capacity=SHM_RECORDS,long spk_capacity=SHM_SPIKES);
+
+	int getNCols(){return header ? header->n_cols : 0;} ///< Doubles per record
+
+	/*!
+	* @brief Counts a trace record and tells if it is published.
+	*/
+	bool due()
+	{
+		if(++count < decimation)
+			return false;
+		count = 0;
+		return true;
+	}
+
+	/*!
+	* @brief Starts a record: marks its slot as being written and returns it, getNCols doubles to fill before commit.
+	*/
+	double * begin()
+	{
+		header->rec_seq.store(2*rec_head+1,std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		return records+(rec_head%header->rec_capacity)*header->n_cols;
+	}
+
+	/*!
+	* @brief Ends the record started with begin, readers can take it.
+	*/
+	void commit()
+	{
+		rec_head++;
+		header->rec_seq.store(2*rec_head,std::memory_order_release);
+	}
+
+	/*!
+	* @brief Publishes the events and passes them on to the next sink.
+	*/
+	void write(const SpikeEvent * events,int n);
+
+	/*!
+	* @brief Writes the header of the next sink.
+	*/
+	void write_header(const char * columns,const char * params){if(next) next->write_header(columns,params);}
+
+	FILE * getFile(){return next ? next->getFile() : NULL;}
+};
+
+
+/*! ShmReader class
+ * Attaches to the segment of a ShmPublisher and reads the elements written since the previous read. Reads never block the publisher: the elements
+ * are copied and the sequence counter is read again, those overwritten meanwhile are dropped and counted as lost.
+ */
+class ShmReader
+{
+	ShmHeader * header; ///<Mapped segment
+	size_t size; ///<Segment size in bytes
+	uint64_t rec_next; ///<Next record to read
+	uint64_t spk_next; ///<Next spike event to read
+
+	/*!
+	* @brief Reads elements of a ring (see read_records).
+	*/
+	long read_ring(std::atomic<uint64_t> &seq,const char * ring,size_t elem_size,uint64_t capacity,uint64_t &next,char * out,long max,long * lost);
+
+public:
+	ShmReader():header(NULL),size(0),rec_next(0),spk_next(0){} ///< Void constructor
+
+	~ShmReader(); ///< Unmaps the segment
+
+	/*!
+	* @brief Maps the segment.
+	* @param name Segment name
+	* @param from_start Read from the oldest elements in the rings, otherwise only the new ones
+	* @return 1 on success, 0 on error (a message is printed)
+	*/
+	int open(const char * name,bool from_start=false);
+
+	int getNCols(){return header->n_cols;} ///< Doubles per record
+	const char * getColumns(){return header->columns;} ///< Column names
+	bool finished(){return header->state.load(std::memory_order_acquire) != 0;} ///< True when the simulation has ended
+
+	/*!
+	* @brief Copies the records written since the previous read.
+	* @param out Buffer of max*getNCols() doubles
+	* @param max Records that fit in out
+	* @param lost Incremented with the records overwritten before they were read, if not NULL
+	* @return Records copied
+	*/
+	long read_records(double * out,long max,long * lost);
+
+	/*!
+	* @brief Copies the spike events written since the previous read (see read_records).
+	*/
+	long read_spikes(ShmSpike * out,long max,long * lost);
+};
+
+#endif
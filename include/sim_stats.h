@@ -0,0 +1,92 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+#ifndef SIM_STATS_H
+#define SIM_STATS_H
+
+#include <stdio.h>
+#include <time.h>
+#include <chrono>
+
+
+/*! SimStats class
+ * Profiling counters of the simulation loop: time spent in each phase, wall-clock and CPU time, and work done.
+ * Phases are timed as laps: lap(p) adds the time since the previous lap to p, so each step reads the clock once per phase and
+ * the time of the loop itself goes to the next phase. CPGSimulator only updates the counters when it is given a SimStats (set_stats),
+ * otherwise the cost is a pointer test per phase.
+ * CPU time is the one of the whole process, so it includes the asynchronous writer and the threads of the parallel stepping.
+ */
+class SimStats
+{
+public:
+	/*!Phases of the simulation loop
+	* INTEGRATION: update of the variables (update_all, update_adaptive), including the stimulation current.
+	* SPIKES: spike detection and writing the spike events.
+	* OUTPUT: writing the trace and flushing the asynchronous writer.
+	* PROTOCOL: next change of the stimulation protocol in the adaptive loop (in the fixed step loop it is part of INTEGRATION).
+	* CHECKPOINT: writing checkpoints.
+	*/
+	enum phases{INTEGRATION,SPIKES,OUTPUT,PROTOCOL,CHECKPOINT,n_phases};
+	static const char * phase_names[n_phases]; ///<Names of the phases in the report
+
+	typedef std::chrono::steady_clock clock; ///<Clock of the phases and wall time
+
+	double phase_time[n_phases]; ///<Time in each phase in seconds
+	double wall; ///<Wall-clock time in seconds
+	double cpu; ///<Process CPU time in seconds
+	long steps; ///<Integration steps (accepted steps in the adaptive integrators)
+	long rhs_evals; ///<Evaluations of the differential equations of the whole network
+	long exp_calls; ///<Calls to exp and expm1 in the equations and in the exponential integrators (0 for gating functions read from tables)
+	long spikes; ///<Spike events emitted
+	long trace_bytes; ///<Bytes written to the trace file
+	long spike_bytes; ///<Bytes written to the spikes file
+
+	SimStats(); ///< Void constructor, all counters to 0
+
+	/*!
+	* @brief Starts measuring wall-clock and CPU time and the first lap.
+	*/
+	void start();
+
+	/*!
+	* @brief Stops measuring wall-clock and CPU time, which are added to wall and cpu. start and stop can be called again to accumulate several runs.
+	*/
+	void stop();
+
+	/*!
+	* @brief Adds the time since the previous lap (or start) to a phase.
+	* @param p Phase
+	*/
+	void lap(phases p)
+	{
+		clock::time_point now = clock::now();
+		phase_time[p] += std::chrono::duration<double>(now-mark).count();
+		mark = now;
+	}
+
+	/*!
+	* @brief Prints the report: time per phase with its share of the wall time, wall and CPU time and counters with their rates.
+	* @param f File stream, e.g. stdout
+	*/
+	void print(FILE * f);
+
+	/*!
+	* @brief Writes the report as a JSON object.
+	* @param file File name
+	* @return 1 on success, 0 on error (a message is printed)
+	*/
+	int write_json(const char * file);
+
+private:
+	clock::time_point mark; ///<End of the previous lap
+	clock::time_point wall_begin; ///<Wall-clock time at start
+	clock_t cpu_begin; ///<CPU time at start
+};
+
+#endif
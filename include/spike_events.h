@@ -0,0 +1,187 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+#ifndef SPIKE_EVENTS_H
+#define SPIKE_EVENTS_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "async_writer.h"
+
+#define SPIKE_RING_SIZE 256 ///<Events kept before they are sent to the sink
+#define SPIKES_MAGIC "CPGSPIKES"
+#define SPIKES_VERSION 1
+
+
+/*!
+ Spike record.
+*/
+struct SpikeEvent
+{
+	double t; ///<Peak time, interpolated between steps
+	double v; ///<Peak membrane potential
+	int neuron; ///<Neuron id
+};
+
+/*!
+* @brief Builds the event of a spike detected by the change of sign of dV between two samples.
+* dV is assumed linear between the samples, so the peak is where it crosses zero.
+* @param neuron Neuron id
+* @param t Time of the current sample
+* @param h Time since the previous sample
+* @param prev Previous dV (positive)
+* @param dev Current dV (negative)
+* @param v Current membrane potential
+*/
+inline SpikeEvent spike_event(int neuron,double t,double h,double prev,double dev,double v)
+{
+	SpikeEvent ev;
+	double frac = prev/(prev-dev);
+	ev.t = t-h+frac*h;
+	ev.v = v-0.5*dev*(t-ev.t);
+	ev.neuron = neuron;
+	return ev;
+}
+
+/*!
+* @brief Writes a binary file header: "<magic> <version>", "header_size <bytes>" and body lines,
+* padded with spaces to a multiple of 64 bytes and ending in a new line.
+* @param f File stream
+* @param magic File type
+* @param version File version
+* @param body Header lines
+*/
+void write_bin_header(FILE * f,const char * magic,int version,std::string body);
+
+
+/*! SpikeSink class
+ * Destination of spike events. Sinks may write through an AsyncWriter.
+ */
+class SpikeSink
+{
+public:
+	virtual ~SpikeSink(){}
+
+	/*!
+	* @brief Writes the file header.
+	* @param columns Space separated column names, first is time and then one per neuron.
+	* @param params Parameters lines ("name value" separated by new lines), NULL if none.
+	*/
+	virtual void write_header(const char * columns,const char * params)=0;
+
+	/*!
+	* @brief Writes n events, in time order.
+	*/
+	virtual void write(const SpikeEvent * events,int n)=0;
+
+	/*!
+	* @brief File written by the sink, NULL if it does not write to a file.
+	*/
+	virtual FILE * getFile(){return NULL;}
+};
+
+/*! TextSpikeSink class
+ * Ascii spikes file: spike threshold line, columns line and one line per spike "t v , , ," with the value in the column of the neuron and ',' in the rest.
+ */
+class TextSpikeSink : public SpikeSink
+{
+	FILE * f; ///<File stream
+	int n_neurons; ///<Number of neuron columns
+	AsyncWriter * writer; ///<Asynchronous writer, NULL for direct output
+	std::vector<char> line; ///<Line buffer
+
+public:
+	/*! TextSpikeSink constructor
+	* @param f File stream
+	* @param n_neurons Number of neuron columns
+	* @param writer Asynchronous writer, NULL for direct output
+	*/
+	TextSpikeSink(FILE * f,int n_neurons,AsyncWriter * writer=NULL):f(f),n_neurons(n_neurons),writer(writer),line(64+32*n_neurons){}
+
+	void write_header(const char * columns,const char * params);
+	void write(const SpikeEvent * events,int n);
+	FILE * getFile(){return f;}
+};
+
+/*! BinSpikeSink class
+ * Binary spikes file: text header as in the binary traces (magic CPGSPIKES) followed by 16 byte records t:f8 v:f4 neuron:i4.
+ */
+class BinSpikeSink : public SpikeSink
+{
+	FILE * f; ///<File stream
+	int n_neurons; ///<Number of neurons
+	AsyncWriter * writer; ///<Asynchronous writer, NULL for direct output
+
+public:
+	/*! BinSpikeSink constructor
+	* @param f File stream
+	* @param n_neurons Number of neurons, the names of the first n_neurons columns after time are written in the header
+	* @param writer Asynchronous writer, NULL for direct output
+	*/
+	BinSpikeSink(FILE * f,int n_neurons,AsyncWriter * writer=NULL):f(f),n_neurons(n_neurons),writer(writer){}
+
+	void write_header(const char * columns,const char * params);
+	void write(const SpikeEvent * events,int n);
+	FILE * getFile(){return f;}
+};
+
+/*! NullSpikeSink class
+ * Discards the spike events, when no spikes file is written.
+ */
+class NullSpikeSink : public SpikeSink
+{
+public:
+	void write_header(const char * columns,const char * params){}
+	void write(const SpikeEvent * events,int n){}
+};
+
+
+/*! SpikeRing class
+ * Fixed size ring of events between the detection and the sink. No memory is allocated after construction.
+ */
+class SpikeRing
+{
+	SpikeEvent events[SPIKE_RING_SIZE]; ///<Ring storage
+	int head; ///<Oldest event
+	int count; ///<Number of events
+
+public:
+	SpikeRing():head(0),count(0){}
+
+	int size(){return count;} ///< Number of events getter
+	bool full(){return count==SPIKE_RING_SIZE;} ///< True if no more events fit
+
+	/*!
+	* @brief Adds an event. The ring must not be full.
+	*/
+	void push(const SpikeEvent &ev)
+	{
+		events[(head+count)%SPIKE_RING_SIZE] = ev;
+		count++;
+	}
+
+	/*!
+	* @brief Sends all events to the sink and empties the ring.
+	*/
+	void drain(SpikeSink & sink)
+	{
+		if(count == 0)
+			return;
+		int first = SPIKE_RING_SIZE-head < count ? SPIKE_RING_SIZE-head : count;
+		sink.write(events+head,first);
+		if(count > first)
+			sink.write(events,count-first);
+		head = (head+count)%SPIKE_RING_SIZE;
+		count = 0;
+	}
+};
+
+#endif
@@ -0,0 +1,75 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <vector>
+#include <stddef.h>
+
+
+/*! SPSCQueue class
+ * Bounded lock-free queue for one producer thread and one consumer thread.
+ * push and pop never block, they return false when the queue is full or empty.
+ */
+template <typename T>
+class SPSCQueue
+{
+	std::vector<T> items; ///<Ring buffer, capacity+1 slots
+	size_t size; ///<Number of slots
+	std::atomic<size_t> head; ///<Next slot to read, written by the consumer
+	char pad[64]; ///<Keeps head and tail in different cache lines
+	std::atomic<size_t> tail; ///<Next slot to write, written by the producer
+
+public:
+	/*! SPSCQueue constructor
+	* @param capacity Maximum number of elements in the queue
+	*/
+	SPSCQueue(size_t capacity):items(capacity+1),size(capacity+1),head(0),tail(0){}
+
+	/*!
+	* @brief Adds an element. Producer thread only.
+	* @return false if the queue is full.
+	*/
+	bool push(const T &item)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		size_t next = t+1 == size ? 0 : t+1;
+		if(next == head.load(std::memory_order_acquire))
+			return false;
+		items[t] = item;
+		tail.store(next,std::memory_order_release);
+		return true;
+	}
+
+	/*!
+	* @brief Removes the oldest element. Consumer thread only.
+	* @return false if the queue is empty.
+	*/
+	bool pop(T &item)
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		if(h == tail.load(std::memory_order_acquire))
+			return false;
+		item = items[h];
+		head.store(h+1 == size ? 0 : h+1,std::memory_order_release);
+		return true;
+	}
+
+	/*!
+	* @brief True if there are no elements. Approximate when called from the producer.
+	*/
+	bool empty()
+	{
+		return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+	}
+};
+
+#endif
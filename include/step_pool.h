@@ -0,0 +1,80 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+#ifndef STEP_POOL_H
+#define STEP_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define POOL_SPINS 2000 ///<Busy-wait iterations before yielding the processor
+#define POOL_YIELDS 200 ///<Yields before an idle worker blocks until the next job
+
+
+/*! StepPool class
+ * Persistent worker threads that run the same job once per integration step, for the parallel stepping of large networks.
+ * The thread calling run takes part as thread 0, so a pool of n threads starts n-1 workers.
+ * Threads of a job synchronize with barrier, a counting barrier with a generation number that busy-waits for a short time and then yields,
+ * so a stage of a step costs a few hundred nanoseconds of synchronization. With more threads than processors waits yield from the start,
+ * since the thread being waited for needs the processor.
+ * Idle workers block on a condition variable, so a pool left unused does not take processor time.
+ * run and barrier must not be called from different jobs at the same time.
+ */
+class StepPool
+{
+	int n_threads; ///<Threads taking part in each job, including the caller
+	int spins; ///<Busy-wait iterations before yielding, 0 when there are more threads than processors
+	std::vector<std::thread> workers; ///<Worker threads 1..n_threads-1
+	const std::function<void(int)> * job; ///<Job of the current run
+	std::atomic<long> job_gen; ///<Incremented by run to start a job
+	std::atomic<int> done; ///<Workers that finished the current job
+	std::atomic<int> arrived; ///<Threads waiting in the current barrier
+	std::atomic<long> barrier_gen; ///<Incremented when all threads reach the barrier
+	std::atomic<int> sleepers; ///<Workers blocked in the condition variable
+	std::atomic<bool> running; ///<False when the workers must finish
+	std::mutex mtx; ///<Protects the condition variable
+	std::condition_variable wake; ///<Wakes the blocked workers when a job starts
+
+	/*!
+	* @brief Worker thread loop: waits for a job, runs it and reports it done.
+	* @param tid Thread index
+	*/
+	void worker(int tid);
+
+public:
+	/*! StepPool constructor
+	* @brief Starts n_threads-1 worker threads.
+	* @param n_threads Threads taking part in each job, including the caller
+	*/
+	StepPool(int n_threads);
+
+	/*!
+	* @brief Stops the worker threads.
+	*/
+	~StepPool();
+
+	int size(){return n_threads;} ///< Number of threads, including the caller
+
+	/*!
+	* @brief Runs job(tid) on every thread, tid from 0 (the caller) to size()-1, and returns when all of them finish.
+	* @param job Job function
+	*/
+	void run(const std::function<void(int)> &job);
+
+	/*!
+	* @brief Waits until every thread of the current job has reached the barrier. Memory written before the barrier is visible after it.
+	*/
+	void barrier();
+};
+
+#endif
@@ -0,0 +1,174 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+#ifndef STIM_PROTOCOL_H
+#define STIM_PROTOCOL_H
+
+#include <math.h>
+#include <string>
+#include <vector>
+
+#include "ramp_generator.h"
+
+#define PROTOCOL_HORIZON 10000.0 ///<Time compiled at first in ms, doubled each time it is reached
+#define SATIATED_N3T 25.0 ///<N3t current during the satiated activity, N1M is set to 0
+
+
+/*! StimProtocol class
+ * Injected current of each neuron as a schedule of steps, ramps and pulse trains, compiled into a table of piecewise-constant segments per
+ * neuron. Items are applied in order: STEP and RAMP set the current during [t0,t1) (the last one wins), PULSES are added on top.
+ * The base items come from the current values of the simulator (constant, or the ramp of RampGenerator for -1 values), then the items
+ * added or loaded from a protocol file and last the satiated window, which sets N1M to 0 and N3t to SATIATED_N3T.
+ * The table is compiled up to a horizon that is extended when the simulation reaches it, so items may last forever.
+ * The simulator calls seek with the time of each step and reads the currents with value. While the step is before the next change seek is a
+ * comparison, otherwise the cursor of each neuron moves forward, so the integrator does no per-stage arithmetic. Times in ms, currents in nA.
+ */
+class StimProtocol
+{
+public:
+	enum kinds{STEP,RAMP,PULSES,n_kinds}; ///<Item kinds
+	static const char * kind_names[n_kinds]; ///<Names of the kinds in protocol files
+
+	/*!
+	 Protocol item, active in [t0,t1).
+	*/
+	struct Item
+	{
+		int kind; ///<Kind from kinds
+		int neuron; ///<Neuron id
+		double t0; ///<Start time
+		double t1; ///<End time, INFINITY for no end
+		double p[4]; ///<STEP: value. RAMP: min, max, increment and duration of each value, up and down as RampGenerator. PULSES: amplitude, width and period
+	};
+
+private:
+	std::vector<int> types; ///<Neuron types (VavoulisModel::types)
+	std::vector<Item> base; ///<Items from the current values
+	std::vector<Item> items; ///<Added items
+	double sat_t0; ///<Satiated window start, INFINITY for none
+	double sat_t1; ///<Satiated window end
+	int i_ramp; ///<Neuron of the first ramp, -1 if none
+
+	double horizon; ///<Time compiled
+	std::vector<std::vector<double> > starts; ///<Segment start times of each neuron, the first one is -INFINITY
+	std::vector<std::vector<double> > values; ///<Segment currents of each neuron
+	std::vector<int> cursor; ///<Current segment of each neuron
+	std::vector<double> current; ///<Current of each neuron at the time of the last seek
+	std::vector<double> held; ///<Current set by hold for each neuron, NAN to follow the segments
+	double t_cur; ///<Time of the last seek
+	double t_next; ///<Start of the next segment of any neuron (or the horizon)
+
+	/*!
+	* @brief Builds the segments of every neuron up to horizon and moves the cursors to the first one.
+	*/
+	void compile(double horizon);
+
+	/*!
+	* @brief Compiles the protocol after a change of the items, keeping the time of the last seek.
+	*/
+	void rebuild();
+
+	/*!
+	* @brief Value of an item at a time inside a segment (not at a change of the item).
+	*/
+	static double item_value(const Item &it,double t);
+
+	/*!
+	* @brief Adds to times the changes of an item before horizon.
+	*/
+	static void item_changes(const Item &it,double horizon,std::vector<double> &times);
+
+public:
+	StimProtocol():sat_t0(INFINITY),sat_t1(INFINITY),i_ramp(-1),horizon(0),t_cur(0),t_next(0){}
+
+	/*!
+	* @brief Starts an empty protocol.
+	* @param types Type of each neuron, used by the satiated window
+	*/
+	void init(const std::vector<int> &types);
+
+	/*!
+	* @brief Replaces the base items: a constant current for each value, or the ramp for -1 values (its minimum if rg has no ramp).
+	* @param c_values Current value of each neuron
+	* @param rg Ramp of the -1 values
+	*/
+	void set_currents(const std::vector<double> &c_values,const RampGenerator &rg);
+
+	/*!
+	* @brief Adds an item after the previous ones.
+	* @return 1, 0 if the neuron or the parameters are not valid (a message is printed)
+	*/
+	int add(const Item &it);
+
+	/*!
+	* @brief Replaces the satiated window.
+	* @param t0 Start time, INFINITY for no window
+	* @param t1 End time, INFINITY for no end
+	*/
+	void satiated(double t0,double t1);
+
+	/*!
+	* @brief Adds the items of a protocol file, one per line (# for comments):
+	*	step <neuron> <value> <t0> [t1]
+	*	ramp <neuron> <min> <max> <increment> <duration> <t0> [t1]
+	*	pulses <neuron> <amplitude> <width> <period> <t0> [t1]
+	*	satiated <t0> [t1]
+	* @param file File name
+	* @param names Neuron names
+	* @return 1 on success, 0 on error (a message is printed)
+	*/
+	int load(const char * file,const std::vector<std::string> &names);
+
+	/*!
+	* @brief Moves the cursors to time t, setting the current of each neuron. Moving back is allowed (e.g. after load_checkpoint).
+	*/
+	void seek(double t)
+	{
+		if(t >= t_cur && t < t_next)
+		{
+			t_cur = t;
+			return;
+		}
+		move(t);
+	}
+
+	/*!
+	* @brief Moves the cursors to time t when there is a change since the last seek (see seek).
+	*/
+	void move(double t);
+
+	/*!
+	* @brief Sets the current of neuron i to value until it is released, replacing the segments (e.g. closed-loop input). No memory is allocated.
+	* @param i Neuron id
+	* @param value Current, NAN to release the neuron to its segments
+	*/
+	void hold(int i,double value);
+
+	/*!
+	* @brief Compiles the segments up to time t, so seek does not compile (and allocate) before it.
+	*/
+	void extend(double t);
+
+	double value(int i) const {return current[i];} ///< Current of neuron i at the last seek
+	double getNextChange() const {return t_next;} ///< Time of the next change after the last seek (or the compiled horizon)
+
+	int ramp_neuron() const {return i_ramp;} ///< Neuron stimulated by the first ramp, -1 if none
+
+	/*!
+	* @brief Satiated window status at time t: 0 before, 1 inside, 2 after (0 without window).
+	*/
+	int satiated_status(double t) const {return t < sat_t0 ? 0 : (t < sat_t1 ? 1 : 2);}
+
+	/*!
+	* @brief Number of segments compiled, for all neurons.
+	*/
+	long getNSegments() const;
+};
+
+#endif
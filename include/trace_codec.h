@@ -0,0 +1,113 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+#ifndef TRACE_CODEC_H
+#define TRACE_CODEC_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define DELTA_MAGIC "CPGDELTA"
+#define DELTA_VERSION 1
+#define DELTA_BLOCK 4096 ///<Records per block of the delta format
+#define DELTA_RESOLUTION 1e-6 ///<Default quantization step of the delta format, the precision of the ascii format
+
+
+/*! DeltaEncoder class
+ * Lossless compression of trace records in independently decodable blocks. Each value is mapped to an integer: quantized as round(x/resolution),
+ * or with resolution 0 its IEEE 754 bit pattern, bit-exact. Time (first column) is always bit-exact.
+ * Records are buffered until a block is full. A block is column by column the second differences of the integers (residual of the linear
+ * prediction 2*x[k-1]-x[k-2], with zeros before the first record of the block), zigzag mapped to unsigned and written as LEB128 varints.
+ * Smooth traces give residuals close to 0 and about one byte per value. Block layout:
+ *	uint32 records, uint32 payload bytes, payload
+ * The file header is the one of the binary traces with magic CPGDELTA (see CPGSimulator::write_header).
+ */
+class DeltaEncoder
+{
+	int n_cols; ///<Values per record
+	double resolution; ///<Quantization step, 0 for bit-exact values
+	int block_records; ///<Records per block
+	int n_recs; ///<Records buffered
+	std::vector<int64_t> recs; ///<Integers of the buffered records, row major
+	std::vector<unsigned char> block; ///<Encoded block
+
+public:
+	DeltaEncoder():n_cols(0),resolution(0),block_records(DELTA_BLOCK),n_recs(0){}
+
+	/*!
+	* @brief Sets the layout of the records, discarding the buffered ones.
+	* @param n_cols Values per record
+	* @param resolution Quantization step of all the columns but the first one, 0 for bit-exact values
+	* @param block_records Records per block
+	*/
+	void init(int n_cols,double resolution,int block_records=DELTA_BLOCK);
+
+	int getNCols(){return n_cols;} ///< Values per record
+	int pending(){return n_recs;} ///< Records buffered
+
+	/*!
+	* @brief Adds a record.
+	* @param vals n_cols values
+	* @return true if the block is full and has to be encoded
+	*/
+	bool add(const double * vals);
+
+	/*!
+	* @brief Encodes the buffered records in a block and empties the buffer.
+	* @return Block bytes, empty if there were no records. Valid until the next encode.
+	*/
+	const std::vector<unsigned char> & encode();
+
+	/*!
+	* @brief Integer of a value.
+	* @param x Value
+	* @param resolution Quantization step, 0 for the bit pattern
+	*/
+	static int64_t to_int(double x,double resolution);
+
+	/*!
+	* @brief Value of an integer, inverse of to_int (up to the quantization).
+	*/
+	static double from_int(int64_t q,double resolution);
+};
+
+
+/*! DeltaDecoder class
+ * Reader of delta trace files, block by block.
+ */
+class DeltaDecoder
+{
+	FILE * f; ///<File stream, after the header
+	std::vector<unsigned char> payload; ///<Block payload
+
+public:
+	std::vector<std::string> columns; ///<Column names
+	double resolution; ///<Quantization step, 0 for bit-exact values
+	std::string params; ///<Header lines other than the magic, header_size, columns, resolution and block_records (dt, decimation and simulation parameters)
+
+	DeltaDecoder():f(NULL),resolution(0){}
+
+	/*!
+	* @brief Reads the header.
+	* @param f File stream at the start of the file
+	* @return 1 on success, 0 if it is not a delta trace (a message is printed)
+	*/
+	int open(FILE * f);
+
+	/*!
+	* @brief Decodes the next block.
+	* @param vals Set to the records, row major
+	* @return Records in the block, 0 at the end of the file, -1 for a truncated or corrupt block (a message is printed)
+	*/
+	int read_block(std::vector<double> &vals);
+};
+
+#endif
@@ -12,6 +12,8 @@
 #include <math.h>
 #include <iterator>
 
+#include "gating_table.h"
+
 using namespace std;
 
 #ifndef MODEL_H
@@ -122,6 +124,11 @@ public:
  	*/
 	double getIsyn(){return isyn;}
 
+	/*!
+ 	* @brief Restores the last dV and Isyn, used when the variables are loaded from a checkpoint.
+ 	*/
+	void setLast(double dv,double isyn){dv_value=dv;this->isyn=isyn;}
+
 	
 	/*!
  	* @brief Name getter
@@ -135,6 +142,9 @@ public:
 	
 	static int getNVars(){return n_variables;}///< returns the number of variables. 
 
+	int getNExp(); ///< Calls to exp in one evaluation of the equations of this neuron type, 0 if gating functions are read from tables
+	int getNGated(); ///< Variables with a time constant (gating variables of this neuron type), integrated with exp by the Rush-Larsen integrators
+
 	void sumValue(int index,double value);///< Sets _variables[index]+=value
 	double getVar(int index); ///< Returns _variables[index]
 	void setVar(int index,double value);///< Sets _variables[index]=value
@@ -146,6 +156,13 @@ public:
 	 */
 	std::vector<double> getVariables();
 
+	/*!
+	 * 
+	 * @brief variables array getter without allocation.
+	 * @param vars destination array, at least n_variables long.
+	 */
+	void getVariables(double * vars);
+
 	/*!
 	 * 
 	 * @brief Updates the n_variables in variables array with the data in v. 
@@ -154,6 +171,13 @@ public:
 	 */
 	void set_variables(const std::vector<double> &v);
 
+	/*!
+	 * 
+	 * @brief Updates the n_variables in variables array with the data in v. 
+	 * @param v array containing new variables values, at least n_variables long.
+	 */
+	void set_variables(const double * v);
+
 	
 	/*!
 	 * @brief Integrates variables based on dt.
@@ -174,6 +198,45 @@ public:
 	 * @param i_syn synaptic current received.
 	 */
 	void diffs_fun(double _time, vector<double> &vars, vector<double> &fvec, double iext,double i_syn);
+
+	/*!
+	 * 
+	 * @brief Overload of diffs_fun working on raw arrays, used by the integrators to avoid allocations.
+	 * @param _time Current time for the differential equation. 
+	 * @param vars array with previous instant variables values (n_variables long). 
+	 * @param fvec return array with computed differential values (n_variables long).
+	 * @param iext injected current received.
+	 * @param i_syn synaptic current received.
+	 */
+	void diffs_fun(double _time, const double * vars, double * fvec, double iext,double i_syn);
+
+	/*!
+	 * 
+	 * @brief Overload of diffs_fun that also returns the time constant of each variable with the form (x_inf-x)/tau, used by the Rush-Larsen integrator.
+	 * @param _time Current time for the differential equation. 
+	 * @param vars array with previous instant variables values (n_variables long). 
+	 * @param fvec return array with computed differential values (n_variables long).
+	 * @param iext injected current received.
+	 * @param i_syn synaptic current received.
+	 * @param tau return array with the time constants (n_variables long), 0 for the voltages and the variables the type does not use.
+	 */
+	void diffs_fun(double _time, const double * vars, double * fvec, double iext,double i_syn,double * tau);
+
+	/*!
+	 * 
+	 * @brief Builds the lookup tables of the steady-state and time constant functions (once per neuron type, axon functions are shared) and uses them instead of exp from now on.
+	 * @param interp Interpolation type
+	 * @param step Table step in mV
+	 */
+	static void build_tables(GatingTable::interpolations interp,double step);
+
+	/*!
+	 * 
+	 * @brief Maximum error of the lookup tables.
+	 * @param worst Set to the name of the function with the maximum error, if not NULL.
+	 * @return Maximum absolute error, 0 if tables are not in use.
+	 */
+	static double tables_error(const char ** worst);
 	
 
 	/*!
@@ -184,115 +247,54 @@ public:
 	*/
 	void print();
 private: 
-		/////////////////////////////////////////////////////////////////
-	//////////// 			SOMA 		///////////////////////
-	/////////////////////////////////////////////////////////////////
-
 	/*!
-	 * p differential equation
-	 * @brief differential equation corresponding to p neurotransmitor in iX channels from the Somatic compartment. Its equation depends on the neuron type. 
-	 * @param _v Voltage value at soma compartment
-	 * @param _va Voltage value at axon compartment
-	 * @param _p previous p value. (usually _variables[p])
-	 * @return result for the equation for the corresponding neuron. 
-	 * @see Vavoulis et al. [1] 
-	 */
-	double dp(double _v,double _va,double _p); 
-
-	/*!
-	 * q differential equation
-	 * @brief differential equation corresponding to q neurotransmitor in iX channels from the somatic compartment. Its equation depends on the neuron type. 
-	 * @param _v Voltage value at soma compartment
-	 * @param _va Voltage value at axon compartment
-	 * @param _q previous q value. (usually _variables[q])
-	 * @return result for the equation for the corresponding neuron. 
-	 * @see Vavoulis et al. [1] 
-	 */
-	double dq(double _v,double _va,double _q);
+	 Tabulated functions references for tables array
+	*/
+	enum gates {P_INF,TAU_P,Q_INF,TAU_Q,H_INF,TAU_H,N_INF,TAU_N,M_INF,n_gates};
 
+	static bool use_tables; ///< True if gating functions are read from tables
+	static GatingTable * tables[n_types][n_gates]; ///< Table of each function for each neuron type, NULL if not used by that type
+	static std::vector<GatingTable *> table_list; ///< Tables built, each one once
 
 	/*!
-	 * Slow channel from the somatic compartment
-	 * @brief Ixs channel represents either IACh, INaL or IT for N1M, N2v or N3t, respectively. Represent slow activity in the somatic compartment. 
-	 * @param _v Voltage value at soma compartment
-	 * @param _p value (usually _variables[p])
-	 * @param _q value (usually _variables[q])
-	 * @return channel value in mV. 
-	 * @see Vavoulis et al. [1] 
+	 * @brief Gating function value, from its table (TABLES true) or evaluating f.
+	 * @param t Neuron type
+	 * @param g Function reference in tables
+	 * @param f Exact function
+	 * @param x Voltage
 	 */
-	//Channel current based on the current neuron
-	double Ixs(double _v,double _p,double _q);
+	template<bool TABLES>
+	static double gate(int t,gates g,double (*f)(double),double x){return TABLES ? (*tables[t][g])(x) : f(x);}
 
 	/*!
-	 * Differential equation for somatic compartment voltage where slow activity properties are hosted 
-	 * @brief Differential equation for voltage in soma. 
-	 * @param _v Voltage value at soma compartment.
-	 * @param _va Voltage value at axon compartment.
-	 * @param _p value (usually _variables[p]).
-	 * @param _q value (usually _variables[q]).
-	 * @param iext injected current received.
-	 * @param isyn synaptic current received.
-	 * @return result for the equation for the corresponding neuron. 
-	 * @see Vavoulis et al. [1] 
-	 */
-	double dvs(double _v,double _va,double _p,double _q, double iext,double isyn);
+	 Differential equations function type, see rhs.
+	*/
+	typedef void (*rhs_fun)(VavoulisModel &neu,const double * vars,double * fvec,double iext,double i_syn,double * tau);
 
-	/////////////////////////////////////////////////////////////////
-	//////////// 			AXON 		///////////////////////
-	/////////////////////////////////////////////////////////////////
+	rhs_fun rhs_ptr[2]; ///< rhs specializations for this neuron type with exact gating functions and with tables, chosen once in the constructor and indexed by use_tables
 
 	/*!
-	 * h differential equation
-	 * @brief differential equation corresponding to h neurotransmitor in iNaT from the axial compartment. 
-	 * @param _va Voltage value at axon compartment
-	 * @param _h previous h value. (usually _variables[h])
-	 * @return result for the equation for the corresponding neuron. 
-	 * @see Vavoulis et al. [1] 
+	 * @brief Sets rhs_ptr to the specializations of type T.
 	 */
-	double dh(double _va,double _h);
+	template<int T>
+	void set_rhs(){rhs_ptr[0] = &rhs<T,false>; rhs_ptr[1] = &rhs<T,true>;}
 
 	/*!
-	 * n differential equation
-	 * @brief differential equation corresponding to n neurotransmitor in iK from the axonal compartment. 
-	 * @param _va Voltage value at axon compartment
-	 * @param _n previous n value. (usually _variables[n])
-	 * @return result for the equation for the corresponding neuron. 
-	 * @see Vavoulis et al. [1] 
-	 */
-	double dn(double _va,double _n);
-	
-	/*!
-	 * Fast channel INaT from the axonal compartment
-	 * @brief INaT channel represents an inactivating sodium current, part of fast axonal compartment.
-	 * @param _va Voltage value at axonal compartment
-	 * @param _h value (usually _variables[h])
-	 * @return channel value in mV. 
-	 * @see Vavoulis et al. [1] 
-	 */
-	double Ina (double _va,double _h);
-	/*!
-	 * Fast channel IK from the axonal compartment
-	 * @brief IK channel represents an rectifier potassium current, part of fast axonal compartment.
-	 * @param _va Voltage value at axonal compartment.
-	 * @param _n value (usually _variables[n])
-	 * @return channel value in mV. 
-	 * @see Vavoulis et al. [1] 
-	 */
-	double Ik (double _va,double _n);
-
-	/*!Differential equation for voltage in axon. 
-	 *  
-	 * @brief Differential equation for axonal compartment voltage where fast activity properties are hosted.
-	 *  Spiking frequency depends on this compartment. Conductance in electric coupling with soma influences the spiking. 
-	 * @param _v Voltage value at soma compartment.
-	 * @param _va Voltage value at axon compartment.
-	 * @param _h value (usually _variables[h]).
-	 * @param _n value (usually _variables[n]).
-	 * @return result for the equation for the corresponding neuron. 
+	 * Differential equations of neuron type T.
+	 * @brief Soma: slow channel Ix = g_x*p^3*[q]*(v-E_x) and p/q kinetics with the constants in NeuronTraits<T>, leak and electrical coupling with the axon.
+	 * Axon: fast INaT and IK channels (AxonGates), leak and electrical coupling with the soma.
+	 * Each type is compiled separately, so terms a type does not have (e.g. p and q in SO) are not computed and there are no branches on the type.
+	 * TABLES selects lookup tables or exact gating functions at compile time, so gates do not test use_tables.
+	 * @param neu Neuron, its dv_value and isyn are updated
+	 * @param vars array with previous instant variables values (n_variables long). 
+	 * @param fvec return array with computed differential values (n_variables long).
+	 * @param iext injected current received.
+	 * @param i_syn synaptic current received.
+	 * @param tau return array with the time constants of the gating variables, not computed if NULL.
 	 * @see Vavoulis et al. [1] 
 	 */
-	double dva(double _v,double _va,double _h,double _n);
-
+	template<int T,bool TABLES>
+	static void rhs(VavoulisModel &neu,const double * vars,double * fvec,double iext,double i_syn,double * tau);
 
 };
 
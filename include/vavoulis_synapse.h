@@ -42,7 +42,7 @@ class VavoulisSynapse{
 
 	double _variables[n_variables]; ///< Variables array. All elements in this array have a differential equation associated in the form of dvar(...)
 	double params[n_params];  ///< Parameter array
-	int pre_type; ///< Presynaptic neuron type.
+	int pre_type; ///< Presynaptic neuron index in the network (its type in the feeding CPG).
 
 	VavoulisModel *pos; ///< posynaptic neuron reference
 	VavoulisModel *pre;///< pre-synaptic neuron reference
@@ -59,6 +59,15 @@ public:
 	*/
 	VavoulisSynapse(VavoulisModel *n1, VavoulisModel* n2,double _conduc_syn,double _activation_syn,double _Esyn);
 
+	/*! VavoulisSynapse constructor
+	* @brief Creates a synapse not bound to neuron objects, for networks that pass the voltages to Isyn and update_variables (see CPGSimulator).
+	* @param pre Presynaptic neuron index
+	* @param _conduc_syn Maximal synaptic conductance parameter value
+	* @param _activation_syn Activation time constant parameter value
+	* @param _Esyn reversal potential parameter value
+	*/
+	VavoulisSynapse(int pre,double _conduc_syn,double _activation_syn,double _Esyn);
+
 	/*! VavoulisSynapse void constructor
 	* @brief Creates a new synapse model with all the corresponding params and variables initial values initialized to 0.
 	*/
@@ -66,7 +75,9 @@ public:
 	
 
 	static int getNVars(){return n_variables;} ///< returns the number of variables. 
-	int getPreType() {return pre_type;} ///< Presynaptic neuron type getter
+	static int getNExp(){return r_table ? 0 : 1;} ///< Calls to exp in one evaluation of the equations (r steady state)
+	static int getNGated(){return n_variables;} ///< Variables with a time constant (s and r)
+	int getPreType() {return pre_type;} ///< Presynaptic neuron index getter
 	
 	/*!
 	 * 
@@ -75,6 +86,13 @@ public:
 	 */
 	std::vector<double> getVariables();
 
+	/*!
+	 * 
+	 * @brief variables array getter without allocation.
+	 * @param vars destination array, at least n_variables long.
+	 */
+	void getVariables(double * vars);
+
 
 	/*! 
 	* @brief Sets params values of the synapse.
@@ -94,6 +112,13 @@ public:
 	 */
 	void set_variables(const std::vector<double> &v);
 
+	/*!
+	 * 
+	 * @brief Updates the n_variables in variables array with the data in v. 
+	 * @param v array containing new variables values, at least n_variables long.
+	 */
+	void set_variables(const double * v);
+
 	/*!
 	 * 
 	 * @brief Returns an array with all values obtained by the differential equations
@@ -105,6 +130,27 @@ public:
 	 */
 	void diffs_fun( double time, const std::vector<double> & vars, std::vector<double> &fvec, double vpre);
 
+	/*!
+	 * 
+	 * @brief Overload of diffs_fun working on raw arrays, used by the integrators to avoid allocations.
+	 * @param time Current time for the differential equation. 
+	 * @param vars array with previous instant variables values (n_variables long). 
+	 * @param fvec return array with computed differential values (n_variables long).
+	 * @param vpre Voltage value in the somatic compartment from the Presynaptic neuron.
+	 */
+	void diffs_fun( double time, const double * vars, double * fvec, double vpre);
+
+	/*!
+	 * 
+	 * @brief Overload of diffs_fun that also returns the time constant of s and r (the activation time constant), used by the Rush-Larsen integrator.
+	 * @param time Current time for the differential equation. 
+	 * @param vars array with previous instant variables values (n_variables long). 
+	 * @param fvec return array with computed differential values (n_variables long).
+	 * @param vpre Voltage value in the somatic compartment from the Presynaptic neuron.
+	 * @param tau return array with the time constants (n_variables long).
+	 */
+	void diffs_fun( double time, const double * vars, double * fvec, double vpre,double * tau);
+
 	/*!
 	 * 
 	 * @brief Returns an array with all values obtained by the differential equations
@@ -144,6 +190,13 @@ public:
 	 */
 	double Isyn(const vector<double> &variables,double v);
 	/*!
+	* @brief Overload of Isyn method using a raw variables array.
+	* @param variables array used to compute Isyn (n_variables long).
+	* @param v Soma voltage value from pos-synaptic neuron.
+	* @return resulting synaptic value in mV
+	*/
+	double Isyn(const double * variables,double v);
+	/*!
 	* @brief Overload of Isyn method: Calculates Isyn accessing pos->V()
 	* @return resulting synaptic value in mV
 	*/
@@ -164,6 +217,7 @@ public:
 	* Format: 
 	*  		Pos: Neuron print
 	*		Pre: Neuron print
+	* Synapses not bound to neurons print the presynaptic index and the parameters.
 	*/
 	void print();
 
@@ -174,7 +228,22 @@ public:
 	*/
 	void print_params();
 
+	/*!
+	 * 
+	 * @brief Builds the lookup table of r steady state and uses it instead of exp from now on.
+	 * @param interp Interpolation type
+	 * @param step Table step in mV
+	 */
+	static void build_tables(GatingTable::interpolations interp,double step);
+
+	/*!
+	 * 
+	 * @brief Maximum error of the lookup table, 0 if it is not in use.
+	 */
+	static double tables_error(){return r_table ? r_table->max_error() : 0;}
+
 private:
+	static GatingTable * r_table; ///< r steady state table, NULL to evaluate it
 
 	/*!
 	 * r differential equation
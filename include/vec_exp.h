@@ -0,0 +1,79 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+
+#ifndef VEC_EXP_H
+#define VEC_EXP_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+//Exponential functions used as template parameters of the gating functions (see neuron_traits.h).
+//LibmExp calls exp and gives the results of feeding_cpg. VecExp is branch free and made only of arithmetic,
+//so the compiler vectorizes the loops that call it (exp is a library call that clobbers errno and stops vectorization).
+
+
+/*! LibmExp
+ * exp of the C library.
+ */
+struct LibmExp
+{
+	static double exp(double x){return ::exp(x);}
+};
+
+
+/*! VecExp
+ * Polynomial exp: x = k*ln2 + r with |r| <= ln2/2, e^x = 2^k * e^r. e^r is its Taylor polynomial of degree 13 (error below 1e-17),
+ * so the result is within a few ulp of exp. x is clamped to [-708,709]: results stay normal, e^-708 is used for smaller arguments.
+ */
+struct VecExp
+{
+	static double exp(double x)
+	{
+		const double shift = 6755399441055744.0; ///<1.5*2^52, adding it rounds to an integer kept in the low mantissa bits
+		const double ln2_hi = 6.93147180369123816490e-01; ///<High part of ln2, k*ln2_hi is exact
+		const double ln2_lo = 1.90821492927058770002e-10; ///<ln2-ln2_hi
+
+		x = x < -708.0 ? -708.0 : x;
+		x = x > 709.0 ? 709.0 : x;
+
+		double kd = x*1.44269504088896338700 + shift;
+		uint64_t ki;
+		memcpy(&ki,&kd,sizeof(ki));
+		kd -= shift;
+
+		double r = x - kd*ln2_hi;
+		r = r - kd*ln2_lo;
+
+		double p = 1.0/6227020800;
+		p = p*r + 1.0/479001600;
+		p = p*r + 1.0/39916800;
+		p = p*r + 1.0/3628800;
+		p = p*r + 1.0/362880;
+		p = p*r + 1.0/40320;
+		p = p*r + 1.0/5040;
+		p = p*r + 1.0/720;
+		p = p*r + 1.0/120;
+		p = p*r + 1.0/24;
+		p = p*r + 1.0/6;
+		p = p*r + 0.5;
+		p = p*r + 1.0;
+		p = p*r + 1.0;
+
+		//2^k is added to the exponent field. The low bits of ki are k in two's complement, the shift drops the rest.
+		uint64_t bits;
+		memcpy(&bits,&p,sizeof(bits));
+		bits += ki << 52;
+		memcpy(&p,&bits,sizeof(p));
+		return p;
+	}
+};
+
+#endif
@@ -0,0 +1,199 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+
+#include "async_writer.h"
+
+#include <stdarg.h>
+#include <string.h>
+#include <chrono>
+
+#define IO_IDLE_US 200 ///<I/O thread sleep when there is nothing to write
+#define STALL_US 50 ///<Producer sleep when there are no free buffers
+
+AsyncWriter::AsyncWriter(int n_buffers,size_t buffer_size)
+	:buffer_size(buffer_size),storage(n_buffers*buffer_size),buffers(n_buffers),
+	full(n_buffers),written(n_buffers),pending(0),running(true),stalls(0)
+{
+	for(int i=0; i<n_buffers; i++)
+	{
+		buffers[i].f = NULL;
+		buffers[i].used = 0;
+		buffers[i].data = &storage[i*buffer_size];
+		spare.push_back(i);
+	}
+
+	io = std::thread(&AsyncWriter::run,this);
+}
+
+AsyncWriter::~AsyncWriter()
+{
+	flush();
+	running = false;
+	io.join();
+}
+
+
+void AsyncWriter::write(FILE * f,const void * data,size_t n)
+{
+	Stream & s = stream(f);
+	const char * bytes = (const char *)data;
+
+	while(n > 0)
+	{
+		Buffer & b = buffers[s.current];
+		size_t chunk = buffer_size-b.used;
+		if(chunk > n)
+			chunk = n;
+		memcpy(b.data+b.used,bytes,chunk);
+		b.used += chunk;
+		bytes += chunk;
+		n -= chunk;
+
+		if(b.used == buffer_size)
+			submit(s);
+	}
+}
+
+
+int AsyncWriter::printf(FILE * f,const char * fmt,...)
+{
+	Stream & s = stream(f);
+	Buffer * b = &buffers[s.current];
+	size_t room = buffer_size-b->used;
+
+	va_list args;
+	va_start(args,fmt);
+	int n = vsnprintf(b->data+b->used,room,fmt,args);
+	va_end(args);
+
+	if(n < 0)
+		return n;
+
+	//Did not fit (vsnprintf needs room for the final '\0'), format again in an empty buffer.
+	if((size_t)n >= room)
+	{
+		submit(s);
+		b = &buffers[s.current];
+		if((size_t)n >= buffer_size)
+		{
+			//Record longer than a buffer, very unlikely.
+			std::vector<char> aux(n+1);
+			va_start(args,fmt);
+			vsnprintf(&aux[0],n+1,fmt,args);
+			va_end(args);
+			write(f,&aux[0],n);
+			return n;
+		}
+		va_start(args,fmt);
+		vsnprintf(b->data,buffer_size,fmt,args);
+		va_end(args);
+	}
+
+	b->used += n;
+	return n;
+}
+
+
+void AsyncWriter::flush()
+{
+	for(unsigned int i=0; i<streams.size(); i++)
+	{
+		Buffer & b = buffers[streams[i].current];
+		if(b.used > 0)
+		{
+			pending++;
+			while(!full.push(streams[i].current))
+				std::this_thread::sleep_for(std::chrono::microseconds(STALL_US));
+		}
+		else
+			spare.push_back(streams[i].current);
+	}
+
+	while(pending > 0)
+		std::this_thread::sleep_for(std::chrono::microseconds(STALL_US));
+
+	int idx;
+	while(written.pop(idx))
+		spare.push_back(idx);
+
+	for(unsigned int i=0; i<streams.size(); i++)
+		fflush(streams[i].f);
+
+	streams.clear();
+}
+
+
+AsyncWriter::Stream & AsyncWriter::stream(FILE * f)
+{
+	for(unsigned int i=0; i<streams.size(); i++)
+		if(streams[i].f == f)
+			return streams[i];
+
+	Stream s;
+	s.f = f;
+	s.current = acquire();
+	buffers[s.current].f = f;
+	streams.push_back(s);
+	return streams.back();
+}
+
+
+int AsyncWriter::acquire()
+{
+	int idx;
+	if(!spare.empty())
+	{
+		idx = spare.back();
+		spare.pop_back();
+	}
+	else
+	{
+		while(!written.pop(idx))
+		{
+			stalls++;
+			std::this_thread::sleep_for(std::chrono::microseconds(STALL_US));
+		}
+	}
+
+	buffers[idx].used = 0;
+	return idx;
+}
+
+
+void AsyncWriter::submit(Stream & s)
+{
+	pending++;
+	//Never fails: there are as many queue slots as buffers.
+	full.push(s.current);
+
+	s.current = acquire();
+	buffers[s.current].f = s.f;
+}
+
+
+void AsyncWriter::run()
+{
+	int idx;
+	while(true)
+	{
+		if(full.pop(idx))
+		{
+			Buffer & b = buffers[idx];
+			fwrite(b.data,1,b.used,b.f);
+			b.used = 0;
+			written.push(idx);
+			pending--;
+		}
+		else if(!running)
+			break;
+		else
+			std::this_thread::sleep_for(std::chrono::microseconds(IO_IDLE_US));
+	}
+}
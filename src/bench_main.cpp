@@ -0,0 +1,511 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+/*
+	Microbenchmarks of the hot paths of the simulator: equations of neurons and synapses, CPGSimulator::diffs, one step of each
+	integrator, output records, spike detection, complete simulation steps and the vectorized steps of CPGEnsemble.
+	For each one the time per call, calls (or steps) per second and heap allocations per call are reported, as a table and as JSON (one benchmark per line).
+	A previous JSON file can be given to fail when a benchmark is slower than the tolerance.
+
+	./cpg_bench [-o file.json] [-min_time secs] [-filter text] [-compare baseline.json] [-tolerance fraction]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "cpg_simulator.h"
+#include "cpg_ensemble.h"
+
+using namespace std;
+
+
+////////////////////////////////////////////////////////
+//   Allocation counter
+////////////////////////////////////////////////////////
+
+static atomic<long> n_allocs(0); ///<Heap allocations since the start of the program
+
+void * operator new(size_t size)
+{
+	n_allocs.fetch_add(1,memory_order_relaxed);
+	void * p = malloc(size ? size : 1);
+	if(!p)
+		throw bad_alloc();
+	return p;
+}
+
+void * operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void * p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void * p) noexcept
+{
+	free(p);
+}
+
+
+////////////////////////////////////////////////////////
+//   Measurement
+////////////////////////////////////////////////////////
+
+/*!
+ Result of a benchmark.
+*/
+struct BenchResult
+{
+	string name; ///<Benchmark name
+	string unit; ///<"call" or "step"
+	long iterations; ///<Calls in the measured batch
+	double ns_per_op; ///<Nanoseconds per call
+	double ops_per_sec; ///<Calls (steps) per second
+	double allocs_per_op; ///<Heap allocations per call
+};
+
+static volatile double bench_sink; ///<Results of the benchmarked calls are added here so they are not optimized away
+
+/*!
+* @brief Runs f in batches that double in size until a batch takes min_time, after a short warm up.
+* @param name Benchmark name
+* @param unit "call" or "step"
+* @param min_time Minimum duration of the measured batch in seconds
+* @param f Function to measure
+*/
+template<class F> BenchResult measure(const string &name,const char * unit,double min_time,F f)
+{
+	for(int i=0; i<10; i++)
+		f();
+
+	BenchResult r;
+	r.name = name;
+	r.unit = unit;
+	for(long n=1; ; n*=2)
+	{
+		long allocs = n_allocs.load();
+		chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+		for(long i=0; i<n; i++)
+			f();
+		double secs = chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+		allocs = n_allocs.load()-allocs;
+
+		if(secs >= min_time || n >= (1L<<40))
+		{
+			r.iterations = n;
+			r.ns_per_op = secs*1e9/n;
+			r.ops_per_sec = n/secs;
+			r.allocs_per_op = (double)allocs/n;
+			return r;
+		}
+	}
+}
+
+
+/*!
+ Spike sink that only counts events, so detect_spikes and the ring are measured without file output.
+*/
+class CountSpikeSink : public SpikeSink
+{
+public:
+	long events; ///<Events received
+	CountSpikeSink():events(0){}
+	void write_header(const char * columns,const char * params){}
+	void write(const SpikeEvent * events,int n){this->events += n;}
+};
+
+
+/*! CPGBench class
+ * Benchmarks with access to the private integration functions of CPGSimulator.
+ */
+class CPGBench
+{
+	double min_time; ///<Minimum duration of each measurement in seconds
+	string filter; ///<Only benchmarks whose name contains it are run
+	vector<BenchResult> results; ///<Results in run order
+
+	/*!
+	* @brief Measures f if name passes the filter and prints the result.
+	*/
+	template<class F> void run(const string &name,const char * unit,F f)
+	{
+		if(!filter.empty() && name.find(filter) == string::npos)
+			return;
+		report(measure(name,unit,min_time,f));
+	}
+
+	/*!
+	* @brief Prints a result and adds it to the results.
+	*/
+	void report(const BenchResult &r)
+	{
+		const char * unit = r.unit.c_str();
+		printf("%-40s %12.1f ns/%-4s %14.0f %s/s %8.2f allocs/%s\n",r.name.c_str(),r.ns_per_op,unit,r.ops_per_sec,unit,r.allocs_per_op,unit);
+		fflush(stdout);
+		results.push_back(r);
+	}
+
+	/*!
+	* @brief Scales a result of batches of per operations to a single operation.
+	*/
+	static void per_op(BenchResult &r,int per)
+	{
+		r.iterations *= per;
+		r.ns_per_op /= per;
+		r.ops_per_sec *= per;
+		r.allocs_per_op /= per;
+	}
+
+public:
+	CPGBench(double min_time,const string &filter):min_time(min_time),filter(filter){}
+
+	const vector<BenchResult> & getResults(){return results;}
+
+	/*!
+	* @brief Equations of each neuron type and of a synapse, from a resting state.
+	*/
+	void models()
+	{
+		double fvec[MAX_VARS];
+
+		for(int t=0; t<VavoulisModel::n_types; t++)
+		{
+			VavoulisModel neu((VavoulisModel::types)t);
+			vector<double> vars = neu.getVariables();
+			run(string("VavoulisModel::diffs_fun/")+neu.getName(),"call",[&]{
+				neu.diffs_fun(0.0,vars.data(),fvec,2.0,0.1);
+				bench_sink = bench_sink + fvec[0];
+			});
+		}
+
+		VavoulisSynapse syn(0,8.0,FAST,INHIB);
+		vector<double> vars = syn.getVariables();
+		run("VavoulisSynapse::diffs_fun","call",[&]{
+			syn.diffs_fun(0.0,vars.data(),fvec,-40.0);
+			bench_sink = bench_sink + fvec[0];
+		});
+	}
+
+	/*!
+	* @brief Simulator functions on the network net.
+	* @param tag Suffix of the benchmark names
+	* @param cpg Simulator, advanced by the step benchmarks
+	*/
+	void simulator(const string &tag,CPGSimulator &cpg)
+	{
+		double dt = 0.01;
+		double t = 0;
+
+		//Let the network leave the initial state, so spike detection and the equations see normal activity.
+		for(int i=0; i<2000; i++, t+=dt)
+			cpg.update_euler(t,dt);
+
+		cpg.get_state(cpg.v_variables.data());
+		run("CPGSimulator::diffs/"+tag,"call",[&]{
+			cpg.diffs(t,cpg.v_variables.data(),cpg.v_retorno.data());
+			bench_sink = bench_sink + cpg.v_retorno[0];
+		});
+
+		run("CPGSimulator::update_euler/"+tag,"step",[&]{
+			cpg.update_euler(t,dt);
+			t += dt;
+		});
+
+		run("CPGSimulator::intey/"+tag,"step",[&]{
+			cpg.intey(t,dt);
+			t += dt;
+		});
+
+		//Spike detection on a fixed state: after the first call no spike is found, which is the path taken in almost every step.
+		CountSpikeSink sink;
+		vector<double> prevs(cpg.n_neurons,1);
+		run("CPGSimulator::detect_spikes/"+tag,"step",[&]{
+			cpg.detect_spikes(sink,prevs,t,dt);
+		});
+		cpg.spike_ring.drain(sink);
+		bench_sink = bench_sink + sink.events;
+	}
+
+	/*!
+	* @brief Output records of the feeding CPG in each format, written to /dev/null.
+	*/
+	void output(CPGSimulator &cpg)
+	{
+		FILE * f = fopen("/dev/null","w");
+		if(!f)
+			return;
+
+		const char * names[CPGSimulator::n_formats] = {"ascii","bin","bin64","none","delta"};
+		for(int fmt=0; fmt<CPGSimulator::n_formats; fmt++)
+		{
+			if(fmt == CPGSimulator::NONE)
+				continue;
+			cpg.set_format((CPGSimulator::formats)fmt);
+			double t = 0;
+			run(string("CPGSimulator::write/")+names[fmt],"call",[&]{
+				cpg.write(f,t,6.0);
+				t += 0.04;
+			});
+		}
+		cpg.set_format(CPGSimulator::ASCII);
+		fclose(f);
+	}
+
+	/*!
+	* @brief Complete simulation steps (integration, spike detection and ascii output to /dev/null).
+	*/
+	void simulation(CPGSimulator &cpg)
+	{
+		FILE * f = fopen("/dev/null","w");
+		FILE * f_spks = fopen("/dev/null","w");
+		if(!f || !f_spks)
+			return;
+
+		const int iters = 1000;
+		const char * names[] = {"euler","runge"};
+		CPGSimulator::integrators integ[] = {CPGSimulator::EULER,CPGSimulator::RUNGE};
+
+		for(int k=0; k<2; k++)
+		{
+			string name = string("CPGSimulator::simulate/")+names[k];
+			if(!filter.empty() && name.find(filter) == string::npos)
+				continue;
+
+			//Calls of simulate are measured per step. Its progress messages are muted.
+			streambuf * out = cout.rdbuf(NULL);
+			BenchResult r = measure(name,"step",min_time,[&]{
+				cpg.simulate(f,f_spks,iters,0.01,integ[k],-1,-1);
+			});
+			cout.rdbuf(out);
+			cout.clear();
+			per_op(r,iters);
+			report(r);
+		}
+		fclose(f);
+		fclose(f_spks);
+	}
+
+	/*!
+	* @brief Euler and Runge-Kutta steps of an ensemble of n feeding CPGs, measured per instance step.
+	* The vector width of the kernels is the one of the build, utils/lane_bench.sh compares builds with different widths.
+	* @param n Number of instances
+	*/
+	void ensemble(int n)
+	{
+		RampGenerator rg(-1,-1,-1,-1000);
+		CPGEnsemble ens(3,rg);
+		for(int k=0; k<n; k++)
+			ens.add_instance(vector<double>({8.5+0.01*(k%50),6,2,0}),vector<double>());
+		ens.init_state();
+
+		double dt = 0.01;
+		double t = 0;
+		for(int i=0; i<2000; i++, t+=dt)
+			ens.update_euler(t,dt);
+
+		const char * names[] = {"update_euler","update_runge"};
+		for(int k=0; k<2; k++)
+		{
+			string name = string("CPGEnsemble::")+names[k]+"/n"+to_string(n);
+			if(!filter.empty() && name.find(filter) == string::npos)
+				continue;
+
+			BenchResult r = measure(name,"inst",min_time,[&]{
+				if(k == 0)
+					ens.update_euler(t,dt);
+				else
+					ens.update_runge(t,dt);
+				t += dt;
+			});
+			per_op(r,n);
+			report(r);
+		}
+		bench_sink = bench_sink + ens.v_variables[0];
+	}
+};
+
+
+/*!
+* @brief Network of n_circuits copies of the complete feeding CPG, each neuron with 2 extra inhibitory synapses from random circuits
+* (as utils/make_network.py), with a fixed seed.
+*/
+static NetworkTopology coupled_network(int n_circuits)
+{
+	NetworkTopology feeding = NetworkTopology::feeding(3);
+	NetworkTopology net;
+	double c[N_NEU] = {8.5,6,2,0};
+	unsigned int seed = 1;
+
+	for(int i=0; i<n_circuits; i++)
+		for(int n=0; n<N_NEU; n++)
+			net.add_neuron(feeding.names[n]+"_"+to_string(i),feeding.types[n],c[n]);
+
+	for(int i=0; i<n_circuits; i++)
+		for(int n=0; n<N_NEU; n++)
+		{
+			for(int k=feeding.row_ptr[n]; k<feeding.row_ptr[n+1]; k++)
+				net.add_synapse(i*N_NEU+feeding.pre[k],i*N_NEU+n,feeding.g[k],feeding.tau[k],feeding.E[k]);
+			for(int k=0; k<2 && n_circuits>1; k++)
+			{
+				seed = seed*1103515245+12345;
+				int j = (seed>>8)%(n_circuits-1);
+				j += j >= i;
+				net.add_synapse(j*N_NEU+(seed>>4)%N_NEU,i*N_NEU+n,0.05,FAST,INHIB);
+			}
+		}
+	net.build();
+	return net;
+}
+
+
+/*!
+* @brief Writes the results as JSON, one benchmark per line.
+*/
+static int write_json(const char * file,const vector<BenchResult> &results)
+{
+	FILE * f = fopen(file,"w");
+	if(!f)
+	{
+		cerr << "Error: can not open " << file << endl;
+		return 0;
+	}
+
+	fprintf(f,"{\n\"compiler\": \"%s\",\n\"benchmarks\": [\n",__VERSION__);
+	for(unsigned int i=0; i<results.size(); i++)
+	{
+		const BenchResult &r = results[i];
+		fprintf(f,"{\"name\": \"%s\", \"unit\": \"%s\", \"iterations\": %ld, \"ns_per_op\": %.3f, \"ops_per_sec\": %.1f, \"allocs_per_op\": %.4f}%s\n",
+			r.name.c_str(),r.unit.c_str(),r.iterations,r.ns_per_op,r.ops_per_sec,r.allocs_per_op,i+1<results.size()?",":"");
+	}
+	fprintf(f,"]\n}\n");
+	fclose(f);
+	return 1;
+}
+
+
+/*!
+* @brief Reads ns_per_op and allocs_per_op of each benchmark from a file written by write_json.
+*/
+static int read_json(const char * file,map<string,BenchResult> &results)
+{
+	ifstream in(file);
+	if(!in)
+	{
+		cerr << "Error: can not open " << file << endl;
+		return 0;
+	}
+
+	string line;
+	while(getline(in,line))
+	{
+		size_t name = line.find("\"name\": \"");
+		size_t ns = line.find("\"ns_per_op\": ");
+		size_t allocs = line.find("\"allocs_per_op\": ");
+		if(name == string::npos || ns == string::npos || allocs == string::npos)
+			continue;
+		name += 9;
+		BenchResult r;
+		r.name = line.substr(name,line.find('"',name)-name);
+		r.ns_per_op = atof(line.c_str()+ns+13);
+		r.allocs_per_op = atof(line.c_str()+allocs+17);
+		results[r.name] = r;
+	}
+	return 1;
+}
+
+
+int main(int argc, char * argv[])
+{
+	const char * json_file = NULL;
+	const char * baseline_file = NULL;
+	double min_time = 0.2;
+	double tolerance = 0.10;
+	string filter;
+
+	for(int i=1; i<argc; i++)
+	{
+		if(i+1 < argc && strcmp(argv[i],"-o")==0)
+			json_file = argv[++i];
+		else if(i+1 < argc && strcmp(argv[i],"-min_time")==0)
+			min_time = atof(argv[++i]);
+		else if(i+1 < argc && strcmp(argv[i],"-filter")==0)
+			filter = argv[++i];
+		else if(i+1 < argc && strcmp(argv[i],"-compare")==0)
+			baseline_file = argv[++i];
+		else if(i+1 < argc && strcmp(argv[i],"-tolerance")==0)
+			tolerance = atof(argv[++i]);
+		else
+		{
+			cerr << "Format: ./cpg_bench [-o file.json] [-min_time secs] [-filter text] [-compare baseline.json] [-tolerance fraction]" << endl;
+			return -1;
+		}
+	}
+
+	map<string,BenchResult> baseline;
+	if(baseline_file && !read_json(baseline_file,baseline))
+		return -1;
+
+	RampGenerator rg(-1,-1,-1,-1000); //No ramp, as feeding_cpg without ramp parameters
+	CPGBench bench(min_time,filter);
+
+	bench.models();
+
+	CPGSimulator feeding(3,vector<double>({8.5,6,2,0}),rg);
+	bench.simulator("feeding",feeding);
+
+	NetworkTopology net = coupled_network(250);
+	CPGSimulator large(net,net.currents,rg);
+	bench.simulator("net1000",large);
+
+	CPGSimulator out(3,vector<double>({8.5,6,2,0}),rg);
+	bench.output(out);
+
+	CPGSimulator sim(3,vector<double>({8.5,6,2,0}),rg);
+	bench.simulation(sim);
+
+	bench.ensemble(1);
+	bench.ensemble(256);
+
+	if(json_file && !write_json(json_file,bench.getResults()))
+		return -1;
+
+	//Regressions: slower than the baseline by more than the tolerance, or allocating where it did not.
+	int regressions = 0;
+	if(baseline_file)
+	{
+		printf("\nComparison with %s (tolerance %.0f%%)\n",baseline_file,tolerance*100);
+		const vector<BenchResult> &results = bench.getResults();
+		for(unsigned int i=0; i<results.size(); i++)
+		{
+			map<string,BenchResult>::iterator it = baseline.find(results[i].name);
+			if(it == baseline.end())
+				continue;
+			double ratio = results[i].ns_per_op/it->second.ns_per_op;
+			bool slower = ratio > 1+tolerance;
+			bool allocs = results[i].allocs_per_op > it->second.allocs_per_op+1e-3;
+			printf("%-40s %6.2fx%s%s\n",results[i].name.c_str(),ratio,slower?"  SLOWER":"",allocs?"  MORE ALLOCATIONS":"");
+			regressions += slower || allocs;
+		}
+		printf("%d regressions\n",regressions);
+	}
+
+	return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,212 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+
+#include "burst_analysis.h"
+#include "vavoulis_neuron.h"
+
+#include <math.h>
+#include <iostream>
+#include <sstream>
+using namespace std;
+
+
+BurstAnalysis::BurstAnalysis(const std::vector<int> &seq,const std::vector<std::string> &names,double max_isi,FILE * f,SpikeSink * next)
+{
+	this->seq = seq;
+	this->max_isi = max_isi;
+	this->f = f;
+	this->next = next;
+	cycle = 0;
+
+	seq_index.assign(names.size(),-1);
+	for(unsigned int j=0; j<seq.size(); j++)
+	{
+		seq_index[seq[j]] = j;
+		this->names.push_back(names[seq[j]]);
+	}
+
+	Burst none = {0,0,0};
+	closed.resize(seq.size());
+	open.assign(seq.size(),none);
+	last_start.assign(seq.size(),NAN);
+}
+
+
+void BurstAnalysis::write_header(const char * columns,const char * params)
+{
+	int m = seq.size();
+
+	fprintf(f,"cycle t");
+	for(int j=0; j<m; j++)
+		fprintf(f," %s_period %s_duration %s_spikes",names[j].c_str(),names[j].c_str(),names[j].c_str());
+	for(int j=0; j<m && m>1; j++)
+	{
+		const char * b = names[(j+1)%m].c_str();
+		fprintf(f," %s_%s_interval %s_%s_delay",names[j].c_str(),b,names[j].c_str(),b);
+	}
+	fprintf(f,"\n");
+}
+
+
+void BurstAnalysis::write(const SpikeEvent * events,int n)
+{
+	bool changed = false;
+
+	for(int k=0; k<n; k++)
+	{
+		int j = seq_index[events[k].neuron];
+		if(j < 0)
+			continue;
+
+		Burst &b = open[j];
+		double t = events[k].t;
+		if(b.spikes > 0 && t-b.end > max_isi)
+		{
+			closed[j].push_back(b);
+			b.spikes = 0;
+		}
+		if(b.spikes == 0)
+			b.start = t;
+		b.end = t;
+		b.spikes++;
+		changed = true;
+	}
+
+	if(changed)
+		write_cycles();
+
+	if(next)
+		next->write(events,n);
+}
+
+
+void BurstAnalysis::finish()
+{
+	for(unsigned int j=0; j<seq.size(); j++)
+	{
+		if(open[j].spikes > 0)
+			closed[j].push_back(open[j]);
+		open[j].spikes = 0;
+	}
+	write_cycles();
+	fflush(f);
+}
+
+
+void BurstAnalysis::write_cycles()
+{
+	int m = seq.size();
+	std::vector<const Burst *> found(m);
+
+	while(!closed[0].empty())
+	{
+		//The cycle ends where the next reference burst starts, known from its first spike.
+		const Burst &ref = closed[0].front();
+		double next_start;
+		if(closed[0].size() > 1)
+			next_start = closed[0][1].start;
+		else if(open[0].spikes > 0)
+			next_start = open[0].start;
+		else
+			return;
+
+		//A burst in progress that started in the cycle may still be extended.
+		for(int j=1; j<m; j++)
+			if(open[j].spikes > 0 && open[j].start < next_start)
+				return;
+
+		//Burst of each neuron: the first one after the burst of the previous neuron found.
+		found[0] = &ref;
+		double after = ref.start;
+		for(int j=1; j<m; j++)
+		{
+			found[j] = NULL;
+			for(unsigned int k=0; k<closed[j].size() && closed[j][k].start < next_start; k++)
+				if(closed[j][k].start >= after)
+				{
+					found[j] = &closed[j][k];
+					after = found[j]->start;
+					break;
+				}
+		}
+
+		fprintf(f,"%ld %f",cycle,ref.start);
+		for(int j=0; j<m; j++)
+		{
+			if(found[j])
+				fprintf(f," %f %f %d",found[j]->start-last_start[j],found[j]->end-found[j]->start,found[j]->spikes);
+			else
+				fprintf(f," nan nan 0");
+			last_start[j] = found[j] ? found[j]->start : NAN;
+		}
+		for(int j=0; j<m && m>1; j++)
+		{
+			const Burst * a = found[j];
+			double b_start = j+1<m ? (found[j+1] ? found[j+1]->start : NAN) : next_start;
+			if(a)
+				fprintf(f," %f %f",b_start-a->start,b_start-a->end);
+			else
+				fprintf(f," nan nan");
+		}
+		fprintf(f,"\n");
+
+		//Bursts of this cycle are not needed any more.
+		closed[0].pop_front();
+		for(int j=1; j<m; j++)
+			while(!closed[j].empty() && closed[j].front().start < next_start)
+				closed[j].pop_front();
+		cycle++;
+	}
+
+	//Without a reference burst bursts can not be assigned to any cycle, those before the next one are dropped.
+	double first = open[0].spikes > 0 ? open[0].start : INFINITY;
+	for(int j=1; j<m; j++)
+		while(!closed[j].empty() && closed[j].front().start < first)
+			closed[j].pop_front();
+}
+
+
+std::vector<int> BurstAnalysis::feeding_sequence(const std::vector<int> &types)
+{
+	int order[] = {VavoulisModel::N1M,VavoulisModel::N2v,VavoulisModel::N3t};
+	std::vector<int> seq;
+
+	for(int t=0; t<3; t++)
+		for(unsigned int i=0; i<types.size(); i++)
+			if(types[i] == order[t])
+			{
+				seq.push_back(i);
+				break;
+			}
+	return seq;
+}
+
+
+std::vector<int> BurstAnalysis::parse_sequence(const char * list,const std::vector<std::string> &names)
+{
+	std::vector<int> seq;
+	stringstream in(list);
+	string name;
+
+	while(getline(in,name,','))
+	{
+		unsigned int i;
+		for(i=0; i<names.size(); i++)
+			if(names[i] == name)
+				break;
+		if(i == names.size())
+		{
+			cerr << "Error: unknown neuron " << name << " in " << list << endl;
+			return std::vector<int>();
+		}
+		seq.push_back(i);
+	}
+	return seq;
+}
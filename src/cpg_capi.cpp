@@ -0,0 +1,212 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+
+#include "cpg_capi.h"
+#include "cpg_simulator.h"
+
+#include <iostream>
+using namespace std;
+
+
+/*!
+ Simulator handle of the C interface.
+*/
+struct CPGHandle
+{
+	CPGSimulator sim; ///<Simulator
+	CPGSimulator::integrators integration; ///<Integration method of the next calls
+	double dt; ///<Time step of the next calls
+};
+
+
+/*! BufferSpikeSink class
+ * Stores the spike events in the caller buffers of cpg_run, counting the ones that do not fit.
+ */
+class BufferSpikeSink : public SpikeSink
+{
+	double * t; ///<Times buffer
+	double * v; ///<Peak voltages buffer
+	int * neuron; ///<Neuron ids buffer
+	long max; ///<Events that fit in the buffers
+
+public:
+	long count; ///<Events received
+
+	BufferSpikeSink(double * t,double * v,int * neuron,long max):t(t),v(v),neuron(neuron),max(max),count(0){}
+
+	void write_header(const char * columns,const char * params){}
+
+	void write(const SpikeEvent * events,int n)
+	{
+		for(int k=0; k<n; k++,count++)
+		{
+			if(count >= max)
+				continue;
+			if(t) t[count] = events[k].t;
+			if(v) v[count] = events[k].v;
+			if(neuron) neuron[count] = events[k].neuron;
+		}
+	}
+};
+
+
+/*!
+* @brief New handle with the default integrator and time step. The simulator is initialized by the caller.
+*/
+static CPGHandle * new_handle()
+{
+	CPGHandle * h = new CPGHandle;
+	h->integration = CPGSimulator::EULER;
+	h->dt = 0.01;
+	return h;
+}
+
+
+CPGHandle * cpg_create(int connection,const double * currents,double min_c,double max_c,double stim_inc,double stim_dur)
+{
+	if(!currents)
+		return NULL;
+
+	CPGHandle * h = new_handle();
+	if(h->sim.init(connection,std::vector<double>(currents,currents+4),RampGenerator(min_c,max_c,stim_inc,stim_dur)) == 0)
+	{
+		cerr << "Error: unknown connection " << connection << endl;
+		delete h;
+		return NULL;
+	}
+	return h;
+}
+
+
+CPGHandle * cpg_create_network(const char * file)
+{
+	NetworkTopology net;
+	if(!file || net.load(file) == 0)
+		return NULL;
+
+	CPGHandle * h = new_handle();
+	if(h->sim.init(net,net.currents,RampGenerator()) == 0)
+	{
+		cerr << "Error: can not initialize the network of " << file << endl;
+		delete h;
+		return NULL;
+	}
+	return h;
+}
+
+
+void cpg_destroy(CPGHandle * h)
+{
+	delete h;
+}
+
+
+int cpg_n_neurons(CPGHandle * h)
+{
+	return h->sim.getNNeurons();
+}
+
+
+const char * cpg_neuron_name(CPGHandle * h,int i)
+{
+	if(i < 0 || i >= h->sim.getNNeurons())
+		return NULL;
+	return h->sim.getNames()[i].c_str();
+}
+
+
+int cpg_configure(CPGHandle * h,int integrator,double dt)
+{
+	if(integrator < 0 || integrator >= CPGSimulator::n_integrators || integrator == CPG_ADAPTIVE || integrator == CPG_ADAPTIVE_ROSENBROCK || dt <= 0)
+	{
+		cerr << "Error: integrator " << integrator << " with dt " << dt << " not supported, only fixed step integrators" << endl;
+		return -1;
+	}
+	h->integration = (CPGSimulator::integrators)integrator;
+	h->dt = dt;
+	return 0;
+}
+
+
+int cpg_set_threads(CPGHandle * h,int n_threads)
+{
+	if(n_threads < 0)
+		return -1;
+	try
+	{
+		h->sim.set_threads(n_threads);
+	}
+	catch(std::exception &e)
+	{
+		cerr << "Error: " << e.what() << endl;
+		return -1;
+	}
+	return 0;
+}
+
+
+int cpg_set_currents(CPGHandle * h,const double * currents,int n)
+{
+	if(!currents || n != h->sim.getNNeurons())
+	{
+		cerr << "Error: " << h->sim.getNNeurons() << " currents expected" << endl;
+		return -1;
+	}
+	h->sim.setCurrents(std::vector<double>(currents,currents+n));
+	return 0;
+}
+
+
+int cpg_load_protocol(CPGHandle * h,const char * file)
+{
+	return h->sim.load_protocol(file) ? 0 : -1;
+}
+
+
+double cpg_use_gating_tables(int cubic,double step)
+{
+	return CPGSimulator::use_gating_tables(cubic ? GatingTable::CUBIC : GatingTable::LINEAR,step,NULL);
+}
+
+
+double cpg_time(CPGHandle * h)
+{
+	return h->sim.getTime();
+}
+
+
+long cpg_step(CPGHandle * h,long steps)
+{
+	return cpg_run(h,steps,1,NULL,NULL,NULL,0,NULL,NULL,NULL,NULL,0,NULL);
+}
+
+
+long cpg_run(CPGHandle * h,long steps,int decimation,double * t,double * v,double * c,long max_samples,long * n_samples,
+	double * spike_t,double * spike_v,int * spike_neuron,long max_spikes,long * n_spikes)
+{
+	BufferSpikeSink sink(spike_t,spike_v,spike_neuron,max_spikes);
+	long samples = 0, done;
+
+	try
+	{
+		done = h->sim.advance(steps,h->dt,h->integration,decimation,t,v,c,max_samples,&samples,sink);
+	}
+	catch(std::exception &e)
+	{
+		cerr << "Error: " << e.what() << endl;
+		done = -1;
+	}
+
+	if(n_samples)
+		*n_samples = samples;
+	if(n_spikes)
+		*n_spikes = sink.count;
+	return done;
+}
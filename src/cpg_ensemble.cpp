@@ -0,0 +1,456 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+
+#include "cpg_ensemble.h"
+#include "neuron_traits.h"
+#include "network_topology.h"
+
+#include <iostream>
+using namespace std;
+
+//Variables order inside each neuron and synapse, same as in VavoulisModel and VavoulisSynapse.
+enum neu_vars {V,VA,P,Q,H,N};
+enum syn_vars {S,R};
+
+
+CPGEnsemble::CPGEnsemble(int connection, RampGenerator rg)
+{
+	this->connection = connection;
+	this->rg = rg;
+	n_inst = 0;
+	n_blocks = N_NEU*N_VARS;
+
+	//Same circuit and synapse order as CPGSimulator::init, the current is accumulated in that order.
+	NetworkTopology net = NetworkTopology::feeding(connection);
+	for(int i=0; i<N_NEU; i++)
+		for(int k=net.row_ptr[i]; k<net.row_ptr[i+1]; k++)
+		{
+			SynapseDesc syn = {i,net.pre[k],net.g[k],net.tau[k],net.E[k]};
+			syns.push_back(syn);
+		}
+
+	n_blocks += syns.size()*VavoulisSynapse::getNVars();
+}
+
+
+int CPGEnsemble::add_instance(const std::vector<double> &c_values, const std::vector<double> &conductances)
+{
+	if(c_values.size() != N_NEU)
+		return -1;
+	if(!conductances.empty() && conductances.size() != syns.size())
+		return -1;
+
+	//Values are stored instance-major, conductances until init_state transposes them.
+	this->c_values.insert(this->c_values.end(),c_values.begin(),c_values.end());
+
+	for(int m=0; m<(int)syns.size(); m++)
+		conduc.push_back(conductances.empty() ? syns[m].conduc_syn : conductances[m]);
+
+	return n_inst++;
+}
+
+
+void CPGEnsemble::init_state()
+{
+	int n_syns = syns.size();
+
+	//Transpose conductances to structure-of-arrays.
+	std::vector<double> g_soa(n_syns*n_inst);
+	for(int k=0; k<n_inst; k++)
+		for(int m=0; m<n_syns; m++)
+			g_soa[m*n_inst+k] = conduc[k*n_syns+m];
+	conduc.swap(g_soa);
+
+	//Neuron i of the circuit has type i (see NetworkTopology::feeding).
+	std::vector<int> types(N_NEU);
+	for(int i=0; i<N_NEU; i++)
+		types[i] = i;
+	protocols.assign(n_inst,StimProtocol());
+	for(int k=0; k<n_inst; k++)
+	{
+		protocols[k].init(types);
+		protocols[k].set_currents(std::vector<double>(c_values.begin()+k*N_NEU,c_values.begin()+(k+1)*N_NEU),rg);
+	}
+
+	v_variables.assign(n_blocks*n_inst,0);
+	v_apoyo.assign(n_blocks*n_inst,0);
+	v_retorno.assign(n_blocks*n_inst,0);
+	v_k.assign(6*n_blocks*n_inst,0);
+	dv.assign(N_NEU*n_inst,0);
+	isyn.assign(N_NEU*n_inst,0);
+	i_ext.assign(N_NEU*n_inst,0);
+	set_iext(0);
+
+	//Initial values taken from a VavoulisModel of each type.
+	double *vars = v_variables.data();
+	for(int i=0; i<N_NEU; i++)
+	{
+		VavoulisModel neu((VavoulisModel::types)i);
+		for(int x=0; x<N_VARS; x++)
+		{
+			double *b = var(vars,i,x);
+			for(int k=0; k<n_inst; k++)
+				b[k] = neu.getVar(x);
+		}
+	}
+	for(int m=0; m<n_syns; m++)
+	{
+		double *s = syn_var(vars,m,S);
+		double *r = syn_var(vars,m,R);
+		for(int k=0; k<n_inst; k++)
+		{
+			s[k] = s_init;
+			r[k] = r_init;
+		}
+	}
+}
+
+
+void CPGEnsemble::print()
+{
+	VavoulisModel names(VavoulisModel::SO);
+	cout << "Ensemble instances: " << n_inst << endl;
+	cout << "Synapses (conductance order): " << endl;
+	for(int m=0; m<(int)syns.size(); m++)
+		cout << "\t" << m << " " << names.names[syns[m].pre] << "->" << names.names[syns[m].pos] << " g=" << syns[m].conduc_syn << endl;
+}
+
+
+/////////////////////////////////////////////////////////////////
+//////////// 		VECTOR KERNELS 		///////////////////////
+/////////////////////////////////////////////////////////////////
+// Same equations as VavoulisModel and VavoulisSynapse, evaluated for n instances.
+// The neuron type is fixed in each kernel so the loops are branch free.
+// Arrays never overlap, __restrict__ lets the compiler vectorize loops with many arrays without runtime alias checks.
+// exp is VecExp, so the loops with gating functions are vectorized too. Build with -DENSEMBLE_LIBM_EXP for results bit-identical to feeding_cpg.
+
+#ifdef ENSEMBLE_LIBM_EXP
+typedef LibmExp KernelExp;
+#else
+typedef VecExp KernelExp;
+#endif
+
+template<int T>
+static void axon_kernel(int n,const double * __restrict__ v,const double * __restrict__ va,const double * __restrict__ h,const double * __restrict__ nn,
+						double * __restrict__ fva,double * __restrict__ fh,double * __restrict__ fn)
+{
+	for(int k=0; k<n; k++)
+	{
+		double m = AxonGates::m_inf<KernelExp>(va[k]);
+		double ina = 350 * m*m*m * h[k] * (va[k]-55);
+		double ik = 90 * nn[k]*nn[k]*nn[k]*nn[k] * (va[k] + 90);
+		double ila = (va[k] + 67);
+		double ieca = NeuronTraits<T>::g_eca * (va[k] - v[k]);
+		fva[k] = (-ila - ina - ik - ieca)/tau_a;
+
+		fh[k] = (AxonGates::h_inf<KernelExp>(va[k]) - h[k])/AxonGates::tau_h<KernelExp>(va[k]);
+		fn[k] = (AxonGates::n_inf<KernelExp>(va[k]) - nn[k])/AxonGates::tau_n<KernelExp>(va[k]);
+	}
+}
+
+//Same equations as VavoulisModel::rhs, one loop per neuron type.
+template<int T>
+static void soma_kernel(int n,const double * __restrict__ v,const double * __restrict__ va,const double * __restrict__ p,const double * __restrict__ q,
+						const double * __restrict__ iext,const double * __restrict__ isyn,double * __restrict__ fv,double * __restrict__ fp,double * __restrict__ fq,double * __restrict__ dv)
+{
+	typedef NeuronTraits<T> Tr;
+	for(int k=0; k<n; k++)
+	{
+		double ils = v[k] + 67;
+		double iecs = Tr::g_ecs *(v[k]-va[k]);
+		if(Tr::g_x != 0)
+		{
+			double ix = Tr::g_x * p[k]*p[k]*p[k];
+			if(Tr::has_q)
+				ix = ix*q[k];
+			ix = ix*(v[k]-Tr::E_x);
+			fv[k] = (iext[k] - ils - ix - iecs - isyn[k])/tau_s;
+		}
+		else
+			fv[k] = (iext[k] - ils - iecs - isyn[k])/tau_s;
+		dv[k] = fv[k];
+
+		fp[k] = Tr::has_p ? (Tr::template p_inf<KernelExp>(v[k]) - p[k])/Tr::template tau_p<KernelExp>(va[k]) : 0.0;
+		fq[k] = Tr::has_q ? (Tr::template q_inf<KernelExp>(v[k]) - q[k])/Tr::template tau_q<KernelExp>(va[k]) : 0.0;
+	}
+}
+
+/*!
+* @brief Soma and axon equations of neuron i (its type) for all instances. 
+*/
+static void neuron_kernels(int i,int n,const double * v,const double * va,const double * p,const double * q,const double * h,const double * nn,
+						const double * iext,const double * isyn,double * fv,double * fva,double * fp,double * fq,double * fh,double * fn,double * dv)
+{
+	switch(i)
+	{
+		case VavoulisModel::N1M:
+			soma_kernel<VavoulisModel::N1M>(n,v,va,p,q,iext,isyn,fv,fp,fq,dv);
+			axon_kernel<VavoulisModel::N1M>(n,v,va,h,nn,fva,fh,fn);
+			break;
+		case VavoulisModel::N2v:
+			soma_kernel<VavoulisModel::N2v>(n,v,va,p,q,iext,isyn,fv,fp,fq,dv);
+			axon_kernel<VavoulisModel::N2v>(n,v,va,h,nn,fva,fh,fn);
+			break;
+		case VavoulisModel::N3t:
+			soma_kernel<VavoulisModel::N3t>(n,v,va,p,q,iext,isyn,fv,fp,fq,dv);
+			axon_kernel<VavoulisModel::N3t>(n,v,va,h,nn,fva,fh,fn);
+			break;
+		default: //SO
+			soma_kernel<VavoulisModel::SO>(n,v,va,p,q,iext,isyn,fv,fp,fq,dv);
+			axon_kernel<VavoulisModel::SO>(n,v,va,h,nn,fva,fh,fn);
+			break;
+	}
+}
+
+static void synapse_kernel(int n,double activation_syn,double Esyn,const double * __restrict__ g,const double * __restrict__ s,const double * __restrict__ r,
+						const double * __restrict__ vpre,const double * __restrict__ vpos,double * __restrict__ fs,double * __restrict__ fr,double * __restrict__ isyn)
+{
+	for(int k=0; k<n; k++)
+	{
+		isyn[k] += g[k] * s[k] * (vpos[k] - Esyn);
+		fs[k] = (r[k]-s[k]) / activation_syn;
+		double r_inf = 1/(1 + KernelExp::exp((-40 - vpre[k])/2.5));
+		fr[k] = (r_inf - r[k])/activation_syn;
+	}
+}
+
+
+void CPGEnsemble::set_iext(double _time)
+{
+	for(int k=0; k<n_inst; k++)
+	{
+		protocols[k].seek(_time);
+		for(int i=0; i<N_NEU; i++)
+			i_ext[i*n_inst+k] = protocols[k].value(i);
+	}
+}
+
+
+void CPGEnsemble::diffs(double _time, const double * vars, double * fvec)
+{
+	int n = n_inst;
+
+	for(int i=0; i<N_NEU*n; i++)
+		isyn[i] = 0;
+
+	for(int m=0; m<(int)syns.size(); m++)
+	{
+		synapse_kernel(n,syns[m].activation_syn,syns[m].Esyn,&conduc[m*n],
+					syn_var(vars,m,S),syn_var(vars,m,R),var(vars,syns[m].pre,V),var(vars,syns[m].pos,V),
+					syn_var(fvec,m,S),syn_var(fvec,m,R),&isyn[syns[m].pos*n]);
+	}
+
+	for(int i=0; i<N_NEU; i++)
+		neuron_kernels(i,n,var(vars,i,V),var(vars,i,VA),var(vars,i,P),var(vars,i,Q),var(vars,i,H),var(vars,i,N),&i_ext[i*n],&isyn[i*n],
+					var(fvec,i,V),var(fvec,i,VA),var(fvec,i,P),var(fvec,i,Q),var(fvec,i,H),var(fvec,i,N),&dv[i*n]);
+}
+
+
+void CPGEnsemble::update_euler(double _time, double dt)
+{
+	//Neurons are updated in place one after the other as in CPGSimulator::update_euler,
+	//so a neuron sees the already updated values of the previous ones.
+	int n = n_inst;
+	double *vars = v_variables.data();
+	double *retorno = v_retorno.data();
+
+	for(int i=0; i<N_NEU; i++)
+	{
+		double *is = &isyn[i*n];
+		for(int k=0; k<n; k++)
+			is[k] = 0;
+
+		for(int m=0; m<(int)syns.size(); m++)
+		{
+			if(syns[m].pos != i)
+				continue;
+
+			double *s = syn_var(vars,m,S);
+			double *r = syn_var(vars,m,R);
+			double *fs = syn_var(retorno,m,S);
+			double *fr = syn_var(retorno,m,R);
+
+			synapse_kernel(n,syns[m].activation_syn,syns[m].Esyn,&conduc[m*n],
+						s,r,var(vars,syns[m].pre,V),var(vars,i,V),fs,fr,is);
+			for(int k=0; k<n; k++)
+			{
+				s[k] += fs[k]*dt;
+				r[k] += fr[k]*dt;
+			}
+		}
+
+		neuron_kernels(i,n,var(vars,i,V),var(vars,i,VA),var(vars,i,P),var(vars,i,Q),var(vars,i,H),var(vars,i,N),&i_ext[i*n],is,
+					var(retorno,i,V),var(retorno,i,VA),var(retorno,i,P),var(retorno,i,Q),var(retorno,i,H),var(retorno,i,N),&dv[i*n]);
+
+		double *b = var(vars,i,0);
+		double *fb = var(retorno,i,0);
+		for(int j=0; j<N_VARS*n; j++)
+			b[j] += fb[j]*dt;
+	}
+}
+
+
+void CPGEnsemble::update_runge(double _time, double inc_integracion)
+{
+	int total = n_blocks*n_inst;
+	double * vars = v_variables.data();
+	double * apoyo = v_apoyo.data();
+	double * retorno = v_retorno.data();
+	double * k0 = v_k.data();
+	double * k1 = k0+total;
+	double * k2 = k1+total;
+	double * k3 = k2+total;
+	double * k4 = k3+total;
+	double * k5 = k4+total;
+	int j;
+
+	diffs(_time, vars,retorno);
+	for(j=0;j<total;++j)
+	{
+		k0[j]=inc_integracion*retorno[j];
+		apoyo[j]=vars[j]+k0[j]*.2;
+	}
+
+	diffs(_time+inc_integracion/5, apoyo,retorno);
+	for(j=0;j<total;++j)
+	{
+		k1[j]=inc_integracion*retorno[j];
+		apoyo[j]=vars[j]+k0[j]*.075+k1[j]*0.225;
+	}
+
+	diffs(_time+inc_integracion*0.3, apoyo,retorno);
+	for(j=0;j<total;++j)
+	{
+		k2[j]=inc_integracion*retorno[j];
+		apoyo[j]=vars[j]+k0[j]*.3-k1[j]*0.9+k2[j]*1.2;
+	}
+
+	diffs(_time+inc_integracion*0.6, apoyo,retorno);
+	for(j=0;j<total;++j)
+	{
+		k3[j]=inc_integracion*retorno[j];
+		apoyo[j]=vars[j]+k0[j]*0.075+k1[j]*0.675-k2[j]*0.6+k3[j]*0.75;
+	}
+
+	diffs(_time+inc_integracion*0.9, apoyo,retorno);
+	for(j=0;j<total;++j)
+	{
+		k4[j]=inc_integracion*retorno[j];
+		apoyo[j]=vars[j]+k0[j]*0.660493827160493
+		       +k1[j]*2.5
+		       -k2[j]*5.185185185185185
+		       +k3[j]*3.888888888888889
+		       -k4[j]*0.864197530864197;
+	}
+
+	diffs(_time+inc_integracion, apoyo,retorno);
+	for(j=0;j<total;++j)
+	{
+		k5[j]=inc_integracion*retorno[j];
+		vars[j]=vars[j]+k0[j]*0.098765432098765+
+		       k2[j]*0.396825396825396+
+		       k3[j]*0.231481481481481+
+		       k4[j]*0.308641975308641-
+		       k5[j]*0.035714285714285;
+	}
+}
+
+
+void CPGEnsemble::write(FILE *f,int inst,double t,double c)
+{
+	const double *vars = v_variables.data();
+	double so = var(vars,VavoulisModel::SO,V)[inst];
+	double n1m = var(vars,VavoulisModel::N1M,V)[inst];
+	double n2v = var(vars,VavoulisModel::N2v,V)[inst];
+	double n3t = var(vars,VavoulisModel::N3t,V)[inst];
+
+	if(connection == 0 || connection==3)
+		fprintf(f, "%f %f %f %f %f %f\n", t,so,n1m,n2v,n3t,c);
+	else if(connection == 1)
+		fprintf(f, "%f %f %f\n", t,n1m,n2v);
+	else if(connection == 2)
+		fprintf(f, "%f %f %f %f\n", t,n1m,n2v,n3t);
+	else if(connection == 4)
+		fprintf(f, "%f %f %f %f %f %f %f %f %f\n", t,
+			so,isyn[VavoulisModel::SO*n_inst+inst],n1m,isyn[VavoulisModel::N1M*n_inst+inst],
+			n2v,isyn[VavoulisModel::N2v*n_inst+inst],n3t,isyn[VavoulisModel::N3t*n_inst+inst]);
+	else
+		fprintf(f, "%f %f %f %f %f\n", t,so,n1m,n2v,n3t);
+}
+
+
+void CPGEnsemble::detect_spikes(SpikeSink &sink,int inst,std::vector<double> &prevs,double t,double h)
+{
+	double dev;
+
+	for(int i=0; i<N_NEU; i++)
+	{
+		int idx = i*n_inst+inst;
+		double vs = var(v_variables.data(),i,V)[inst];
+		dev = dv[idx];
+		if(prevs[idx] >0 && dev <0 && (prevs[idx]-dev)>MIN_SPIKE_CHANGE && vs > SPIKE_TH)
+		{
+			SpikeEvent ev = spike_event(i,t,h,prevs[idx],dev,vs);
+			sink.write(&ev,1);
+		}
+		prevs[idx] = dev;
+	}
+}
+
+
+void CPGEnsemble::simulate(std::vector<FILE *> &f,std::vector<FILE *> &f_spks,double iters,double dt,CPGSimulator::integrators integration,double satiated_ini,double satiated_end)
+{
+	init_state();
+
+	int serie = 0;
+	double t = 0.0;
+	std::vector<double> c(n_inst,0);
+	std::vector<double> prevs(N_NEU*n_inst,1);
+	std::vector<TextSpikeSink> sinks;
+	for(int k=0; k<n_inst; k++)
+		sinks.push_back(TextSpikeSink(f_spks[k],N_NEU));
+
+	// Satiated window as in CPGSimulator::simulate with fixed steps: N1M supressed and N3t stimulated (see StimProtocol),
+	// set half a step earlier than its time to be safe from the rounding of the accumulated time.
+	if(satiated_ini >= 0 || satiated_end >= 0)
+		for(int k=0; k<n_inst; k++)
+			protocols[k].satiated(satiated_ini >= 0 ? satiated_ini*dt-dt/2 : INFINITY,satiated_end >= 0 ? satiated_end*dt-dt/2 : INFINITY);
+
+	for (int i=0; i < iters; i++)
+	{
+		serie = (serie + 1) % 4;
+		if (serie == 3)
+			for(int k=0; k<n_inst; k++)
+				write(f[k],k,t,c[k]);
+
+		//Currents of the step, from the stimulation protocols.
+		set_iext(t);
+
+		if(integration == CPGSimulator::RUNGE)
+			update_runge(t,dt);
+		else
+			update_euler(t,dt);
+
+		//Current value reported as in CPGSimulator::current_value
+		for(int k=0; k<n_inst; k++)
+		{
+			int i = protocols[k].ramp_neuron();
+			c[k] = protocols[k].value(i >= 0 ? i : VavoulisModel::N1M);
+		}
+
+		for(int k=0; k<n_inst; k++)
+			detect_spikes(sinks[k],k,prevs,integration==CPGSimulator::EULER ? t : t+dt,dt);
+
+		t += dt;
+
+		if(i==(int)iters/2)
+			cout << "Half iterations" << endl;
+	}
+}
@@ -12,94 +12,459 @@
 
 
 #include <iostream>
+#include <string.h>
+#include <string>
+#include <sstream>
+#include <float.h>
+#include <unistd.h>
 using namespace std; 
 
+/*!
+* @brief In place LU factorization with partial pivoting of the n x n row major matrix a.
+* @return false if the matrix is singular.
+*/
+static bool lu_factor(double * a, int * piv, int n)
+{
+	for(int k=0; k<n; k++)
+	{
+		int p=k;
+		for(int i=k+1; i<n; i++)
+			if(fabs(a[i*n+k]) > fabs(a[p*n+k]))
+				p=i;
+		piv[k]=p;
+		if(a[p*n+k] == 0)
+			return false;
+		if(p != k)
+			for(int j=0; j<n; j++)
+				swap(a[k*n+j],a[p*n+j]);
+
+		double inv = 1.0/a[k*n+k];
+		for(int i=k+1; i<n; i++)
+		{
+			double l = a[i*n+k]*inv;
+			a[i*n+k] = l;
+			if(l != 0)
+				for(int j=k+1; j<n; j++)
+					a[i*n+j] -= l*a[k*n+j];
+		}
+	}
+	return true;
+}
+
+/*!
+* @brief Solves a x = b in place in b from the factors of lu_factor.
+*/
+static void lu_solve(const double * a, const int * piv, int n, double * b)
+{
+	for(int k=0; k<n; k++)
+	{
+		if(piv[k] != k)
+			swap(b[k],b[piv[k]]);
+		for(int i=k+1; i<n; i++)
+			b[i] -= a[i*n+k]*b[k];
+	}
+	for(int i=n-1; i>=0; i--)
+	{
+		for(int j=i+1; j<n; j++)
+			b[i] -= a[i*n+j]*b[j];
+		b[i] /= a[i*n+i];
+	}
+}
+
 CPGSimulator::CPGSimulator()
 {
 	n_neurons=0;
 	connection=-1;
+	topology_hash=0;
+	n_state=0;
+	format=ASCII;
+	delta_res=DELTA_RESOLUTION;
+	out_interval=0;
+	writer=NULL;
+	spike_sink=NULL;
+	publisher=NULL;
+	stats=NULL;
+	resumed=false;
+	ckpt_interval=0;
+	set_tolerances(1e-6,1e-6,1.0);
 }
 
 CPGSimulator::CPGSimulator(int connection, std::vector<double> c_values, RampGenerator rg)
 {
+	format=ASCII;
+	delta_res=DELTA_RESOLUTION;
+	out_interval=0;
+	writer=NULL;
+	spike_sink=NULL;
+	publisher=NULL;
+	stats=NULL;
+	resumed=false;
+	ckpt_interval=0;
+	set_tolerances(1e-6,1e-6,1.0);
 	init(connection,c_values,rg);
 }
 
+CPGSimulator::CPGSimulator(const NetworkTopology &net, std::vector<double> c_values, RampGenerator rg)
+{
+	format=ASCII;
+	delta_res=DELTA_RESOLUTION;
+	out_interval=0;
+	writer=NULL;
+	spike_sink=NULL;
+	publisher=NULL;
+	stats=NULL;
+	resumed=false;
+	ckpt_interval=0;
+	set_tolerances(1e-6,1e-6,1.0);
+	init(net,c_values,rg);
+}
+
+CPGSimulator CPGSimulator::branch() const
+{
+	CPGSimulator child(*this);
+	child.writer = NULL;
+	child.spike_sink = NULL;
+	child.publisher = NULL;
+	child.stats = NULL;
+	child.ckpt_file.clear();
+	child.ckpt_interval = 0;
+	child.pool.reset();
+	child.resumed = !run.prevs.empty(); //Nothing to continue if it was never simulated
+	return child;
+}
+
+void CPGSimulator::set_tolerances(double rtol,double atol,double dt_max)
+{
+	this->rtol = rtol;
+	this->atol = atol;
+	this->dt_max = dt_max;
+}
+
 int CPGSimulator::init(int connection, std::vector<double> c_values, RampGenerator rg)
 {
+	if(connection < 0)return 0;
+
+	init(NetworkTopology::feeding(connection),c_values,rg);
+	this->connection=connection;
 
+	return 1;
+}
+
+int CPGSimulator::init(const NetworkTopology &net, std::vector<double> c_values, RampGenerator rg)
+{
 
 	///////////////////////////////////////
 	//Initializing Neurons and connections
 	///////////////////////////////////////
 
-	if(connection < 0)return 0;
+	if(net.getNNeurons() == 0 || (int)c_values.size() != net.getNNeurons())return 0;
 
-	this->connection=connection;
+	this->connection=-1;
+	topology_hash = net.hash();
 
-	VavoulisModel so(VavoulisModel::SO);
-	VavoulisModel n1m(VavoulisModel::N1M);
-	VavoulisModel n2v(VavoulisModel::N2v);
-	VavoulisModel n3t(VavoulisModel::N3t);
+	n_neurons=net.getNNeurons();
+	names=net.names;
+	neurons.clear();
+	neurons.reserve(n_neurons);
+	for(int i=0; i<n_neurons; i++)
+		neurons.push_back(VavoulisModel(net.types[i]));
 
-	neurons.assign({so,n1m,n2v,n3t});
-	n_neurons=neurons.size();
-	syns.resize(n_neurons);
+	i_report = net.find_type(VavoulisModel::N1M);
+	if(i_report < 0)
+		i_report = 0;
 
 	//Assigning each neuron a current value reference. 
 
 	this->c_values = c_values;
 
-	VavoulisSynapse n1m_so,n2v_so,so_n2v,n1m_n3t,n3t_n1m,n3t_n2v,n1m_n2v,n2v_n1m;
+	syn_ptr = net.row_ptr;
+	syn_pre = net.pre;
+	synapses.clear();
+	synapses.reserve(net.getNSynapses());
+	for(int k=0; k<net.getNSynapses(); k++)
+		synapses.push_back(VavoulisSynapse(net.pre[k],net.g[k],net.tau[k],net.E[k]));
 
 
-	//FAST 50 INHIB -90
-	//SLOW 200 EXCIT 0
-	if(connection >= 3) //All neurons connected
-	{
-		n1m_so.setSynapse(&neurons[VavoulisModel::N1M],&neurons[VavoulisModel::SO],4.0,SLOW,EXCIT) ;
-		syns[VavoulisModel::N1M].push_back(n1m_so);
+	///////////////////////////////////////
+	//Ramp initialization
+	///////////////////////////////////////
+
+
+	this->rg = rg;
+	protocol.init(std::vector<int>(net.types.begin(),net.types.end()));
+	protocol.set_currents(c_values,rg);
+
+	init_state();
 
-		n2v_so.setSynapse(&neurons[VavoulisModel::N2v],&neurons[VavoulisModel::SO],1.0,SLOW,EXCIT);
-		syns[VavoulisModel::N2v].push_back(n2v_so);
+	return 1;
 
-		so_n2v.setSynapse(&neurons[VavoulisModel::SO],&neurons[VavoulisModel::N2v],8.0,FAST,INHIB);
-		syns[VavoulisModel::SO].push_back(so_n2v);
+}
 
+void CPGSimulator::init_state()
+{
+	int n_vars=VavoulisModel::getNVars();
+	int n_vars_syns=VavoulisSynapse::getNVars();
+
+	offsets.resize(n_neurons);
+	n_state=0;
+	for(int i=0; i<n_neurons; i++)
+	{
+		offsets[i]=n_state;
+		n_state += n_vars+(syn_ptr[i+1]-syn_ptr[i])*n_vars_syns;
 	}
 
-	if(connection >= 2) //N1M, N2v and N3t connected
+	v_variables.assign(n_state,0);
+	v_apoyo.assign(n_state,0);
+	v_retorno.assign(n_state,0);
+	v_k.assign(6*n_state,0);
+	v_error.assign(n_state,0);
+	v_tau.assign(2*n_state,0);
+	v_jac.clear(); //n_state^2, only allocated if a Rosenbrock integrator is used
+	v_pivots.clear();
+	v_dense.assign(3*n_state,0);
+
+	out_vals.assign(std::max(2*N_NEU,n_neurons+1)+1,0);
+	out_line.assign(out_vals.size()*32,0);
+
+	if(pool)
+		partition();
+}
+
+
+void CPGSimulator::set_threads(int n_threads)
+{
+	if(n_threads <= 0)
 	{
-		n1m_n3t.setSynapse(&neurons[VavoulisModel::N1M],&neurons[VavoulisModel::N3t],8.0,FAST,INHIB) ;
-		syns[VavoulisModel::N1M].push_back(n1m_n3t);
+		pool.reset();
+		return;
+	}
+	pool = std::make_shared<StepPool>(n_threads);
+	if(n_neurons > 0)
+		partition();
+}
 
-		n3t_n1m.setSynapse(&neurons[VavoulisModel::N3t],&neurons[VavoulisModel::N1M],0.5,FAST,INHIB) ;
-		syns[VavoulisModel::N3t].push_back(n3t_n1m);
 
-		n3t_n2v.setSynapse(&neurons[VavoulisModel::N3t],&neurons[VavoulisModel::N2v],2.0,FAST,INHIB) ;
-		syns[VavoulisModel::N3t].push_back(n3t_n2v);
+void CPGSimulator::partition()
+{
+	//Integration buffers touched per state variable in a Runge-Kutta stage: state, intermediate state, return and the 6 stages.
+	const int bytes_var = 9*sizeof(double);
+
+	block_ptr.assign(1,0);
+	int start = 0;
+	for(int i=0; i<n_neurons; i++)
+	{
+		int end = i+1<n_neurons ? offsets[i+1] : n_state;
+		if(i > block_ptr.back() && (end-start)*bytes_var > BLOCK_BYTES)
+		{
+			block_ptr.push_back(i);
+			start = offsets[i];
+		}
 	}
-	if(connection >= 1) //N1M and N2v connected
+	block_ptr.push_back(n_neurons);
+
+	//Contiguous blocks with about the same number of variables for each thread
+	int n_threads = pool->size();
+	int n_blocks = block_ptr.size()-1;
+	thread_block.assign(n_threads+1,n_blocks);
+	thread_block[0] = 0;
+	int b = 0;
+	for(int t=1; t<n_threads; t++)
 	{
-		n1m_n2v.setSynapse(&neurons[VavoulisModel::N1M],&neurons[VavoulisModel::N2v],50.0,FAST,INHIB) ;
-		syns[VavoulisModel::N1M].push_back(n1m_n2v);
+		long target = (long)n_state*t/n_threads;
+		while(b < n_blocks && offsets[block_ptr[b]] < target)
+			b++;
+		thread_block[t] = b;
+	}
+
+	v_pre.assign(2*n_neurons,0);
+}
+
+void CPGSimulator::get_state(double * vars,int n0,int n1)
+{
+	int n_vars=VavoulisModel::getNVars();
+	int n_vars_syns=VavoulisSynapse::getNVars();
 
-		n2v_n1m.setSynapse(&neurons[VavoulisModel::N2v],&neurons[VavoulisModel::N1M],0.077,SLOW,EXCIT);
-		syns[VavoulisModel::N2v].push_back(n2v_n1m);
+	if(n1 < 0)
+		n1 = n_neurons;
+	for(int i=n0; i<n1; i++)
+	{
+		neurons[i].getVariables(vars+offsets[i]);
+		for(int k=syn_ptr[i]; k<syn_ptr[i+1]; k++)
+			synapses[k].getVariables(vars+offsets[i]+n_vars+(k-syn_ptr[i])*n_vars_syns);
 	}
+}
 
+void CPGSimulator::set_state(const double * vars,int n0,int n1)
+{
+	int n_vars=VavoulisModel::getNVars();
+	int n_vars_syns=VavoulisSynapse::getNVars();
 
-	///////////////////////////////////////
-	//Ramp initialization
-	///////////////////////////////////////
+	if(n1 < 0)
+		n1 = n_neurons;
+	for(int i=n0; i<n1; i++)
+	{
+		neurons[i].set_variables(vars+offsets[i]);
+		for(int k=syn_ptr[i]; k<syn_ptr[i+1]; k++)
+			synapses[k].set_variables(vars+offsets[i]+n_vars+(k-syn_ptr[i])*n_vars_syns);
+	}
+}
 
+void CPGSimulator::set_checkpoint(const char * file,double interval)
+{
+	ckpt_file = file ? file : "";
+	ckpt_interval = interval > 0 ? interval : 0;
+}
 
-	this->rg = rg;
 
+int CPGSimulator::save_checkpoint(FILE * f,SpikeSink &sink,integrators integration,double dt)
+{
+	//Everything before this point must be in the files to get their offsets.
+	flush_trace(f);
+	spike_ring.drain(sink);
+	if(writer)
+		writer->flush();
+	if(f)
+		fflush(f);
+	FILE * f_spks = sink.getFile();
+	if(f_spks)
+		fflush(f_spks);
+
+	std::vector<double> vars(n_state);
+	get_state(vars.data());
+
+	int32_t head[4] = {CKPT_VERSION,connection,n_state,integration};
+	int64_t iter = run.iter;
+	int32_t serie = run.serie, satiated = protocol.satiated_status(run.t);
+	double times[4] = {run.t,run.h,run.t_out,run.t_ckpt};
+	uint64_t net_hash = topology_hash;
+	int64_t file_offsets[2] = {f ? ftell(f) : 0, f_spks ? ftell(f_spks) : 0};
+
+	string tmp = ckpt_file+".tmp";
+	FILE * ck = fopen(tmp.c_str(),"wb");
+	if(!ck)
+	{
+		cerr << "Error: error openning checkpoint file " << tmp << endl;
+		return 0;
+	}
+
+	bool ok = fwrite(CKPT_MAGIC,1,8,ck)==8;
+	ok = ok && fwrite(head,sizeof(head),1,ck)==1;
+	ok = ok && fwrite(&net_hash,sizeof(net_hash),1,ck)==1;
+	ok = ok && fwrite(&dt,sizeof(dt),1,ck)==1;
+	ok = ok && fwrite(&iter,sizeof(iter),1,ck)==1;
+	ok = ok && fwrite(times,sizeof(times),1,ck)==1;
+	ok = ok && fwrite(&serie,sizeof(serie),1,ck)==1;
+	ok = ok && fwrite(&satiated,sizeof(satiated),1,ck)==1;
+	ok = ok && fwrite(&run.c,sizeof(run.c),1,ck)==1;
+	ok = ok && fwrite(file_offsets,sizeof(file_offsets),1,ck)==1;
+	ok = ok && fwrite(vars.data(),sizeof(double),n_state,ck)==(size_t)n_state;
+	for(int i=0; i<n_neurons && ok; i++)
+	{
+		double last[3] = {neurons[i].getdV(),neurons[i].getIsyn(),run.prevs[i]};
+		ok = fwrite(last,sizeof(last),1,ck)==1;
+	}
+	ok = ok && fflush(ck)==0 && fsync(fileno(ck))==0;
+	ok = (fclose(ck)==0) && ok;
+
+	if(!ok || rename(tmp.c_str(),ckpt_file.c_str())!=0)
+	{
+		cerr << "Error: error writing checkpoint file " << ckpt_file << endl;
+		return 0;
+	}
 	return 1;
+}
+
+
+int CPGSimulator::load_checkpoint(const char * file,integrators integration,double dt,long * offsets)
+{
+	FILE * ck = fopen(file,"rb");
+	if(!ck)
+	{
+		cerr << "Error: error openning checkpoint file " << file << endl;
+		return 0;
+	}
+
+	char magic[8];
+	int32_t head[4];
+	uint64_t net_hash;
+	double ck_dt;
+	int64_t iter;
+	int32_t serie, satiated;
+	double times[4];
+	double c;
+	int64_t offs[2];
+	std::vector<double> vars(n_state);
+	std::vector<double> last(3*n_neurons);
+
+	bool ok = fread(magic,1,8,ck)==8 && memcmp(magic,CKPT_MAGIC,8)==0;
+	ok = ok && fread(head,sizeof(head),1,ck)==1 && head[0]==CKPT_VERSION;
+	ok = ok && fread(&net_hash,sizeof(net_hash),1,ck)==1;
+	if(!ok)
+	{
+		cerr << "Error: " << file << " is not a checkpoint file (or has a different version)" << endl;
+		fclose(ck);
+		return 0;
+	}
+	if(head[1]!=connection || head[2]!=n_state)
+	{
+		cerr << "Error: checkpoint " << file << " was written with connection " << head[1] << ", this simulation uses " << connection << endl;
+		fclose(ck);
+		return 0;
+	}
+	//Networks from files have connection -1, their neurons and synapses must be the same too.
+	if(net_hash!=topology_hash)
+	{
+		cerr << "Error: checkpoint " << file << " was written for a different network" << endl;
+		fclose(ck);
+		return 0;
+	}
 
+	ok = fread(&ck_dt,sizeof(ck_dt),1,ck)==1;
+	ok = ok && fread(&iter,sizeof(iter),1,ck)==1;
+	ok = ok && fread(times,sizeof(times),1,ck)==1;
+	ok = ok && fread(&serie,sizeof(serie),1,ck)==1;
+	ok = ok && fread(&satiated,sizeof(satiated),1,ck)==1;
+	ok = ok && fread(&c,sizeof(c),1,ck)==1;
+	ok = ok && fread(offs,sizeof(offs),1,ck)==1;
+	ok = ok && fread(vars.data(),sizeof(double),n_state,ck)==(size_t)n_state;
+	ok = ok && fread(last.data(),sizeof(double),3*n_neurons,ck)==(size_t)3*n_neurons;
+	fclose(ck);
+	if(!ok)
+	{
+		cerr << "Error: checkpoint file " << file << " is truncated" << endl;
+		return 0;
+	}
+	if(head[3]!=integration || ck_dt!=dt) //Iterations and step size control would not match
+	{
+		cerr << "Error: checkpoint " << file << " was written with integrator " << head[3] << " and dt " << ck_dt << endl;
+		return 0;
+	}
+
+	set_state(vars.data());
+	run.prevs.resize(n_neurons);
+	for(int i=0; i<n_neurons; i++)
+	{
+		neurons[i].setLast(last[3*i],last[3*i+1]);
+		run.prevs[i] = last[3*i+2];
+	}
+	run.iter = iter;
+	run.t = times[0];
+	run.h = times[1];
+	run.t_out = times[2];
+	run.t_ckpt = times[3];
+	run.serie = serie;
+	run.c = c; //The satiated status is not needed, the protocol only depends on time.
+	resumed = true;
+
+	if(offsets)
+	{
+		offsets[0] = offs[0];
+		offsets[1] = offs[1];
+	}
+	return 1;
 }
 
+
 void CPGSimulator::print()
 {
 	for (int i=0;i<n_neurons;i++)
@@ -107,32 +472,241 @@ void CPGSimulator::print()
 		cout << "Neuron: ";
 		neurons[i].print();
 		cout << "\nSynapses: \n\t";
-		cout << "Number of synapses: "<< syns[i].size()<< endl;
-		for(int j=0;j<(int)syns[i].size();j++)
+		cout << "Number of synapses: "<< syn_ptr[i+1]-syn_ptr[i]<< endl;
+		for(int k=syn_ptr[i];k<syn_ptr[i+1];k++)
 		{
-			cout<< "\tSynapse number: "<< j<<endl;
-			syns[i][j].print();
+			cout<< "\tSynapse number: "<< k-syn_ptr[i]<<endl;
+			cout << "\tPos: "; neurons[i].print(); cout << endl;
+			cout << "\tPre: "; neurons[syn_pre[k]].print(); cout << endl;
+			cout << "\tParams: "; synapses[k].print_params(); cout << endl;
 			cout << endl;
 		}
 	}
 }
 
 
+double CPGSimulator::use_gating_tables(GatingTable::interpolations interp,double step,const char ** worst)
+{
+	VavoulisModel::build_tables(interp,step);
+	VavoulisSynapse::build_tables(interp,step);
+
+	double err = VavoulisModel::tables_error(worst);
+	double err_syn = VavoulisSynapse::tables_error();
+	if(err_syn > err)
+	{
+		err = err_syn;
+		if(worst)
+			*worst = "r_inf";
+	}
+	return err;
+}
+
+
+void CPGSimulator::write_header(FILE *f,const char * columns,double dt,const char * params)
+{
+	if(format == NONE)
+		return;
+	if(format == ASCII)
+	{
+		fprintf(f, "%s\n",columns);
+		return;
+	}
+
+	if(format == DELTA)
+	{
+		string body = string("columns ") + columns + "\n";
+		char line[BIN_ALIGN];
+		snprintf(line,BIN_ALIGN,"resolution %.10g\n",delta_res);
+		body += line;
+		snprintf(line,BIN_ALIGN,"block_records %d\n",DELTA_BLOCK);
+		body += line;
+		snprintf(line,BIN_ALIGN,"dt %.10g\n",dt);
+		body += line;
+		if(out_interval > 0)
+			snprintf(line,BIN_ALIGN,"interval %.10g\n",out_interval);
+		else
+			snprintf(line,BIN_ALIGN,"decimation %d\n",OUT_DECIMATION);
+		body += line;
+		if(params)
+			body += params;
+		write_bin_header(f,DELTA_MAGIC,DELTA_VERSION,body);
+		return;
+	}
+
+	//Column names with numpy types. Time is always float64.
+	const char * type = format==BIN64 ? "f8" : "f4";
+	stringstream cols(columns);
+	string name, cols_typed;
+	bool first=true;
+	while(cols >> name)
+	{
+		cols_typed += (first?"":" ") + name + ":" + (first?"f8":type);
+		first=false;
+	}
+
+	string body = "columns " + cols_typed + "\n";
+	char line[BIN_ALIGN];
+	snprintf(line,BIN_ALIGN,"dt %.10g\n",dt);
+	body += line;
+	if(out_interval > 0)
+		snprintf(line,BIN_ALIGN,"interval %.10g\n",out_interval);
+	else
+		snprintf(line,BIN_ALIGN,"decimation %d\n",OUT_DECIMATION);
+	body += line;
+	if(params)
+		body += params;
+
+	write_bin_header(f,BIN_MAGIC,BIN_VERSION,body);
+}
+
+
 void CPGSimulator::write(FILE *f,double t,double c)
 {
-	if(connection == 0 || connection==3)
-		fprintf(f, "%f %f %f %f %f %f\n",
-		 t,neurons[VavoulisModel::SO].V(),neurons[VavoulisModel::N1M].V(),neurons[VavoulisModel::N2v].V(),neurons[VavoulisModel::N3t].V(),c);
+	double * vals = out_vals.data();
+	int n=0;
+
+	//The live stream has the voltage of every neuron, with any format.
+	if(publisher && publisher->due())
+	{
+		double * rec = publisher->begin();
+		rec[0] = t;
+		for(int i=0; i<n_neurons; i++)
+			rec[i+1] = neurons[i].V();
+		rec[n_neurons+1] = c;
+		publisher->commit();
+	}
+
+	if(format == NONE)
+		return;
+
+	vals[n++]=t;
+	if(connection < 0)
+	{
+		for(int i=0; i<n_neurons; i++)
+			vals[n++]=neurons[i].V();
+		vals[n++]=c;
+	}
+	else if(connection == 0 || connection==3)
+	{
+		vals[n++]=neurons[VavoulisModel::SO].V(); vals[n++]=neurons[VavoulisModel::N1M].V(); vals[n++]=neurons[VavoulisModel::N2v].V(); vals[n++]=neurons[VavoulisModel::N3t].V();
+		vals[n++]=c;
+	}
 	else if(connection == 1)
-		fprintf(f, "%f %f %f\n", t,neurons[VavoulisModel::N1M].V(),neurons[VavoulisModel::N2v].V());
+	{
+		vals[n++]=neurons[VavoulisModel::N1M].V(); vals[n++]=neurons[VavoulisModel::N2v].V();
+	}
 	else if(connection == 2)
-		fprintf(f, "%f %f %f %f\n", t,neurons[VavoulisModel::N1M].V(),neurons[VavoulisModel::N2v].V(),neurons[VavoulisModel::N3t].V());
+	{
+		vals[n++]=neurons[VavoulisModel::N1M].V(); vals[n++]=neurons[VavoulisModel::N2v].V(); vals[n++]=neurons[VavoulisModel::N3t].V();
+	}
 	else if(connection == 4)
-		fprintf(f, "%f %f %f %f %f %f %f %f %f\n", 
-		t,neurons[VavoulisModel::SO].V(),neurons[VavoulisModel::SO].getIsyn(),neurons[VavoulisModel::N1M].V(),neurons[VavoulisModel::N1M].getIsyn(),neurons[VavoulisModel::N2v].V(),neurons[VavoulisModel::N2v].getIsyn(),neurons[VavoulisModel::N3t].V(),neurons[VavoulisModel::N3t].getIsyn());
+	{
+		for(int i=0; i<N_NEU; i++)
+		{
+			vals[n++]=neurons[i].V(); vals[n++]=neurons[i].getIsyn();
+		}
+	}
 	else
-		fprintf(f, "%f %f %f %f %f\n", t,neurons[VavoulisModel::SO].V(),neurons[VavoulisModel::N1M].V(),neurons[VavoulisModel::N2v].V(),neurons[VavoulisModel::N3t].V());
+	{
+		vals[n++]=neurons[VavoulisModel::SO].V(); vals[n++]=neurons[VavoulisModel::N1M].V(); vals[n++]=neurons[VavoulisModel::N2v].V(); vals[n++]=neurons[VavoulisModel::N3t].V();
+	}
+
+	if(format == ASCII)
+	{
+		char * line = out_line.data();
+		int size = out_line.size();
+		int len=0;
+		for(int i=0; i<n && len<size; i++)
+			len += snprintf(line+len,size-len, i==n-1 ? "%f\n" : "%f ",vals[i]);
+		if(len >= size) //Only with huge values, the record is truncated.
+			len = size-1;
+		out(f,line,len);
+	}
+	else if(format == BIN64)
+	{
+		out(f,vals,n*sizeof(double));
+	}
+	else if(format == DELTA)
+	{
+		if(delta.getNCols() != n)
+			delta.init(n,delta_res);
+		if(delta.add(vals))
+			flush_trace(f);
+	}
+	else
+	{
+		char * rec = out_line.data();
+		memcpy(rec,&vals[0],sizeof(double));
+		for(int i=1; i<n; i++)
+		{
+			float val_f = vals[i];
+			memcpy(rec+sizeof(double)+(i-1)*sizeof(float),&val_f,sizeof(float));
+		}
+		out(f,rec,sizeof(double)+(n-1)*sizeof(float));
+	}
+
+}
+
+
+void CPGSimulator::write_dense(FILE *f,double t,double h,integrators integration,double c)
+{
+	double * y0 = v_dense.data();
+	double * y1 = y0+n_state;
+	double * y = y1+n_state;
+	const double * k = v_k.data();
+	bool stages = integration == RUNGE || integration == ADAPTIVE;
+
+	if(out_interval <= 0)
+		return;
+
+	get_state(y1);
+	while(run.t_out < t+h)
+	{
+		double th = (run.t_out-t)/h;
+		if(stages)
+		{
+			//Continuous extension of the solution propagated by rk_stage: y0+sum(b_s(th)*k_s), b_s(1) are its weights and the interpolant is
+			//third order for any th (the second stage is not needed).
+			double th2 = th*th, th3 = th2*th;
+			double b0 = th-223.0/81*th2+50.0/27*th3;
+			double b2 = 775.0/189*th2-100.0/27*th3;
+			double b3 = -175.0/108*th2+50.0/27*th3;
+			double b4 = 25.0/81*th2;
+			double b5 = -1.0/28*th2;
+			for(int j=0; j<n_state; j++)
+				y[j] = y0[j]+b0*k[j]+b2*k[2*n_state+j]+b3*k[3*n_state+j]+b4*k[4*n_state+j]+b5*k[5*n_state+j];
+		}
+		else
+		{
+			for(int j=0; j<n_state; j++)
+				y[j] = y0[j]+th*(y1[j]-y0[j]);
+		}
+
+		set_state(y);
+		write(f,run.t_out,c);
 
+		//Multiples of the interval, without accumulating rounding errors.
+		run.t_out = (llround(run.t_out/out_interval)+1)*out_interval;
+	}
+	set_state(y1);
+}
+
+
+void CPGSimulator::out(FILE *f,const void * data,size_t n)
+{
+	if(writer)
+		writer->write(f,data,n);
+	else
+		fwrite(data,1,n,f);
+}
+
+
+void CPGSimulator::flush_trace(FILE *f)
+{
+	if(format != DELTA || delta.pending() == 0)
+		return;
+	const std::vector<unsigned char> &block = delta.encode();
+	out(f,block.data(),block.size());
 }
 
 
@@ -143,66 +717,274 @@ void CPGSimulator::simulate(FILE * f,FILE * f_spks,double iters,double dt,integr
 	//   Simulation Mode Parameters
 	////////////////////////////////////////////////////////
 
-	
-	int serie =0;//Variable used to reduce output file dimension. 
-	double t=0.0;
-	double c =0;
-
-	std::vector<double> prevs(n_neurons,1);//Auxiliar vector for spike detection
+	if(!resumed)
+		reset_run(dt);
 
 	// "In satiated animals, N3t keeps the feeding network under its suppressive control." [1]
-	// To simulate satiated activity N3t is stimulated by the injected current, while N1M value is supressed.
-	std::vector<double> c_values_staited({c_values[VavoulisModel::SO],0,c_values[VavoulisModel::N2v],25});
-	std::vector<double> c_values_save;
+	// To simulate satiated activity N3t is stimulated by the injected current, while N1M value is supressed (see StimProtocol).
+	// With fixed steps the window starts at the step satiated_ini, so it is set half a step earlier than its time to be safe from the
+	// rounding of the accumulated time. The adaptive integrators step exactly to it.
+	bool adaptive = integration == ADAPTIVE || integration == ADAPTIVE_ROSENBROCK;
+	double shift = adaptive ? 0 : dt/2;
+	if(satiated_ini >= 0 || satiated_end >= 0)
+		protocol.satiated(satiated_ini >= 0 ? satiated_ini*dt-shift : INFINITY,satiated_end >= 0 ? satiated_end*dt-shift : INFINITY);
+
+	TextSpikeSink text_sink(f_spks,n_neurons,writer);
+	SpikeSink &sink = spike_sink ? *spike_sink : text_sink;
+
+	long iter0 = run.iter, rhs0 = 0, f_bytes = 0, f_spks_bytes = 0;
+	if(stats)
+	{
+		if(writer)
+			writer->flush();
+		rhs0 = stats->rhs_evals;
+		f_bytes = f ? ftell(f) : 0;
+		f_spks_bytes = f_spks ? ftell(f_spks) : 0;
+		stats->start();
+	}
 
-	for (int i=0; i < iters; i++)
+	if(adaptive)
 	{
+		simulate_adaptive(f,sink,integration,iters*dt,dt);
+	}
+	else
+	{
+		long ckpt_every = ckpt_interval > 0 ? llround(ckpt_interval/dt) : 0;
+		long start = run.iter;
 
-      serie = (serie + 1) % 4;
-      if (serie == 3)
-      {
-		write(f,t,c);
+		for (; run.iter < iters; run.iter++)
+		{
+			long i = run.iter;
+
+			if(ckpt_every > 0 && i > start && i%ckpt_every == 0)
+			{
+				save_checkpoint(f,sink,integration,dt);
+				if(stats) stats->lap(SimStats::CHECKPOINT);
+			}
+
+			//With an output interval the records within the step are interpolated once it is done.
+			bool dense = out_interval > 0 && run.t_out < run.t+dt;
+			if(dense)
+				get_state(v_dense.data());
+			else if(out_interval == 0)
+			{
+				run.serie = (run.serie + 1) % OUT_DECIMATION;
+				if (run.serie == OUT_DECIMATION-1)
+				{
+					write(f,run.t,run.c);
+					if(stats) stats->lap(SimStats::OUTPUT);
+				}
+			}
+
+			//Currents of the step, from the stimulation protocol.
+			protocol.seek(run.t);
+			if(stats) stats->lap(SimStats::PROTOCOL);
+
+			//Integrate variables in the model. 
+			run.c = update_all(run.t,integration,dt);
+			if(stats) stats->lap(SimStats::INTEGRATION);
+
+			if(dense)
+			{
+				write_dense(f,run.t,dt,integration,run.c);
+				if(stats) stats->lap(SimStats::OUTPUT);
+			}
+
+			//Detect spikes and write in spikes file.
+			detect_spikes(sink,run.prevs,dv_time(integration,run.t,dt),dt);
+			if(stats) stats->lap(SimStats::SPIKES);
+
+			run.t += dt;
+
+			if(i==(int)iters/2)
+				cout << "Half iterations" << endl;
+		}
+	}
+
+	flush_trace(f);
+	if(stats) stats->lap(SimStats::OUTPUT);
 
-	  }
+	if(!ckpt_file.empty())
+		save_checkpoint(f,sink,integration,dt);
+	if(stats) stats->lap(SimStats::CHECKPOINT);
 
-		//////////////////////////////////////////////////////////////
-		/////////////// SIMULATING SATIATED BEHAVIOUR ////////////////
-		//////////////////////////////////////////////////////////////
+	spike_ring.drain(sink);
+	if(stats) stats->lap(SimStats::SPIKES);
+	if(writer)
+		writer->flush();
+
+	if(stats)
+	{
+		stats->lap(SimStats::OUTPUT);
+		stats->stop();
+		stats->steps += run.iter-iter0;
+		stats->exp_calls += exp_calls(integration,stats->rhs_evals-rhs0,run.iter-iter0);
+		if(f)
+			stats->trace_bytes += ftell(f)-f_bytes;
+		if(f_spks)
+			stats->spike_bytes += ftell(f_spks)-f_spks_bytes;
+	}
 
-		if(satiated_ini==i)
+	resumed = false;
+
+}
+
+
+void CPGSimulator::reset_run(double dt)
+{
+	run.iter = 0;
+	run.t = 0.0;
+	run.h = dt;
+	run.t_out = out_interval > 0 ? 0 : (OUT_DECIMATION-2)*dt; //Same first instant as the fixed step loop
+	run.t_ckpt = ckpt_interval;
+	run.serie = 0; //Variable used to reduce output file dimension. 
+	run.c = 0;
+	run.prevs.assign(n_neurons,1); //Auxiliar vector for spike detection
+}
+
+
+long CPGSimulator::advance(long steps,double dt,integrators integration,int decimation,double * t_out,double * v_out,double * c_out,long max_samples,long * n_samples,SpikeSink &sink)
+{
+	*n_samples = 0;
+	if(integration == ADAPTIVE || integration == ADAPTIVE_ROSENBROCK || decimation < 1)
+		return -1;
+
+	if(run.prevs.size() != (unsigned int)n_neurons)
+		reset_run(dt);
+	resumed = false;
+
+	bool sampled = t_out || v_out || c_out;
+	long k;
+	for(k=0; k<steps; k++)
+	{
+		//Same records as the trace file when decimation is OUT_DECIMATION.
+		int serie = (run.serie + 1) % decimation;
+		if(sampled && serie == decimation-1)
+		{
+			long s = *n_samples;
+			if(s == max_samples)
+				break;
+			if(t_out)
+				t_out[s] = run.t;
+			if(v_out)
+				for(int n=0; n<n_neurons; n++)
+					v_out[s*n_neurons+n] = neurons[n].V();
+			if(c_out)
+				c_out[s] = run.c;
+			(*n_samples)++;
+		}
+		run.serie = serie;
+
+		protocol.seek(run.t);
+		run.c = update_all(run.t,integration,dt);
+		detect_spikes(sink,run.prevs,dv_time(integration,run.t,dt),dt);
+		run.t += dt;
+		run.iter++;
+	}
+
+	spike_ring.drain(sink);
+	return k;
+}
+
+
+void CPGSimulator::simulate_adaptive(FILE * f,SpikeSink &sink,integrators integration,double t_end,double dt)
+{
+	double dec_interval=OUT_DECIMATION*dt; //Time between records without an output interval
+	bool half=run.t >= t_end/2;
+	long start=run.iter;
+
+	while(run.t < t_end)
+	{
+		double t = run.t;
+
+		if(ckpt_interval > 0 && t >= run.t_ckpt)
 		{
-			c_values_save = c_values; //save current values
-			c_values = c_values_staited; //assign satiated current values
+			if(run.iter > start)
+				save_checkpoint(f,sink,integration,dt);
+			while(run.t_ckpt <= t)
+				run.t_ckpt += ckpt_interval;
+			if(stats) stats->lap(SimStats::CHECKPOINT);
 		}
-		if(satiated_end==i)
+
+		if(out_interval == 0 && t >= run.t_out)
 		{
-			c_values = c_values_save; //restore current values
+			write(f,t,run.c);
+			while(run.t_out <= t)
+				run.t_out += dec_interval;
+			if(stats) stats->lap(SimStats::OUTPUT);
 		}
 
+		//Do not step over the changes of the stimulation protocol nor the end of the simulation.
+		protocol.seek(t);
+		double t_next = min(t_end,protocol.getNextChange());
+		if(stats) stats->lap(SimStats::PROTOCOL);
+		if(run.h > t_next-t)
+			run.h = t_next-t;
+
+		//The step done is not longer than the one tried.
+		bool dense = out_interval > 0 && run.t_out < t+run.h;
+		if(dense)
+			get_state(v_dense.data());
 
-		///////////////////////////////////////////////////////////
+		double h_done = update_adaptive(t,run.h,integration);
+		run.c = current_value();
+		if(stats) stats->lap(SimStats::INTEGRATION);
 
-		//Integrate variables in the model. 
-		c = update_all(t,integration,dt);
+		if(dense)
+		{
+			write_dense(f,t,h_done,integration,run.c);
+			if(stats) stats->lap(SimStats::OUTPUT);
+		}
 
-		//Detect spikes and write in spikes file.
-  		detect_spikes(f_spks,prevs,t);
+		detect_spikes(sink,run.prevs,t+h_done,h_done);
+		if(stats) stats->lap(SimStats::SPIKES);
 
-		t += dt;
+		run.t += h_done;
+		run.iter++;
 
-		if(i==(int)iters/2)
+		if(!half && run.t >= t_end/2)
+		{
 			cout << "Half iterations" << endl;
+			half = true;
+		}
 	}
 
+	cout << "Adaptive steps: " << run.iter << endl;
+}
+
 
+std::vector<int> CPGSimulator::getTypes()
+{
+	std::vector<int> types(n_neurons);
+	for(int i=0; i<n_neurons; i++)
+		types[i] = neurons[i].type;
+	return types;
 }
 
 
-void CPGSimulator::detect_spikes(FILE * f_spks, std::vector<double> &prevs, double t )
+long CPGSimulator::exp_calls(integrators integration,long rhs_evals,long steps)
 {
+	long per_rhs = synapses.size()*VavoulisSynapse::getNExp();
+	long gated = synapses.size()*VavoulisSynapse::getNGated();
+	for(int i=0; i<n_neurons; i++)
+	{
+		per_rhs += neurons[i].getNExp();
+		gated += neurons[i].getNGated();
+	}
+
+	//Exponential integrators: one expm1 per gating variable, and one more at the end of the step in the midpoint version.
+	long per_step = 0;
+	if(integration == RUSH_LARSEN)
+		per_step = gated;
+	else if(integration == RUSH_LARSEN_MID)
+		per_step = 2*gated;
+
+	return rhs_evals*per_rhs+steps*per_step;
+}
+
 
-	bool fst_inrow = true;
-	string buff ="";
+void CPGSimulator::detect_spikes(SpikeSink &sink, std::vector<double> &prevs, double t, double h)
+{
 	double dev;
 
 	for(int n=0; n<n_neurons; ++n)
@@ -210,31 +992,26 @@ void CPGSimulator::detect_spikes(FILE * f_spks, std::vector<double> &prevs, doub
 		dev = neurons[n].getdV();
 		//0.001 less than that change in the derivative is not a spike
 		//NOTE: it might be necessary to adjust MIN_SPIKE_CHANGE for different spike shapes. 
-		if(prevs[n] >0 && dev <0 && (prevs[n]-dev)>MIN_SPIKE_CHANGE) //If it's a spike (from pos derivate to 0 derivate)
+		if(prevs[n] >0 && dev <0 && (prevs[n]-dev)>MIN_SPIKE_CHANGE && neurons[n].V() >SPIKE_TH) //If it's a spike (from pos derivate to 0 derivate)
 		{
-			fst_inrow = false;
-
-			if(neurons[n].V() >SPIKE_TH)
-				buff += to_string(neurons[n].V()) +" ";
+			if(spike_ring.full())
+				spike_ring.drain(sink);
+			spike_ring.push(spike_event(n,t,h,prevs[n],dev,neurons[n].V()));
+			if(stats)
+				stats->spikes++;
 		}
-		else
-				buff +=", ";
 
 		prevs[n]=dev;
-
 	}
-	if(!fst_inrow)
-	{
-			fprintf(f_spks,"%f %s\n",t,buff.c_str());
-	}
-		
 }
 
 
 
 double CPGSimulator::update_all(double _time, integrators integr,double dt)
 {
-	if(integr == EULER)
+	if(pool && (integr == EULER || integr == RUSH_LARSEN || integr == RUNGE))
+		update_parallel(_time, integr, dt);
+	else if(integr == EULER)
 	{
 		update_euler(_time, dt);
 	}
@@ -243,15 +1020,22 @@ double CPGSimulator::update_all(double _time, integrators integr,double dt)
 		update_runge(_time, dt);	
 
 	}
+	else if(integr == RUSH_LARSEN)
+		update_rush_larsen(_time, dt);
+	else if(integr == RUSH_LARSEN_MID)
+		update_rush_larsen_mid(_time, dt);
+	else if(integr == ROSENBROCK)
+		update_rosenbrock(_time, dt);
 
+	return current_value();
 
-	for (int i=0; i< n_neurons; i++)
-		if(c_values[i]==-1)
-			return rg.get_ext(c_values[i],_time);
-
+}
 
-	return c_values[VavoulisModel::N1M];
 
+double CPGSimulator::current_value()
+{
+	int i = protocol.ramp_neuron();
+	return protocol.value(i >= 0 ? i : i_report);
 }
 
 
@@ -263,15 +1047,19 @@ void CPGSimulator::update_euler(double _time, double dt)
 	for(int i=0; i<n_neurons; i++)
 	{
 		isyn=0;
-		for(int j=0; j< (int)syns[i].size();j++)
+		double v = neurons[i].V();
+		for(int k=syn_ptr[i]; k<syn_ptr[i+1]; k++)
 		{
-			isyn+=syns[i][j].Isyn();
-			syns[i][j].update_variables(dt,_time);
+			isyn+=synapses[k].Isyn(v);
+			synapses[k].update_variables(dt,_time,neurons[syn_pre[k]].V());
 		}
-		i_ext = rg.get_ext(c_values[i],_time);
+		i_ext = protocol.value(i);
 		neurons[i].update_variables( dt, _time, i_ext,isyn);
 	}
 
+	//In-place sweep without diffs, it evaluates the equations of every neuron and synapse once.
+	if(stats)
+		stats->rhs_evals++;
 }
 
 
@@ -282,200 +1070,529 @@ void CPGSimulator::update_runge(double _time, double dt)
 }
 
 
-void CPGSimulator::diffs(double _time,const std::vector<std::vector<double > > & v_variables, std::vector<std::vector<double > >  &v_fvec)
-{	
+void CPGSimulator::update_rush_larsen(double _time, double dt)
+{
+	double * vars = v_variables.data();
+	double * retorno = v_retorno.data();
+	double * tau = v_tau.data();
 
-	int n_vars=VavoulisModel::getNVars();
-	int n_vars_syns=VavoulisSynapse::getNVars();
+	get_state(vars);
+	diffs(_time,vars,retorno,tau);
 
-	std::vector<double> ret(n_vars);
-	std::vector<double> ret_syn(n_vars_syns);
+	//x_inf-x = f*tau, so x_inf+(x-x_inf)*exp(-dt/tau) = x+f*tau*(1-exp(-dt/tau))
+	for(int j=0; j<n_state; ++j)
+	{
+		if(tau[j] > 0)
+			vars[j] += retorno[j]*tau[j]*-expm1(-dt/tau[j]);
+		else
+			vars[j] += retorno[j]*dt;
+	}
 
+	set_state(vars);
+}
 
-	int pre_index =-1;
-	double vpre=-1;
-	double i_syn=0;
-	double i_ext =0;
 
-	//Iterate through neurons array 
-	for(int i=0; i<n_neurons; i++)
+void CPGSimulator::update_parallel(double _time, integrators integr, double dt)
+{
+	double * vars = v_variables.data();
+	double * apoyo = v_apoyo.data();
+	double * retorno = v_retorno.data();
+	double * tau = integr == RUSH_LARSEN ? v_tau.data() : NULL;
+	double * pre[2] = {v_pre.data(), v_pre.data()+n_neurons};
+
+	std::function<void(int)> job = [&](int tid)
 	{
-		//reset return vector. 
-		v_fvec[i].clear();
-		i_syn=0;
+		int b0 = thread_block[tid], b1 = thread_block[tid+1];
 
-		//Iterate through each neuron synapse
-		for(int j=0; j<(int)syns[i].size(); j++)
+		for(int b=b0; b<b1; b++)
 		{
-			int ref = j*n_vars_syns+n_vars;
-
-			//Get update vector from the synapse 
-			std::vector<double> vars_syns(v_variables[i].begin()+ref,v_variables[i].begin()+ref+n_vars_syns);
+			get_state(vars,block_ptr[b],block_ptr[b+1]);
+			for(int i=block_ptr[b]; i<block_ptr[b+1]; i++)
+				pre[0][i] = vars[offsets[i]];
+		}
+		pool->barrier();
 
-			//Obtain synaptic current
-			i_syn += syns[i][j].Isyn(vars_syns,v_variables[i][0]); //v_value
-			
-			//Get Vpre value as the Vs of the presynaptic neuron in the synapse. 
-			pre_index = syns[i][j].getPreType();
-			vpre = v_variables[pre_index][0];
+		if(integr == RUNGE)
+		{
+			for(int s=0; s<6; s++)
+			{
+				for(int b=b0; b<b1; b++)
+					rk_stage(s,_time,dt,block_ptr[b],block_ptr[b+1],pre[s&1],s<5 ? pre[(s+1)&1] : NULL);
+				if(s < 5)
+					pool->barrier();
+			}
+			for(int b=b0; b<b1; b++)
+				set_state(apoyo,block_ptr[b],block_ptr[b+1]);
+			return;
+		}
 
-			syns[i][j].diffs_fun(_time, vars_syns, ret_syn, vpre);
-			//Add syn variables to return vector. 
-			v_fvec[i].insert(v_fvec[i].end(),ret_syn.begin(),ret_syn.end());
+		//Euler and Rush-Larsen, as in update_rush_larsen
+		for(int b=b0; b<b1; b++)
+		{
+			int n0 = block_ptr[b], n1 = block_ptr[b+1];
+			int j1 = n1<n_neurons ? offsets[n1] : n_state;
+
+			diffs(_time,vars,retorno,tau,n0,n1,pre[0]);
+			for(int j=offsets[n0]; j<j1; ++j)
+			{
+				if(tau && tau[j] > 0)
+					vars[j] += retorno[j]*tau[j]*-expm1(-dt/tau[j]);
+				else
+					vars[j] += retorno[j]*dt;
+			}
+			set_state(vars,n0,n1);
 		}
+	};
+
+	pool->run(job);
+}
 
-		//Get update vector from the synapse. 
-		std::vector<double> vars_neu(v_variables[i].begin(),v_variables[i].begin()+n_vars);
-		i_ext = rg.get_ext(c_values[i],_time);
-		neurons[i].diffs_fun(_time, vars_neu,ret, i_ext,i_syn);
 
-		//Add neuron variables to return vector. 
-		v_fvec[i].insert(v_fvec[i].begin(),ret.begin(),ret.end());
+void CPGSimulator::update_rush_larsen_mid(double _time, double dt)
+{
+	double * vars = v_variables.data();
+	double * mid = v_apoyo.data();
+	double * retorno = v_retorno.data();
+	double * tau = v_tau.data();
+	double * tau_mid = tau+n_state;
+	double half = dt/2;
+
+	get_state(vars);
+	diffs(_time,vars,retorno,tau);
 
+	for(int j=0; j<n_state; ++j)
+	{
+		if(tau[j] > 0)
+			mid[j] = vars[j]+retorno[j]*tau[j]*-expm1(-half/tau[j]);
+		else
+			mid[j] = vars[j]+retorno[j]*half;
 	}
 
+	diffs(_time+half,mid,retorno,tau_mid);
+
+	for(int j=0; j<n_state; ++j)
+	{
+		if(tau_mid[j] > 0)
+		{
+			double x_inf = mid[j]+retorno[j]*tau_mid[j];
+			vars[j] = x_inf+(vars[j]-x_inf)*exp(-dt/tau_mid[j]);
+		}
+		else
+			vars[j] += retorno[j]*dt;
+	}
+
+	set_state(vars);
 }
 
 
-/*======================================*/
-/* Rutina de integración                */
-/*======================================*/
-double CPGSimulator::intey(double _time, double inc_integracion)
-{	
-	std::vector<std::vector<double > > v_apoyo(n_neurons);
-	std::vector<std::vector<double > > v_variables(n_neurons);
-	std::vector<std::vector<double > > v_retorno(n_neurons);
-	double v_k[n_neurons][6][MAX_VARS];
-	int n_total_variables[n_neurons];
+void CPGSimulator::update_rosenbrock(double _time, double dt)
+{
+	double * vars = v_variables.data();
+	double * apoyo = v_apoyo.data();
+	double * f0 = v_k.data()+4*n_state;
 
-	double u=0.0;
-	int j;
-	int i;
-	int total_variables;
+	get_state(vars);
+	diffs(_time,vars,f0);
+	jacobian(_time,vars,f0);
+	ros_stages(_time,dt);
 
-	for(i=0; i < n_neurons; ++i)
-	{
-		total_variables = neurons[i].getNVars()+syns[i].size()*VavoulisSynapse::getNVars();
-		n_total_variables[i]=total_variables;
+	set_state(apoyo);
+	diffs(_time+dt,apoyo,v_retorno.data()); //dV at the end of the step
+}
 
-		std::vector<double> vars_neu = neurons[i].getVariables();
-		v_variables[i].insert(v_variables[i].end(),vars_neu.begin(),vars_neu.end());
 
-		for(int j=0; j<(int)syns[i].size(); j++)
+void CPGSimulator::ros_stages(double _time, double dt)
+{
+	//Kaps-Rentrop method with Shampine parameters (Press et al., Numerical Recipes, stiff)
+	const double gam=0.5, a21=2.0, a31=48.0/25, a32=6.0/25;
+	const double c21=-8.0, c31=372.0/25, c32=12.0/5, c41=-112.0/125, c42=-54.0/125, c43=-2.0/5;
+	const double b1=19.0/9, b2=0.5, b3=25.0/108, b4=125.0/108;
+	const double e1=17.0/54, e2=7.0/36, e3=0.0, e4=125.0/108;
+	const double a2x=1.0, a3x=3.0/5;
+
+	double * vars = v_variables.data();
+	double * apoyo = v_apoyo.data();
+	double * other = v_error.data();
+	double * retorno = v_retorno.data();
+	double * g1 = v_k.data();
+	double * g2 = g1+n_state;
+	double * g3 = g2+n_state;
+	double * g4 = g3+n_state;
+	double * f0 = g4+n_state;
+	double * jac = v_jac.data();
+	double * w = jac+n_state*n_state;
+	int * piv = v_pivots.data();
+	int n = n_state;
+
+	//W = I/(gam*dt)-J
+	for(int i=0; i<n*n; i++)
+		w[i] = -jac[i];
+	for(int i=0; i<n; i++)
+		w[i*n+i] += 1/(gam*dt);
+
+	if(!lu_factor(w,piv,n))
+	{
+		cerr << "Warning: singular Rosenbrock matrix at t=" << _time << ", Euler step used" << endl;
+		for(int j=0; j<n; j++)
 		{
-			//Get update vector from the synapse 
-			std::vector<double> vars_syns = syns[i][j].getVariables();
-			v_variables[i].insert(v_variables[i].end(),vars_syns.begin(),vars_syns.end());
+			apoyo[j] = vars[j]+dt*f0[j];
+			other[j] = 0;
 		}
+		return;
+	}
 
+	for(int j=0; j<n; j++)
+		g1[j] = f0[j];
+	lu_solve(w,piv,n,g1);
+
+	for(int j=0; j<n; j++)
+		apoyo[j] = vars[j]+a21*g1[j];
+	diffs(_time+a2x*dt,apoyo,retorno);
+	for(int j=0; j<n; j++)
+		g2[j] = retorno[j]+c21*g1[j]/dt;
+	lu_solve(w,piv,n,g2);
+
+	for(int j=0; j<n; j++)
+		apoyo[j] = vars[j]+a31*g1[j]+a32*g2[j];
+	diffs(_time+a3x*dt,apoyo,retorno);
+	for(int j=0; j<n; j++)
+		g3[j] = retorno[j]+(c31*g1[j]+c32*g2[j])/dt;
+	lu_solve(w,piv,n,g3);
+
+	//Last stage reuses the third evaluation
+	for(int j=0; j<n; j++)
+		g4[j] = retorno[j]+(c41*g1[j]+c42*g2[j]+c43*g3[j])/dt;
+	lu_solve(w,piv,n,g4);
+
+	for(int j=0; j<n; j++)
+	{
+		apoyo[j] = vars[j]+b1*g1[j]+b2*g2[j]+b3*g3[j]+b4*g4[j];
+		other[j] = e1*g1[j]+e2*g2[j]+e3*g3[j]+e4*g4[j];
 	}
+}
 
-	diffs(_time, v_variables,v_retorno);
 
+void CPGSimulator::jacobian(double _time, double * vars, const double * f0)
+{
+	const double sq_eps = sqrt(DBL_EPSILON);
 
-	for(i=0; i < n_neurons; ++i)
+	if(v_jac.empty())
 	{
-		for(j=0;j<n_total_variables[i];++j)
-		{
-		  	v_k[i][0][j]=inc_integracion*v_retorno[i][j];
-		  	//Update neurons
-		  	v_apoyo[i].resize(v_variables[i].size());
-			v_apoyo[i][j]=v_variables[i][j]+v_k[i][0][j]*.2;
-		} 
+		v_jac.assign(2*(size_t)n_state*n_state,0);
+		v_pivots.assign(n_state,0);
 	}
 
+	double * f = v_retorno.data();
+	double * jac = v_jac.data();
+	double * eps = v_jac.data()+(size_t)n_state*n_state; //W is not in use yet
+	int n = n_state;
+	int max_block = 0;
 
+	for(int m=0; m<n_neurons; m++)
+	{
+		int size = (m+1<n_neurons ? offsets[m+1] : n_state)-offsets[m];
+		if(size > max_block)
+			max_block = size;
+	}
 
+	//Same variable of every block at once, except voltages. Each block only sees its own perturbation.
+	for(int k=1; k<max_block; k++)
+	{
+		for(int m=0; m<n_neurons; m++)
+		{
+			int end = m+1<n_neurons ? offsets[m+1] : n_state;
+			int j = offsets[m]+k;
+			if(j >= end)
+				continue;
+			eps[j] = sq_eps*fmax(fabs(vars[j]),1.0);
+			double x = vars[j];
+			vars[j] += eps[j];
+			eps[j] = vars[j]-x; //Exactly representable increment
+		}
 
-	diffs(_time+inc_integracion/5, v_apoyo,v_retorno);
+		diffs(_time,vars,f);
 
-	for(i=0; i < n_neurons; ++i)
-	{
-		for(j=0;j<n_total_variables[i];++j)
+		for(int m=0; m<n_neurons; m++)
 		{
-		  	v_k[i][1][j]=inc_integracion*v_retorno[i][j];
-			v_apoyo[i][j]=v_variables[i][j]+v_k[i][0][j]*.075+v_k[i][1][j]*0.225;
-		} 
+			int end = m+1<n_neurons ? offsets[m+1] : n_state;
+			int j = offsets[m]+k;
+			if(j >= end)
+				continue;
+			vars[j] -= eps[j];
+			for(int i=0; i<n; i++)
+				jac[i*n+j] = 0;
+			for(int i=offsets[m]; i<end; i++)
+				jac[i*n+j] = (f[i]-f0[i])/eps[j];
+		}
+	}
+
+	//Voltages also drive the synapses of other neurons, one at a time.
+	for(int m=0; m<n_neurons; m++)
+	{
+		int j = offsets[m];
+		double x = vars[j];
+		double h = sq_eps*fmax(fabs(x),1.0);
+		vars[j] += h;
+		h = vars[j]-x;
+
+		diffs(_time,vars,f);
+		vars[j] = x;
+
+		for(int i=0; i<n; i++)
+			jac[i*n+j] = (f[i]-f0[i])/h;
 	}
+}
 
-	diffs(_time+inc_integracion*0.3, v_apoyo,v_retorno);
 
-	for(i=0; i < n_neurons; ++i)
+double CPGSimulator::dv_time(integrators integration,double _time,double dt)
+{
+	switch(integration)
 	{
-		for(j=0;j<n_total_variables[i];++j)
-	  	{
-		  	v_k[i][2][j]=inc_integracion*v_retorno[i][j];
-			v_apoyo[i][j]=v_variables[i][j]+v_k[i][0][j]*.3-v_k[i][1][j]*0.9+v_k[i][2][j]*1.2;
-		}
+		case EULER:
+		case RUSH_LARSEN:
+			return _time;
+		case RUSH_LARSEN_MID:
+			return _time+dt/2;
+		default: //Runge-Kutta, last stage at the end of the step
+			return _time+dt;
 	}
+}
 
-	diffs(_time+inc_integracion*0.6, v_apoyo,v_retorno);
 
-	for(i=0; i < n_neurons; ++i)
+double CPGSimulator::update_adaptive(double _time, double &dt, integrators integration)
+{
+	//Step size bounds
+	const double safety = 0.9;
+	const double min_factor = 0.2;
+	const double max_factor = 5.0;
+	const double dt_min = 1e-9;
+
+	double * vars = v_variables.data();
+	double * apoyo = v_apoyo.data();
+	double * other = v_error.data();
+	double h = dt;
+	bool rosenbrock = integration == ADAPTIVE_ROSENBROCK;
+	double expo = rosenbrock ? -0.25 : -0.2; //-1/(q+1), q order of the error estimate
+
+	get_state(vars);
+	if(rosenbrock)
 	{
-		for(j=0;j<n_total_variables[i];++j)
-	  	{
-		  	v_k[i][3][j]=inc_integracion*v_retorno[i][j];
-			v_apoyo[i][j]=v_variables[i][j]+v_k[i][0][j]*0.075+v_k[i][1][j]*0.675-v_k[i][2][j]*0.6+v_k[i][3][j]*0.75;
-	  	} 	
+		double * f0 = v_k.data()+4*n_state;
+		diffs(_time,vars,f0);
+		jacobian(_time,vars,f0); //Rejected steps only factorize W again
 	}
 
-	diffs(_time+inc_integracion*0.9, v_apoyo,v_retorno);
-	for(i=0; i < n_neurons; ++i)
+	while(true)
 	{
-		for(j=0;j<n_total_variables[i];++j)
+		if(rosenbrock)
+			ros_stages(_time,h);
+		else
+			rk_stages(_time,h);
+
+		//Error norm: maximum of the scaled difference between both solutions.
+		double err = 0;
+		for(int j=0; j<n_state; j++)
+		{
+			double sc = atol + rtol*fmax(fabs(vars[j]),fabs(apoyo[j]));
+			double e = (rosenbrock ? fabs(other[j]) : fabs(other[j]-apoyo[j]))/sc;
+			if(e > err)
+				err = e;
+		}
+
+		if(err <= 1 || h <= dt_min)
 		{
-		  	v_k[i][4][j]=inc_integracion*v_retorno[i][j];
-			v_apoyo[i][j]=v_variables[i][j]+v_k[i][0][j]*0.660493827160493
-		       +v_k[i][1][j]*2.5
-		       -v_k[i][2][j]*5.185185185185185
-		       +v_k[i][3][j]*3.888888888888889
-		       -v_k[i][4][j]*0.864197530864197;
+			if(h <= dt_min && err > 1)
+				cerr << "Warning: minimum time step reached at t=" << _time << endl;
+
+			set_state(apoyo);
+			if(rosenbrock)
+				diffs(_time+h,apoyo,v_retorno.data()); //dV at the end of the step
+			double factor = err == 0 ? max_factor : fmin(max_factor,safety*pow(err,expo));
+			dt = fmin(h*factor,dt_max);
+			return h;
 		}
+
+		h = fmax(h*fmax(min_factor,safety*pow(err,expo)),dt_min);
 	}
+}
 
-	diffs(_time+inc_integracion, v_apoyo,v_retorno);
 
-	for(i=0; i < n_neurons; ++i)
+void CPGSimulator::diffs(double _time,const double * v_variables, double * v_fvec, double * v_tau,int n0,int n1,const double * v_pre)
+{	
+
+	int n_vars=VavoulisModel::getNVars();
+	int n_vars_syns=VavoulisSynapse::getNVars();
+
+	int pre_index =-1;
+	double vpre=-1;
+	double i_syn=0;
+	double i_ext =0;
+
+	if(n1 < 0)
+		n1 = n_neurons;
+
+	//The block starting at neuron 0 is evaluated once per evaluation of the whole network, by a single thread.
+	if(stats && n0 == 0)
+		stats->rhs_evals++;
+
+	//Iterate through neurons array 
+	for(int i=n0; i<n1; i++)
 	{
-		for(j=0;j<n_total_variables[i];++j)
+		const double * vars_neu = v_variables+offsets[i];
+		double * ret = v_fvec+offsets[i];
+		i_syn=0;
+
+		//Iterate through each neuron synapse
+		for(int k=syn_ptr[i]; k<syn_ptr[i+1]; k++)
 		{
-		  	v_k[i][5][j]=inc_integracion*v_retorno[i][j];
-			v_apoyo[i][j]=v_variables[i][j]+v_k[i][0][j]*0.1049382716049382+
-			       v_k[i][2][j]*0.3703703703703703+
-			       v_k[i][3][j]*0.2777777777777777+
-			       v_k[i][4][j]*0.2469135802469135;
+			int ref = (k-syn_ptr[i])*n_vars_syns+n_vars;
+
+			//Obtain synaptic current
+			i_syn += synapses[k].Isyn(vars_neu+ref,vars_neu[0]); //v_value
+			
+			//Get Vpre value as the Vs of the presynaptic neuron in the synapse. 
+			pre_index = syn_pre[k];
+			vpre = v_pre ? v_pre[pre_index] : v_variables[offsets[pre_index]];
+
+			if(v_tau)
+				synapses[k].diffs_fun(_time, vars_neu+ref, ret+ref, vpre, v_tau+offsets[i]+ref);
+			else
+				synapses[k].diffs_fun(_time, vars_neu+ref, ret+ref, vpre);
 		}
 
-	 }
-		
-	for(i=0; i < n_neurons; ++i)
+		i_ext = protocol.value(i);
+		if(v_tau)
+			neurons[i].diffs_fun(_time, vars_neu,ret, i_ext,i_syn, v_tau+offsets[i]);
+		else
+			neurons[i].diffs_fun(_time, vars_neu,ret, i_ext,i_syn);
+
+	}
+
+}
+
+
+/*======================================*/
+/* Rutina de integración                */
+/*======================================*/
+double CPGSimulator::intey(double _time, double inc_integracion)
+{	
+	double u=0.0;
+
+	get_state(v_variables.data());
+
+	rk_stages(_time, inc_integracion);
+
+	set_state(v_apoyo.data());
+	
+  return u;
+}
+
+
+void CPGSimulator::rk_stages(double _time, double inc_integracion)
+{	
+	for(int s=0; s<6; s++)
+		rk_stage(s,_time,inc_integracion,0,n_neurons,NULL,NULL);
+}
+
+
+void CPGSimulator::rk_stage(int s, double _time, double inc_integracion, int n0, int n1, const double * v_pre, double * v_pre_next)
+{	
+	double * vars = v_variables.data();
+	double * apoyo = v_apoyo.data();
+	double * retorno = v_retorno.data();
+	double * k0 = v_k.data();
+	double * k1 = k0+n_state;
+	double * k2 = k1+n_state;
+	double * k3 = k2+n_state;
+	double * k4 = k3+n_state;
+	double * k5 = k4+n_state;
+	double * other = v_error.data();
+
+	int j;
+	int j0 = offsets[n0];
+	int j1 = n1<n_neurons ? offsets[n1] : n_state;
+
+	switch(s)
 	{
-		for(j=0;j<n_total_variables[i];++j)
+	case 0:
+		diffs(_time, vars,retorno,NULL,n0,n1,v_pre);
+
+		for(j=j0;j<j1;++j)
 		{
-			v_apoyo[i][j]=v_variables[i][j]+v_k[i][0][j]*0.098765432098765+
-	                       v_k[i][2][j]*0.396825396825396+
-	                       v_k[i][3][j]*0.231481481481481+
-	                       v_k[i][4][j]*0.308641975308641-
-	                       v_k[i][5][j]*0.035714285714285;
+			k0[j]=inc_integracion*retorno[j];
+			apoyo[j]=vars[j]+k0[j]*.2;
 		}
+		break;
 
-	 }
-	
-	for(i=0; i < n_neurons; ++i)
-	{
-		neurons[i].set_variables(v_apoyo[i]);
-		int n= neurons[i].getNVars();
+	case 1:
+		diffs(_time+inc_integracion/5, apoyo,retorno,NULL,n0,n1,v_pre);
 
-	  	for(int j=0; j<(int)syns[i].size(); j++)
+		for(j=j0;j<j1;++j)
 		{
-			//Get update vector from the synapse 
-			std::vector<double> vars_syns(v_apoyo[i].begin()+j*2+n,v_apoyo[i].begin()+j*2+n+2);
-			syns[i][j].set_variables(vars_syns);
+			k1[j]=inc_integracion*retorno[j];
+			apoyo[j]=vars[j]+k0[j]*.075+k1[j]*0.225;
 		}
-	 }
-	
-  return u;
-}
+		break;
+
+	case 2:
+		diffs(_time+inc_integracion*0.3, apoyo,retorno,NULL,n0,n1,v_pre);
+
+		for(j=j0;j<j1;++j)
+		{
+			k2[j]=inc_integracion*retorno[j];
+			apoyo[j]=vars[j]+k0[j]*.3-k1[j]*0.9+k2[j]*1.2;
+		}
+		break;
+
+	case 3:
+		diffs(_time+inc_integracion*0.6, apoyo,retorno,NULL,n0,n1,v_pre);
+
+		for(j=j0;j<j1;++j)
+		{
+			k3[j]=inc_integracion*retorno[j];
+			apoyo[j]=vars[j]+k0[j]*0.075+k1[j]*0.675-k2[j]*0.6+k3[j]*0.75;
+		}
+		break;
+
+	case 4:
+		diffs(_time+inc_integracion*0.9, apoyo,retorno,NULL,n0,n1,v_pre);
 
+		for(j=j0;j<j1;++j)
+		{
+			k4[j]=inc_integracion*retorno[j];
+			apoyo[j]=vars[j]+k0[j]*0.660493827160493
+			       +k1[j]*2.5
+			       -k2[j]*5.185185185185185
+			       +k3[j]*3.888888888888889
+			       -k4[j]*0.864197530864197;
+		}
+		break;
+
+	case 5:
+		diffs(_time+inc_integracion, apoyo,retorno,NULL,n0,n1,v_pre);
+
+		for(j=j0;j<j1;++j)
+		{
+			k5[j]=inc_integracion*retorno[j];
+			other[j]=vars[j]+k0[j]*0.1049382716049382+
+			       k2[j]*0.3703703703703703+
+			       k3[j]*0.2777777777777777+
+			       k4[j]*0.2469135802469135;
+		}
+
+		for(j=j0;j<j1;++j)
+		{
+			apoyo[j]=vars[j]+k0[j]*0.098765432098765+
+			       k2[j]*0.396825396825396+
+			       k3[j]*0.231481481481481+
+			       k4[j]*0.308641975308641-
+			       k5[j]*0.035714285714285;
+		}
+		break;
+	}
+
+	if(v_pre_next)
+		for(int i=n0; i<n1; i++)
+			v_pre_next[i] = apoyo[offsets[i]];
+}
 
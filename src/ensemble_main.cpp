@@ -0,0 +1,282 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include <fstream>
+
+#include "cpg_ensemble.h"
+
+using namespace std;
+
+#define MAX_STRING 20000
+
+#define ERROR 0
+#define OK 1
+
+enum prim_types{String,Integer,Double,IntegrationMeth};//<Data types for parsing function
+
+string arg_names[]={"-connection","-file_name","-params","-integrator","-dt","-stim_dur","-stim_inc","-MIN_c","-MAX_c","-secs_dur","-rounds","-satiated_ini","-satiated_end"};//<Arguments possible names
+prim_types arg_types[]={Integer,String,String,IntegrationMeth,Double,Double,Double,Double,Double,Double,Integer,Double,Double}; //Arguments corresponding types
+
+string format = "Format: ./feeding_ensemble -connection val -file_name val -params file -integrator method -dt val [-stim_dur val -stim_inc val -MIN_c val -MAX_c val -rounds val] [-secs_dur val] [-satiated_ini val -satiated_end val]\n";//<Input format
+
+string methods[] = {"Euler","Runge-Kutta"}; //<Integrator names in String
+string headers[] = {"t SO N1M N2v N3t c", "t N1M N2v","t N1M N2v N3t","t SO N1M N2v N3t c","t SO IsynSO N1M IsynN1M N2v IsynN2v N3t IsynN3t",
+		"t SO N1M N2v N3t"};//<File headers depending on the connection.
+
+/*!
+* @brief Parse input arguments defined by its types above in arg_names and arg_types.
+*/
+int parse_input(int argc,char *argv[], void ** arguments);
+
+/*!
+* @brief Reads instances from the parameters file.
+* Each non empty line not starting with # is an instance: c_so c_n1m c_n2v c_n3t [conductances...]
+* Conductances are optional and follow the order shown by CPGEnsemble::print.
+*/
+int read_params(const char * params_file, CPGEnsemble &ens, std::vector<std::vector<double> > &c_values);
+
+int main(int argc, char * argv[])
+{
+	int connection = 3;
+	char * file_name = NULL;
+	char * params_file = NULL;
+	char file_ext[MAX_STRING];
+	char file_aux[MAX_STRING];
+	char file_spikes[MAX_STRING];
+	double secs_dur = -1;
+	int iters = -1;
+	CPGSimulator::integrators integration = CPGSimulator::EULER;
+	double dt = 0.01;
+	double stim_dur=-1,stim_inc=-1,MIN_c=-1,MAX_c=-1;
+	double satiated_ini = -1;
+	double satiated_end = -1;
+	int rounds = 4;
+
+	if(argc == 1 || (argc==2 && strcmp(argv[1],"--help")==0))
+	{
+		cout << format << endl;
+		cout << "-params: file with one instance per line: c_so c_n1m c_n2v c_n3t [synaptic conductances]" << endl;
+		cout << "-integrator: -e for Euler or -r for Runge-Kutta (the other feeding_cpg integrators are not available)" << endl;
+		cout << "One trace and one spikes file is written per instance: file_name_<instance>_..." << endl;
+		cout << "The rest of the arguments are the same as in feeding_cpg (see ./feeding_cpg --help)" << endl;
+		return -1;
+	}
+
+	void * arguments[] = {&connection,&file_name,&params_file,&integration,&dt,&stim_dur,&stim_inc,&MIN_c,&MAX_c,&secs_dur,&rounds,&satiated_ini,&satiated_end};
+	if(parse_input(argc,argv,arguments)==ERROR)
+	{
+		cerr << "Error parsing input"<< endl;
+		return -1;
+	}
+	if(!file_name || !params_file)
+	{
+		cerr << "No file name or params file specified" << endl;
+		return -1;
+	}
+
+	bool ramp = stim_dur!=-1 && stim_inc!=-1 && MIN_c!=-1 && MAX_c!=-1;
+	if(!ramp && secs_dur == -1)
+	{
+		cerr <<"Error: Ramp or secs_dur must be specified"<< endl;
+		return -1;
+	}
+
+	///////////////////////////////////////
+	//Calculating iterations
+	///////////////////////////////////////
+
+	double stim_dur_ms = stim_dur*1000; //To ms
+	if(secs_dur == -1)
+	{
+		secs_dur = ((MAX_c-MIN_c)/stim_inc)*rounds;
+		iters = secs_dur*(int)(stim_dur_ms/dt);
+	}
+	else
+		iters = (secs_dur*1000)/dt;
+
+	if(satiated_ini >0 and satiated_end >0)
+	{
+		satiated_ini= (satiated_ini*1000)/dt;
+		satiated_end= (satiated_end*1000)/dt;
+	}
+
+	RampGenerator rg(MIN_c,MAX_c,stim_inc,stim_dur_ms);
+	CPGEnsemble ens(connection,rg);
+
+	std::vector<std::vector<double> > c_values;
+	if(read_params(params_file,ens,c_values)==ERROR)
+		return -1;
+
+	ens.print();
+
+	///////////////////////////////////////
+	//Open one file pair per instance
+	///////////////////////////////////////
+
+	std::vector<FILE *> f(ens.getNInstances()), f_spks(ens.getNInstances());
+	for(int k=0; k<ens.getNInstances(); k++)
+	{
+		//A truncated name could be shared by two instances.
+		bool fits = snprintf(file_ext,MAX_STRING,"%s_%.4f_%.2f_%.2f_%.2f_%.2f",
+			methods[integration].c_str(),dt,c_values[k][0],c_values[k][1],c_values[k][2],c_values[k][3]) < MAX_STRING;
+		if(ramp)
+		{
+			fits &= snprintf(file_aux,MAX_STRING,"%s_%.2f_%.2f_%.2f_%.2f",file_ext,stim_dur,stim_inc,MIN_c,MAX_c) < MAX_STRING;
+			strcpy(file_ext,file_aux);
+		}
+
+		fits &= snprintf(file_aux,MAX_STRING,"%s_%d_%s.asc",file_name,k,file_ext) < MAX_STRING;
+		fits &= snprintf(file_spikes,MAX_STRING,"%s_%d_spikes_%s.asc",file_name,k,file_ext) < MAX_STRING;
+		if(!fits)
+		{
+			cerr << "Error: output file name too long" << endl;
+			return -1;
+		}
+
+		f[k] = fopen(file_aux,"w");
+		f_spks[k] = fopen(file_spikes,"w");
+
+		if(!f[k] || !f_spks[k])
+		{
+			cerr << "Error: error openning files"<<endl;
+			return -1;
+		}
+
+		fprintf(f[k], "%s\n",headers[connection].c_str());
+		TextSpikeSink(f_spks[k],N_NEU).write_header(headers[0].c_str(),NULL);
+	}
+
+	printf("\nInput Parameters\n\n");
+	printf("dt: %f \n",dt);
+	printf("Iterations: %d \n",iters);
+	printf("Connection %d\n",connection );
+	printf("Integration method %s\n",methods[integration].c_str() );
+	printf("Instances %d\n",ens.getNInstances());
+	cout << endl;
+
+	clock_t begin = clock();
+
+	ens.simulate(f,f_spks,iters,dt,integration,satiated_ini,satiated_end);
+
+	clock_t end = clock();
+	double time_spent = (double)(end - begin) / CLOCKS_PER_SEC;
+	printf("Execution time: %f\n",time_spent);
+	printf("\n\n\n");
+
+	for(int k=0; k<ens.getNInstances(); k++)
+	{
+		fclose(f_spks[k]);
+		fclose(f[k]);
+	}
+
+	return 0;
+}
+
+
+int read_params(const char * params_file, CPGEnsemble &ens, std::vector<std::vector<double> > &c_values)
+{
+	ifstream in(params_file);
+	if(!in)
+	{
+		cerr << "Error: error openning params file " << params_file << endl;
+		return ERROR;
+	}
+
+	string line;
+	int n_line = 0;
+	while(getline(in,line))
+	{
+		n_line++;
+		if(line.empty() || line[0]=='#')
+			continue;
+
+		istringstream ss(line);
+		std::vector<double> values;
+		double val;
+		while(ss >> val)
+			values.push_back(val);
+		if(values.empty())
+			continue;
+
+		std::vector<double> c(values.begin(),values.begin()+(values.size()<N_NEU?values.size():N_NEU));
+		std::vector<double> g;
+		if(values.size()>N_NEU)
+			g.assign(values.begin()+N_NEU,values.end());
+
+		if(ens.add_instance(c,g)==-1)
+		{
+			cerr << "Error: wrong number of values in line " << n_line << " of " << params_file << endl;
+			return ERROR;
+		}
+		c_values.push_back(c);
+	}
+
+	if(ens.getNInstances()==0)
+	{
+		cerr << "Error: no instances in " << params_file << endl;
+		return ERROR;
+	}
+
+	return OK;
+}
+
+
+int parse_input(int argc,char *argv[], void ** arguments)
+{
+	int num_args = *(&arg_names + 1) - arg_names;
+
+	for(int i=1; i<argc; i+=2)
+	{
+		int j;
+		for(j=0; j<num_args; j++)
+			if(strcmp(argv[i], arg_names[j].c_str()) == 0)
+				break;
+
+		if(j == num_args || i+1 >= argc)
+		{
+			cerr << "Incorrect argument key: " << argv[i]  << endl;
+			return ERROR;
+		}
+
+		switch(arg_types[j])
+		{
+			case Integer:
+				*(int *) arguments[j] = atoi(argv[i+1]);
+				break;
+			case String:
+				*(char **) arguments[j] = argv[i+1];
+				break;
+			case IntegrationMeth:
+				if (strcmp(argv[i+1], "-e") == 0)
+					*(int *) arguments[j] = CPGSimulator::EULER;
+				else if(strcmp(argv[i+1], "-r") == 0)
+					*(int *) arguments[j] = CPGSimulator::RUNGE;
+				else
+				{
+					cerr << "Error: integrator " << argv[i+1] << " is not supported by feeding_ensemble, use -e or -r" << endl;
+					return ERROR;
+				}
+				break;
+			case Double:
+				*(double *) arguments[j] = atof(argv[i+1]);
+				break;
+		}
+	}
+
+	return OK;
+}
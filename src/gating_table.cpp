@@ -0,0 +1,66 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+
+#include "gating_table.h"
+
+#include <math.h>
+
+
+GatingTable::GatingTable(const char * name,double (*f)(double),double step,interpolations interp)
+{
+	this->name = name;
+	exact = f;
+	vmin = GATING_VMIN;
+	inv_step = 1/step;
+	n_cells = (int)ceil((GATING_VMAX-GATING_VMIN)/step);
+	order = interp==LINEAR ? 2 : 4;
+	coefs.resize(n_cells*order);
+
+	//Derivatives for the Hermite polynomials by central differences, scaled to the cell width.
+	double e = step*1e-3;
+
+	for(int i=0; i<n_cells; i++)
+	{
+		double x0 = vmin+i*step, x1 = x0+step;
+		double y0 = f(x0), y1 = f(x1);
+		double * c = &coefs[i*order];
+
+		if(interp == LINEAR)
+		{
+			c[0] = y0;
+			c[1] = y1-y0;
+		}
+		else
+		{
+			double m0 = (f(x0+e)-f(x0-e))/(2*e)*step;
+			double m1 = (f(x1+e)-f(x1-e))/(2*e)*step;
+			c[0] = y0;
+			c[1] = m0;
+			c[2] = 3*(y1-y0)-2*m0-m1;
+			c[3] = 2*(y0-y1)+m0+m1;
+		}
+	}
+}
+
+
+double GatingTable::max_error(int samples) const
+{
+	double err = 0;
+	double step = 1/inv_step;
+
+	for(int i=0; i<n_cells*samples; i++)
+	{
+		double x = vmin+(i+0.5)*step/samples;
+		double d = fabs((*this)(x)-exact(x));
+		if(d > err)
+			err = d;
+	}
+	return err;
+}
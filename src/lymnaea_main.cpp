@@ -15,8 +15,14 @@
 #include <string>
 #include <vector>
 #include <iostream>
+#include <unistd.h>
+#include <chrono>
+#include <memory>
 
 #include "cpg_simulator.h"
+#include "burst_analysis.h"
+#include "realtime_loop.h"
+#include "result_cache.h"
 
 using namespace std;
 
@@ -27,13 +33,15 @@ using namespace std;
 
 enum prim_types{String,Integer, Float, Double, IntegrationMeth};//<Data types for parsing function
 
-string arg_names[]={"-connection","-file_name","-integrator","-dt","-c_so","-c_n1m","-c_n2v","-c_n3t","-stim_dur","-stim_inc","-MIN_c","-MAX_c","-secs_dur","-rounds","-satiated_ini","-satiated_end"};//<Arguments possible names
-prim_types arg_types[]={Integer,String,IntegrationMeth,Double,Double,Double,Double,Double,Double,Double,Double,Double,Double,Integer,Double,Double}; //Arguments corresponding types
+string arg_names[]={"-connection","-file_name","-integrator","-dt","-c_so","-c_n1m","-c_n2v","-c_n3t","-stim_dur","-stim_inc","-MIN_c","-MAX_c","-secs_dur","-rounds","-satiated_ini","-satiated_end","-rtol","-atol","-dt_max","-format","-async","-spikes_format","-gating","-gating_interp","-gating_step","-checkpoint","-checkpoint_every","-resume","-network","-threads","-stats","-stats_file","-cycles","-burst_isi","-cycle_neurons","-delta_res","-protocol","-realtime","-rt_priority","-rt_mlock","-rt_input","-shm","-shm_decimation","-cache","-cache_size","-out_interval"};//<Arguments possible names
+prim_types arg_types[]={Integer,String,IntegrationMeth,Double,Double,Double,Double,Double,Double,Double,Double,Double,Double,Integer,Double,Double,Double,Double,Double,String,Integer,String,String,String,Double,String,Double,String,String,Integer,Integer,String,Integer,Double,String,Double,String,Double,Integer,Integer,String,String,Integer,String,Double,Double}; //Arguments corresponding types
 
-string format = "Format: ./lymn -connection val -file_name val -integration_method -dt val val -c_so val -c_n1m val -c_n2v val -c_n3t val -stim_dur val -stim_inc val -MIN_c val -MAX_c val [-secs_dur val] -rounds val -satiated_ini val -satiated_end val\n";//<Input format
+string format = "Format: ./lymn -connection val -file_name val -integration_method -dt val val -c_so val -c_n1m val -c_n2v val -c_n3t val -stim_dur val -stim_inc val -MIN_c val -MAX_c val [-secs_dur val] -rounds val -satiated_ini val -satiated_end val [-rtol val -atol val -dt_max val] [-format ascii|bin|bin64|none|delta -delta_res val] [-async 0|1] [-spikes_format ascii|bin|none] [-gating exact|table -gating_interp linear|cubic -gating_step val] [-checkpoint file -checkpoint_every val] [-resume file] [-network file] [-threads n] [-stats 0|1] [-stats_file file] [-cycles 0|1 -burst_isi val -cycle_neurons names] [-protocol file] [-realtime period -rt_priority n -rt_mlock 0|1 -rt_input file] [-shm name -shm_decimation n] [-cache dir -cache_size val] [-out_interval val]\n";//<Input format
 
 
-string methods[] = {"Euler","Runge-Kutta"}; //<Integrator names in String
+string methods[] = {"Euler","Runge-Kutta","Adaptive","Rush-Larsen","Rush-Larsen-mid","Rosenbrock","Adaptive-Rosenbrock"}; //<Integrator names in String
+string format_names[] = {"ascii","bin","bin64","none","delta"}; //<Output formats names, same order as CPGSimulator::formats
+string format_ext[] = {"asc","bin","bin","","dlt"}; //<Output file extension for each format
 string headers[] = {"t SO N1M N2v N3t c", "t N1M N2v","t N1M N2v N3t","t SO N1M N2v N3t c","t SO IsynSO N1M IsynN1M N2v IsynN2v N3t IsynN3t",
 		"t SO N1M N2v N3t"};//<File headers depending on the connection. 
 
@@ -43,6 +51,11 @@ string headers[] = {"t SO N1M N2v N3t c", "t N1M N2v","t N1M N2v N3t","t SO N1M
 */
 int parse_input(int argc,char *argv[], void ** arguments);
 /*!
+* @brief Prepares a file of a resumed run to continue at offset: checks that it is at least offset bytes long, cuts it there and moves to the end.
+* @return true on success or if f is NULL (file not written)
+*/
+bool continue_file(FILE * f,long offset);
+/*!
 * Prompt help with parameters description
 */
 void show_help();
@@ -54,6 +67,19 @@ int main(int argc, char * argv[])
 	char * file_name;
 	char file_spikes[MAX_STRING];
 	char file_ext[MAX_STRING];
+	char file_trace[MAX_STRING];
+	char file_cycles[MAX_STRING];
+	char params[MAX_STRING];
+	char * format_name = NULL;
+	int out_format = CPGSimulator::ASCII;
+	char * spikes_format_name = NULL;
+	bool spikes_bin = false;
+	bool spikes_none = false;
+	char * gating_name = NULL;
+	char * gating_interp_name = NULL;
+	bool gating_table = false;
+	GatingTable::interpolations gating_interp = GatingTable::CUBIC;
+	double gating_step = GATING_STEP;
 	double secs_dur = -1;
 	int iters =-1;
 	CPGSimulator::integrators integration = CPGSimulator::EULER;
@@ -63,6 +89,42 @@ int main(int argc, char * argv[])
 	double stim_inc=-1,MIN_c=-1,MAX_c=-1;
 	double satiated_ini =  -1;
 	double satiated_end =  -1;
+	double rtol = 1e-6, atol = 1e-6, dt_max = 1.0;
+	int async_io = 0;
+	char * ckpt_name = NULL;
+	double ckpt_every = 0;
+	char * resume_name = NULL;
+	long offsets[2] = {0,0};
+	bool append = false;
+	char * network_name = NULL;
+	int n_threads = 0;
+	int show_stats = 0;
+	char * stats_name = NULL;
+	SimStats stats;
+	int cycles = 0;
+	double burst_isi = BURST_ISI;
+	char * cycle_neurons = NULL;
+	double delta_res = DELTA_RESOLUTION;
+	char * protocol_name = NULL;
+	double rt_period = 0;
+	int rt_priority = 0;
+	int rt_mlock = 0;
+	char * rt_input_name = NULL;
+	FILE * f_rt_input = NULL;
+	RealTimeLoop * realtime = NULL;
+	char * shm_name = NULL;
+	int shm_decimation = SHM_DECIMATION;
+	ShmPublisher * publisher = NULL;
+	char * cache_name = NULL;
+	double cache_size = CACHE_SIZE;
+	double out_interval = 0;
+	std::unique_ptr<ResultCache> cache; //Released on every return, including the error paths
+	string cache_key;
+	std::vector<string> cache_files;
+	FILE * f_cycles = NULL;
+	BurstAnalysis * analysis = NULL;
+	NetworkTopology net;
+	string header_net;
 
 	int rounds=4;
 
@@ -87,7 +149,7 @@ int main(int argc, char * argv[])
 	}
 	else
 	{
-		void * arguments[] = {&connection,&file_name,&integration,&dt,&c_so,&c_n1m,&c_n2v,&c_n3t,&stim_dur,&stim_inc,&MIN_c,&MAX_c,&secs_dur,&rounds,&satiated_ini,&satiated_end};
+		void * arguments[] = {&connection,&file_name,&integration,&dt,&c_so,&c_n1m,&c_n2v,&c_n3t,&stim_dur,&stim_inc,&MIN_c,&MAX_c,&secs_dur,&rounds,&satiated_ini,&satiated_end,&rtol,&atol,&dt_max,&format_name,&async_io,&spikes_format_name,&gating_name,&gating_interp_name,&gating_step,&ckpt_name,&ckpt_every,&resume_name,&network_name,&n_threads,&show_stats,&stats_name,&cycles,&burst_isi,&cycle_neurons,&delta_res,&protocol_name,&rt_period,&rt_priority,&rt_mlock,&rt_input_name,&shm_name,&shm_decimation,&cache_name,&cache_size,&out_interval};
 		if(parse_input(argc,argv,arguments)==ERROR)
 		{
 			cerr << "Error parsing input"<< endl;
@@ -99,6 +161,72 @@ int main(int argc, char * argv[])
 			return -1;
 
 		}
+		if(format_name)
+		{
+			for(out_format=0; out_format<CPGSimulator::n_formats; out_format++)
+				if(format_names[out_format] == format_name)
+					break;
+			if(out_format == CPGSimulator::n_formats)
+			{
+				cerr << "Unknown format " << format_name << endl;
+				return -1;
+			}
+		}
+		if(rt_period > 0 && out_format != CPGSimulator::ASCII && out_format != CPGSimulator::NONE)
+		{
+			cerr << "Error: the real-time mode writes ascii traces, use -format ascii or none" << endl;
+			return -1;
+		}
+		if(rt_period > 0 && out_interval > 0)
+		{
+			cerr << "Error: the real-time mode writes a record each 4 steps, -out_interval is not available" << endl;
+			return -1;
+		}
+		if(spikes_format_name)
+		{
+			spikes_bin = strcmp(spikes_format_name,"bin")==0;
+			spikes_none = strcmp(spikes_format_name,"none")==0;
+			if(!spikes_bin && !spikes_none && strcmp(spikes_format_name,"ascii")!=0)
+			{
+				cerr << "Unknown spikes format " << spikes_format_name << endl;
+				return -1;
+			}
+		}
+		if(gating_name)
+		{
+			gating_table = strcmp(gating_name,"table")==0;
+			if(!gating_table && strcmp(gating_name,"exact")!=0)
+			{
+				cerr << "Unknown gating mode " << gating_name << endl;
+				return -1;
+			}
+		}
+		if(gating_interp_name)
+		{
+			if(strcmp(gating_interp_name,"linear")==0)
+				gating_interp = GatingTable::LINEAR;
+			else if(strcmp(gating_interp_name,"cubic")!=0)
+			{
+				cerr << "Unknown gating interpolation " << gating_interp_name << endl;
+				return -1;
+			}
+		}
+		if(gating_step <= 0)
+		{
+			cerr << "Error: gating_step must be positive" << endl;
+			return -1;
+		}
+		if(network_name)
+		{
+			if(net.load(network_name)==0)
+				return -1;
+			if(net.getNNeurons()==0)
+			{
+				cerr << "Error: no neurons in " << network_name << endl;
+				return -1;
+			}
+			connection = -1;
+		}
 	}
 
 	
@@ -107,15 +235,31 @@ int main(int argc, char * argv[])
 	//   Open file
 	////////////////////////////////////////////////////////
 
-	//Add Iinj values
-	sprintf(file_ext,"%s_%.4f_%.2f_%.2f_%.2f_%.2f",
-		methods[integration].c_str(),dt,c_so,c_n1m,c_n2v,c_n3t);
+	//Add Iinj values (the network file name when currents come from it)
+	if(network_name)
+	{
+		const char * base = strrchr(network_name,'/');
+		if(snprintf(file_ext,sizeof(file_ext),"%s_%.4f_%s",methods[integration].c_str(),dt,base ? base+1 : network_name) >= (int)sizeof(file_ext))
+		{
+			cerr << "Error: network file name too long" << endl;
+			return -1;
+		}
+	}
+	else
+		sprintf(file_ext,"%s_%.4f_%.2f_%.2f_%.2f_%.2f",
+			methods[integration].c_str(),dt,c_so,c_n1m,c_n2v,c_n3t);
 
 	//Add ramp values (if used)
 	if(stim_dur!=-1 && stim_inc!=-1 && MIN_c!=-1 &&MAX_c!=-1)
 	{
-		sprintf(file_ext,"%s_%.2f_%.2f_%.2f_%.2f",file_ext,
-		stim_dur,stim_inc,MIN_c,MAX_c);
+		char ramp_ext[MAX_STRING];
+		if(snprintf(ramp_ext,sizeof(ramp_ext),"%s_%.2f_%.2f_%.2f_%.2f",file_ext,
+		stim_dur,stim_inc,MIN_c,MAX_c) >= (int)sizeof(ramp_ext))
+		{
+			cerr << "Error: output file name too long" << endl;
+			return -1;
+		}
+		strcpy(file_ext,ramp_ext);
 	}
 	else if(secs_dur == -1)
 	{
@@ -126,18 +270,96 @@ int main(int argc, char * argv[])
 		cout << "\nWarning: Ramp will be ignored\n"<< endl;
 
 	//Join file name with parameters extension in spikes and basis file. 
-	sprintf(file_spikes,"%s_spikes_%s.asc",file_name,file_ext);
-	sprintf(file_name,"%s_%s.asc",file_name,file_ext);
+	bool fits = snprintf(file_spikes,sizeof(file_spikes),"%s_spikes_%s.%s",file_name,file_ext,spikes_bin?"bin":"asc") < (int)sizeof(file_spikes);
+	fits &= snprintf(file_trace,sizeof(file_trace),"%s_%s.%s",file_name,file_ext,format_ext[out_format].c_str()) < (int)sizeof(file_trace);
+	fits &= snprintf(file_cycles,sizeof(file_cycles),"%s_cycles_%s.asc",file_name,file_ext) < (int)sizeof(file_cycles);
+	if(!fits)
+	{
+		cerr << "Error: output file name too long" << endl;
+		return -1;
+	}
+	file_name = file_trace;
+
+
+	//Input parameters recorded in binary headers
+	snprintf(params,MAX_STRING,"connection %d\nintegrator %s\nc_so %g\nc_n1m %g\nc_n2v %g\nc_n3t %g\nstim_dur %g\nstim_inc %g\nMIN_c %g\nMAX_c %g\nsecs_dur %g\nrounds %d\nsatiated_ini %g\nsatiated_end %g\n",
+		connection,methods[integration].c_str(),c_so,c_n1m,c_n2v,c_n3t,stim_dur,stim_inc,MIN_c,MAX_c,secs_dur,rounds,satiated_ini,satiated_end);
+	if(network_name)
+		snprintf(params+strlen(params),MAX_STRING-strlen(params),"network %s\n",network_name);
+	if(protocol_name)
+		snprintf(params+strlen(params),MAX_STRING-strlen(params),"protocol %s\n",protocol_name);
+	if(out_interval > 0)
+		snprintf(params+strlen(params),MAX_STRING-strlen(params),"out_interval %g\n",out_interval);
 
 
-	//Open streams.
-	f = fopen(file_name,"w");
-	f_spks = fopen(file_spikes,"w");
+	///////////////////////////////////////
+	//Results cache
+	///////////////////////////////////////
 
-	if(!f|!f_spks)
+	//The key has every input that changes the output files, doubles with all their digits and the contents of the input files.
+	if(cache_name && (resume_name || ckpt_name || rt_period > 0 || shm_name))
+		cout << "Warning: the cache is not used with -resume, -checkpoint, -realtime or -shm" << endl;
+	else if(cache_name)
 	{
-		cerr << "Error: error openning files"<<endl;
-		return -1;
+		char key[MAX_STRING];
+		snprintf(key,MAX_STRING,"model %s\nconnection %d\nintegrator %s\ndt %.17g\nc %.17g %.17g %.17g %.17g\nramp %.17g %.17g %.17g %.17g\nsecs_dur %.17g\nrounds %d\nsatiated %.17g %.17g\nformat %s\nspikes_format %s\nthreads %d\n",
+			CACHE_MODEL_VERSION,connection,methods[integration].c_str(),dt,c_so,c_n1m,c_n2v,c_n3t,stim_dur,stim_inc,MIN_c,MAX_c,secs_dur,rounds,satiated_ini,satiated_end,
+			format_names[out_format].c_str(),spikes_none ? "none" : spikes_bin ? "bin" : "ascii",n_threads);
+		cache_key = key;
+		if(integration == CPGSimulator::ADAPTIVE || integration == CPGSimulator::ADAPTIVE_ROSENBROCK)
+		{
+			snprintf(key,MAX_STRING,"tolerances %.17g %.17g %.17g\n",rtol,atol,dt_max);
+			cache_key += key;
+		}
+		if(out_format == CPGSimulator::DELTA)
+		{
+			snprintf(key,MAX_STRING,"delta_res %.17g\n",delta_res);
+			cache_key += key;
+		}
+		if(gating_table)
+		{
+			snprintf(key,MAX_STRING,"gating %s %.17g\n",gating_interp==GatingTable::LINEAR?"linear":"cubic",gating_step);
+			cache_key += key;
+		}
+		if(cycles)
+		{
+			snprintf(key,MAX_STRING,"cycles %.17g %s\n",burst_isi,cycle_neurons ? cycle_neurons : "feeding");
+			cache_key += key;
+		}
+		if(out_interval > 0)
+		{
+			snprintf(key,MAX_STRING,"out_interval %.17g\n",out_interval);
+			cache_key += key;
+		}
+		//The file names are in the headers too.
+		if(network_name)
+		{
+			cache_key += string("network ")+network_name+"\n";
+			if(ResultCache::add_file(cache_key,"network_file",network_name)==0)
+				return -1;
+		}
+		if(protocol_name)
+		{
+			cache_key += string("protocol ")+protocol_name+"\n";
+			if(ResultCache::add_file(cache_key,"protocol_file",protocol_name)==0)
+				return -1;
+		}
+
+		if(out_format != CPGSimulator::NONE)
+			cache_files.push_back(file_trace);
+		if(!spikes_none)
+			cache_files.push_back(file_spikes);
+		if(cycles)
+			cache_files.push_back(file_cycles);
+
+		cache.reset(new ResultCache(cache_name,cache_size));
+		if(cache->fetch(cache_key,cache_files))
+		{
+			printf("Results of an identical run copied from the cache entry %s\n",cache->getEntry(cache_key).c_str());
+			for(unsigned int i=0; i<cache_files.size(); i++)
+				printf("File: %s\n",cache_files[i].c_str());
+			return 0;
+		}
 	}
 
 
@@ -172,19 +394,137 @@ int main(int argc, char * argv[])
 
 	RampGenerator rg(MIN_c,MAX_c,stim_inc,stim_dur);
 
-	//Write File header 
-	header = headers[connection].c_str();
+	std::vector<double> c_values({c_so,c_n1m,c_n2v,c_n3t});
 
-	fprintf(f, "%s\n",header );
-	fprintf(f_spks,"%f\n",SPIKE_TH);
-	fprintf(f_spks, "%s\n",headers[0].c_str() );
+	CPGSimulator cpg;//< CPGSimulator object
+	if(network_name)
+		cpg = CPGSimulator(net,net.currents,rg);
+	else
+		cpg = CPGSimulator(connection,c_values,rg);
+	if(protocol_name && cpg.load_protocol(protocol_name)==0)
+		return -1;
+	cpg.set_tolerances(rtol,atol,dt_max);
+	if(n_threads > 0)
+		cpg.set_threads(n_threads);
+	cpg.set_format((CPGSimulator::formats)out_format,delta_res);
+	cpg.set_output_interval(out_interval);
+	if(ckpt_name)
+		cpg.set_checkpoint(ckpt_name,ckpt_every*1000);
+
+	if(resume_name)
+	{
+		if(cpg.load_checkpoint(resume_name,integration,dt,offsets)==0)
+			return -1;
+		printf("Resuming from %s at t=%f ms\n",resume_name,cpg.getTime());
+	}
 
+	//Open streams. When resuming a run with the same output files, they are cut at the checkpoint and continued.
+	//Files of the none formats are not opened.
+	bool trace_none = out_format == CPGSimulator::NONE;
+	if(resume_name)
+	{
+		f = trace_none ? NULL : fopen(file_name,"r+");
+		f_spks = spikes_none ? NULL : fopen(file_spikes,"r+");
+		append = (f || trace_none) && (f_spks || spikes_none);
+		if(append)
+			append = continue_file(f,offsets[0]) && continue_file(f_spks,offsets[1]);
+		if(!append)
+		{
+			if(f) fclose(f);
+			if(f_spks) fclose(f_spks);
+		}
+		else if(!trace_none || !spikes_none)
+			printf("Continuing %s and %s\n",file_name,file_spikes);
+	}
+	if(!append)
+	{
+		f = trace_none ? NULL : fopen(file_name,"w");
+		f_spks = spikes_none ? NULL : fopen(file_spikes,"w");
+	}
+	if(cycles)
+		f_cycles = fopen(file_cycles,"w");
 
-	std::vector<double> c_values({c_so,c_n1m,c_n2v,c_n3t});
+	if((!f && !trace_none) || (!f_spks && !spikes_none) || (!f_cycles && cycles))
+	{
+		cerr << "Error: error openning files"<<endl;
+		return -1;
+	}
+
+	AsyncWriter * writer = NULL;
+	if(async_io)
+	{
+		writer = new AsyncWriter();
+		cpg.set_writer(writer);
+	}
+
+	SpikeSink * spike_sink;
+	if(spikes_none)
+		spike_sink = new NullSpikeSink();
+	else if(spikes_bin)
+		spike_sink = new BinSpikeSink(f_spks,cpg.getNNeurons(),writer);
+	else
+		spike_sink = new TextSpikeSink(f_spks,cpg.getNNeurons(),writer);
+	cpg.set_spike_sink(spike_sink);
+
+	//The cycles analysis receives the spike events and passes them on to the spikes file.
+	if(cycles)
+	{
+		std::vector<int> seq = cycle_neurons ? BurstAnalysis::parse_sequence(cycle_neurons,cpg.getNames()) : BurstAnalysis::feeding_sequence(cpg.getTypes());
+		if(seq.empty())
+		{
+			cerr << "Error: no neurons for the cycles analysis" << endl;
+			return -1;
+		}
+		analysis = new BurstAnalysis(seq,cpg.getNames(),burst_isi,f_cycles,spikes_none ? NULL : spike_sink);
+		cpg.set_spike_sink(analysis);
+	}
+	if(show_stats || stats_name)
+		cpg.set_stats(&stats);
+
+	//Write File header. The real-time records have the voltage of every neuron, as in custom networks.
+	if(network_name || rt_period > 0)
+	{
+		header_net = "t";
+		for(int i=0; i<cpg.getNNeurons(); i++)
+			header_net += " " + cpg.getNames()[i];
+		header_net += " c";
+		header = header_net.c_str();
+	}
+	else
+		header = headers[connection].c_str();
+
+	//Live stream of the simulation, the spike events go through it to the spikes file and the cycles analysis.
+	if(shm_name)
+	{
+		string columns = "t";
+		for(int i=0; i<cpg.getNNeurons(); i++)
+			columns += " " + cpg.getNames()[i];
+		columns += " c";
+		publisher = new ShmPublisher(analysis ? (SpikeSink*)analysis : spike_sink);
+		if(publisher->open(shm_name,columns.c_str(),out_interval > 0 ? out_interval : dt,out_interval > 0 ? 1 : OUT_DECIMATION,shm_decimation)==0)
+			return -1;
+		cpg.set_publisher(publisher);
+		cpg.set_spike_sink(publisher);
+		printf("Publishing in shared memory %s\n",shm_name);
+	}
+
+	snprintf(params+strlen(params),MAX_STRING-strlen(params),"iterations %d\n",iters);
+	if(gating_table)
+		snprintf(params+strlen(params),MAX_STRING-strlen(params),"gating table\ngating_interp %s\ngating_step %g\n",
+			gating_interp==GatingTable::LINEAR?"linear":"cubic",gating_step);
+	if(!append)
+	{
+		cpg.write_header(f,header,dt,params);
+		spike_sink->write_header(network_name ? header : headers[0].c_str(),params);
+	}
+	if(analysis)
+		analysis->write_header(NULL,params);
 
-	CPGSimulator cpg(connection,c_values,rg);//< CPGSimulator object
 
-	cpg.print(); //Prints neurons and synapses generated. 
+	if(network_name)
+		printf("Network %s: %d neurons, %d synapses\n",network_name,net.getNNeurons(),net.getNSynapses());
+	else
+		cpg.print(); //Prints neurons and synapses generated. 
 
 	///////////////////////////////////////
 	//Print parameters used. 
@@ -207,28 +547,87 @@ int main(int argc, char * argv[])
 	printf("stim_dur=%.2f",stim_dur);
 	printf(" stim_inc=%.2f",stim_inc);
 	printf("\nsatiated_ini=%.2f satiated_end=%.2f\n",satiated_ini,satiated_end );
+	if(integration == CPGSimulator::ADAPTIVE || integration == CPGSimulator::ADAPTIVE_ROSENBROCK)
+		printf("rtol=%g atol=%g dt_max=%g\n",rtol,atol,dt_max);
+	if(n_threads > 0)
+		printf("Parallel stepping with %d threads\n",n_threads);
+	if(gating_table)
+	{
+		const char * worst = "";
+		double err = CPGSimulator::use_gating_tables(gating_interp,gating_step,&worst);
+		printf("Gating tables: %s interpolation, step %g mV, max error %g (%s)\n",
+			gating_interp==GatingTable::LINEAR?"linear":"cubic",gating_step,err,worst);
+	}
 	cout << endl;
 
 
 	//Starting clock
 	clock_t begin = clock();
+	chrono::steady_clock::time_point wall_begin = chrono::steady_clock::now();
 
 	//Start simulation
 
-	cpg.simulate(f,f_spks,iters,dt,integration,satiated_ini,satiated_end);
+	if(rt_period > 0)
+	{
+		if(rt_input_name)
+			f_rt_input = strcmp(rt_input_name,"-")==0 ? stdin : fopen(rt_input_name,"r");
+		if(rt_input_name && !f_rt_input)
+		{
+			cerr << "Error: error openning " << rt_input_name << endl;
+			return -1;
+		}
+		//Satiated window as in simulate, in ms.
+		if(satiated_ini >= 0 || satiated_end >= 0)
+			cpg.getProtocol().satiated(satiated_ini >= 0 ? satiated_ini*dt-dt/2 : INFINITY,satiated_end >= 0 ? satiated_end*dt-dt/2 : INFINITY);
+
+		printf("Real-time mode: %g ms per tick\n",rt_period);
+		realtime = new RealTimeLoop(&cpg,rt_period,rt_priority,rt_mlock);
+		realtime->set_publisher(publisher);
+		if(realtime->run(f,publisher ? (SpikeSink*)publisher : analysis ? (SpikeSink*)analysis : spike_sink,f_rt_input,llround(iters*dt/rt_period),dt,integration)==0)
+		{
+			//Readers attached would wait for the end of the run.
+			delete publisher;
+			return -1;
+		}
+	}
+	else
+		cpg.simulate(f,f_spks,iters,dt,integration,satiated_ini,satiated_end);
 	
 	//Finishing clock
 
 	clock_t end = clock();
 	double time_spent = (double)(end - begin) / CLOCKS_PER_SEC;
 	printf("Execution time: %f\n",time_spent);
+	printf("Wall time: %f\n",chrono::duration<double>(chrono::steady_clock::now()-wall_begin).count());
+	if(analysis)
+	{
+		analysis->finish();
+		printf("Cycles: %ld written to %s\n",analysis->getNCycles(),file_cycles);
+	}
+	if(show_stats)
+		stats.print(stdout);
+	if(realtime)
+		realtime->print(stdout);
+	if(stats_name && stats.write_json(stats_name))
+		printf("Stats written to %s\n",stats_name);
 
 	printf("\n\n\n");
 
+	//simulate already flushed the writer, stop its thread before closing files.
+	delete writer;
+	delete realtime;
+	delete publisher;
+	delete analysis;
+	delete spike_sink;
+
 	//Closing files.
-	fclose(f_spks);
-	fclose(f);
+	if(f_rt_input && f_rt_input != stdin) fclose(f_rt_input);
+	if(f_cycles) fclose(f_cycles);
+	if(f_spks) fclose(f_spks);
+	if(f) fclose(f);
 
+	if(cache && cache->store(cache_key,cache_files))
+		printf("Results added to the cache entry %s\n",cache->getEntry(cache_key).c_str());
 
 	return 0;
 
@@ -278,6 +677,16 @@ int parse_input(int argc,char *argv[], void ** arguments)
 						}
 						else if(strcmp(argv[i+1], "-r") == 0)
 							*aux_i = 1;
+						else if(strcmp(argv[i+1], "-a") == 0)
+							*aux_i = 2;
+						else if(strcmp(argv[i+1], "-x") == 0)
+							*aux_i = 3;
+						else if(strcmp(argv[i+1], "-xm") == 0)
+							*aux_i = 4;
+						else if(strcmp(argv[i+1], "-s") == 0)
+							*aux_i = 5;
+						else if(strcmp(argv[i+1], "-as") == 0)
+							*aux_i = 6;
 
 						break;
 	
@@ -311,6 +720,17 @@ int parse_input(int argc,char *argv[], void ** arguments)
 
 }
 
+bool continue_file(FILE * f,long offset)
+{
+	if(!f)
+		return true;
+	fseek(f,0,SEEK_END);
+	if(ftell(f) < offset || ftruncate(fileno(f),offset) != 0)
+		return false;
+	fseek(f,0,SEEK_END);
+	return true;
+}
+
 void show_help()
 {
 
@@ -327,6 +747,74 @@ void show_help()
 	cout << "-integration_method:"<<endl;
 	cout << "-e for Euler"<<endl;
 	cout << "-r for Runge-Kutta"<<endl;
+	cout << "-a for adaptive step Runge-Kutta, dt is the initial step"<<endl;
+	cout << "\t rtol/atol: relative and absolute tolerances (default 1e-6)"<<endl;
+	cout << "\t dt_max: maximum time step in ms (default 1)"<<endl;
+	cout << "-x for Rush-Larsen: gating and synaptic variables integrated exponentially, voltages with Euler. Stable with larger dt (e.g. 0.01)"<<endl;
+	cout << "-xm for second order Rush-Larsen (midpoint)"<<endl;
+	cout << "-s for Rosenbrock (linearly implicit, 4th order)"<<endl;
+	cout << "-as for adaptive step Rosenbrock, same options as -a. Keeps the bursting pattern with loose tolerances (e.g. 1e-2)"<<endl;
+	cout << endl;
+	cout << "-format: trace file format (see -spikes_format for the spikes file)"<<endl;
+	cout << "\t ascii (default): space separated values, .asc file"<<endl;
+	cout << "\t bin: text header followed by records of float64 time and float32 values, .bin file (see utils/read_bin.py)"<<endl;
+	cout << "\t bin64: same as bin with float64 values"<<endl;
+	cout << "\t none: no trace file"<<endl;
+	cout << "\t delta: compressed blocks of the second differences of the values quantized to delta_res, .dlt file (see trace_decode and utils/read_bin.py)"<<endl;
+	cout << "\t delta_res: quantization step of the delta format in mV and nA (default 1e-6, the ascii precision), 0 to keep the values bit-exact. Time is always bit-exact"<<endl;
+	cout << endl;
+	cout << "-spikes_format: spikes file format. Each spike time is interpolated between steps at the peak of V"<<endl;
+	cout << "\t ascii (default): one line per spike with the peak V in the column of the neuron, .asc file"<<endl;
+	cout << "\t bin: text header followed by records of float64 time, float32 V and int32 neuron, .bin file (see utils/read_bin.py)"<<endl;
+	cout << "\t none: no spikes file"<<endl;
+	cout << endl;
+	cout << "-gating: how steady-state and time constant functions are computed"<<endl;
+	cout << "\t exact (default): evaluated each time"<<endl;
+	cout << "\t table: voltage lookup tables built at start, the maximum error of the tables is reported"<<endl;
+	cout << "\t gating_interp: linear or cubic (default) interpolation in the tables"<<endl;
+	cout << "\t gating_step: table step in mV (default 0.1)"<<endl;
+	cout << endl;
+	cout << "-async: 1 to write trace and spikes files from a separate I/O thread, so the simulation does not wait on disk (default 0)"<<endl;
+	cout << endl;
+	cout << "-checkpoint: file where the complete simulation state is saved at the end of the simulation"<<endl;
+	cout << "\t checkpoint_every: also save it every checkpoint_every seconds of simulated time"<<endl;
+	cout << "-resume: continue from a checkpoint file, same connection (or network), integrator and dt required"<<endl;
+	cout << "\t if the output files of the run exist they are cut at the checkpoint and continued, so the result is the same as without interruption"<<endl;
+	cout << "\t otherwise (e.g. other currents) new files are started from the checkpoint time"<<endl;
+	cout << "\t secs_dur and the satiated instants are counted from the beginning of the original run"<<endl;
+	cout << "-network: simulate the network described in file instead of the feeding CPG (connection and c_* values are ignored)"<<endl;
+	cout << "\t one line per neuron \"neuron name type [current]\" (type SO, N1M, N2v or N3t, current -1 or ramp for the ramp stimulation)"<<endl;
+	cout << "\t and per synapse \"synapse pre post g tau E\" (tau fast/slow or ms, E excit/inhib or mV). The output has the voltage of each neuron and the current value"<<endl;
+	cout << "-threads: step the network in parallel blocks of neurons with n threads (0, default, steps it in a single thread)"<<endl;
+	cout << "\t used by -e, -x and -r. -x and -r give the same result as without threads, -e uses the voltages at the start of each step for every synapse"<<endl;
+	cout << "\t (instead of the in-place update), the result is the same with any number of threads"<<endl;
+	cout << "-stats: 1 to print at the end the time spent in integration, spike detection, output, stimulation protocol and checkpoints,"<<endl;
+	cout << "\t wall-clock and CPU time, steps, evaluations of the equations, exp calls, spikes and bytes written"<<endl;
+	cout << "-stats_file: write the same report as JSON to file"<<endl;
+	cout << "-cycles: 1 to analyse the bursts during the simulation and write one line per cycle to file_name_cycles_... .asc"<<endl;
+	cout << "\t with the period, duration and spikes of each burst and the intervals and delays between consecutive neurons"<<endl;
+	cout << "\t burst_isi: maximum interval between spikes of the same burst in ms (default 500)"<<endl;
+	cout << "\t cycle_neurons: comma separated names of the sequence, the first one defines the cycle (default the first N1M, N2v and N3t)"<<endl;
+	cout << "\t use -format none -spikes_format none to write only the cycles"<<endl;
+	cout << "-realtime: period in ms, runs the simulation against the wall clock for closed-loop experiments (0, default, runs it as fast as possible)"<<endl;
+	cout << "\t every period the control thread wakes up at an absolute deadline, applies the inputs and advances period ms of simulation (a multiple of dt)"<<endl;
+	cout << "\t trace (ascii, \"t V... c\" with every neuron) and spikes are written by a separate thread, records are dropped instead of waiting if it falls behind"<<endl;
+	cout << "\t wake-up jitter, compute time and deadline misses are reported at the end. Fixed step integrators, checkpoints and -stats are not used"<<endl;
+	cout << "\t rt_priority: SCHED_FIFO priority 1-99 of the control thread (default 0, normal scheduler). rt_mlock: 1 to lock the memory (mlockall)"<<endl;
+	cout << "\t rt_input: file or named pipe (- for stdin) with lines \"t neuron value\": from t ms the current of the neuron is value, nan returns it to the protocol"<<endl;
+	cout << "-shm: publish the simulation live in the POSIX shared memory segment name (e.g. /cpg_live), removed at the end"<<endl;
+	cout << "\t records \"t V... c\" with every neuron and spike events in rings that are overwritten in circles, the simulation never waits for readers"<<endl;
+	cout << "\t shm_decimation: trace records per published record (default 10). Read it with ./shm_monitor name or utils/shm_reader.py"<<endl;
+	cout << "-out_interval: time between trace records in ms, interpolated within the integration steps, e.g. 0.1 gives the same records with any dt"<<endl;
+	cout << "\t or integrator (default 0: one record each 4 steps). Not available with -realtime"<<endl;
+	cout << "-cache: directory of the results cache. An identical run (same inputs and model version) copies its files from the cache instead of simulating,"<<endl;
+	cout << "\t otherwise the files are added to it. Not used with -resume, -checkpoint, -realtime or -shm. It can be shared by several processes"<<endl;
+	cout << "\t cache_size: size limit of the cache in MB (default 1024), the least recently used results are removed"<<endl;
+	cout << "-protocol: stimulation protocol file applied on top of the c_* values and the ramp, one item per line (times in ms, t1 optional, no end by default)"<<endl;
+	cout << "\t step neuron value t0 [t1]: constant current"<<endl;
+	cout << "\t ramp neuron min max inc dur t0 [t1]: up and down ramp as the -1 values"<<endl;
+	cout << "\t pulses neuron amplitude width period t0 [t1]: pulse train added to the current"<<endl;
+	cout << "\t satiated t0 [t1]: satiated window, -satiated_ini/-satiated_end replace it when given"<<endl;
 	cout << endl;
 	cout << "-c_so/c_n1m/c_n2v/c_n3t: current values applied to each neuron respectivelly"<< endl;
 	cout << "default values: 10 6 4 0"<<endl;
@@ -0,0 +1,279 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+
+#include "network_topology.h"
+#include "vavoulis_synapse.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <fstream>
+#include <sstream>
+using namespace std;
+
+
+NetworkTopology::NetworkTopology()
+{
+	row_ptr.assign(1,0);
+}
+
+
+int NetworkTopology::add_neuron(const std::string &name,VavoulisModel::types type,double current)
+{
+	if(index.count(name))
+		return -1;
+
+	int id = names.size();
+	index[name] = id;
+	names.push_back(name);
+	types.push_back(type);
+	currents.push_back(current);
+	row_ptr.push_back(row_ptr.back()); //No synapses until the next build
+	return id;
+}
+
+
+void NetworkTopology::add_synapse(int pre,int post,double g,double tau,double E)
+{
+	PendingSynapse syn = {pre,post,g,tau,E};
+	pending.push_back(syn);
+}
+
+
+void NetworkTopology::build()
+{
+	int n = names.size();
+	int n_old = this->pre.size();
+
+	//Counting sort by post-synaptic neuron: old synapses of each row first, then the pending ones in order.
+	vector<int> ptr(n+1,0);
+	for(int i=0; i<n; i++)
+		ptr[i+1] = row_ptr[i+1]-row_ptr[i];
+	for(int k=0; k<(int)pending.size(); k++)
+		ptr[pending[k].post+1]++;
+	for(int i=0; i<n; i++)
+		ptr[i+1] += ptr[i];
+
+	int n_syn = n_old+pending.size();
+	vector<int> new_pre(n_syn);
+	vector<double> new_g(n_syn), new_tau(n_syn), new_E(n_syn);
+	vector<int> next(ptr.begin(),ptr.end()-1);
+
+	for(int i=0; i<n; i++)
+		for(int k=row_ptr[i]; k<row_ptr[i+1]; k++)
+		{
+			int dst = next[i]++;
+			new_pre[dst] = this->pre[k];
+			new_g[dst] = this->g[k];
+			new_tau[dst] = this->tau[k];
+			new_E[dst] = this->E[k];
+		}
+	for(int k=0; k<(int)pending.size(); k++)
+	{
+		int dst = next[pending[k].post]++;
+		new_pre[dst] = pending[k].pre;
+		new_g[dst] = pending[k].g;
+		new_tau[dst] = pending[k].tau;
+		new_E[dst] = pending[k].E;
+	}
+
+	row_ptr.swap(ptr);
+	this->pre.swap(new_pre);
+	this->g.swap(new_g);
+	this->tau.swap(new_tau);
+	this->E.swap(new_E);
+	pending.clear();
+}
+
+
+int NetworkTopology::find(const std::string &name) const
+{
+	map<string,int>::const_iterator it = index.find(name);
+	return it == index.end() ? -1 : it->second;
+}
+
+
+int NetworkTopology::find_type(VavoulisModel::types type) const
+{
+	for(int i=0; i<(int)types.size(); i++)
+		if(types[i] == type)
+			return i;
+	return -1;
+}
+
+
+/*!
+* @brief Adds size bytes of data to a FNV-1a hash.
+*/
+static void hash_bytes(uint64_t &h,const void * data,size_t size)
+{
+	const unsigned char * p = (const unsigned char *)data;
+	for(size_t i=0; i<size; i++)
+	{
+		h ^= p[i];
+		h *= 1099511628211ULL;
+	}
+}
+
+
+uint64_t NetworkTopology::hash() const
+{
+	uint64_t h = 14695981039346656037ULL;
+	int32_t n[2] = {getNNeurons(),getNSynapses()};
+	hash_bytes(h,n,sizeof(n));
+	for(int i=0; i<n[0]; i++)
+	{
+		int32_t t = types[i];
+		hash_bytes(h,&t,sizeof(t));
+	}
+	hash_bytes(h,row_ptr.data(),row_ptr.size()*sizeof(int));
+	hash_bytes(h,pre.data(),pre.size()*sizeof(int));
+	hash_bytes(h,g.data(),g.size()*sizeof(double));
+	hash_bytes(h,tau.data(),tau.size()*sizeof(double));
+	hash_bytes(h,E.data(),E.size()*sizeof(double));
+	return h;
+}
+
+
+int NetworkTopology::parse_type(const std::string &name,VavoulisModel::types &type)
+{
+	const char * type_names[VavoulisModel::n_types] = {"SO","N1M","N2v","N3t"};
+
+	for(int i=0; i<VavoulisModel::n_types; i++)
+		if(strcasecmp(name.c_str(),type_names[i]) == 0)
+		{
+			type = (VavoulisModel::types)i;
+			return 1;
+		}
+	return 0;
+}
+
+
+/*!
+* @brief Reads a number or one of two keywords.
+* @param s Text
+* @param key_a First keyword, NULL for numbers only
+* @param val_a Value of key_a
+* @param key_b Second keyword
+* @param val_b Value of key_b
+* @param val Set to the value
+* @return 1 on success, 0 otherwise
+*/
+static int parse_value(const string &s,const char * key_a,double val_a,const char * key_b,double val_b,double &val)
+{
+	if(key_a && strcasecmp(s.c_str(),key_a) == 0)
+		val = val_a;
+	else if(key_b && strcasecmp(s.c_str(),key_b) == 0)
+		val = val_b;
+	else
+	{
+		char * end;
+		val = strtod(s.c_str(),&end);
+		if(s.empty() || *end != '\0')
+			return 0;
+	}
+	return 1;
+}
+
+
+int NetworkTopology::load(const char * file)
+{
+	ifstream in(file);
+	if(!in)
+	{
+		fprintf(stderr,"Error: can not open network file %s\n",file);
+		return 0;
+	}
+
+	string line;
+	int n_line = 0;
+	while(getline(in,line))
+	{
+		n_line++;
+		size_t comment = line.find('#');
+		if(comment != string::npos)
+			line.erase(comment);
+
+		stringstream ss(line);
+		string kind;
+		if(!(ss >> kind))
+			continue;
+
+		bool ok = false;
+		if(kind == "neuron")
+		{
+			string name, type_name, extra;
+			VavoulisModel::types type;
+			double current = 0;
+			if(ss >> name >> type_name && parse_type(type_name,type) && (!(ss >> extra) || parse_value(extra,"ramp",-1,NULL,0,current)))
+			{
+				ok = add_neuron(name,type,current) >= 0;
+				if(!ok)
+					fprintf(stderr,"Error: %s:%d: repeated neuron %s\n",file,n_line,name.c_str());
+			}
+		}
+		else if(kind == "synapse")
+		{
+			string pre_name, post_name, s_g, s_tau, s_E;
+			double g, tau, E;
+			if(ss >> pre_name >> post_name >> s_g >> s_tau >> s_E)
+			{
+				int pre_id = find(pre_name), post_id = find(post_name);
+				ok = pre_id >= 0 && post_id >= 0 && parse_value(s_g,NULL,0,NULL,0,g) && parse_value(s_tau,"fast",FAST,"slow",SLOW,tau) && parse_value(s_E,"excit",EXCIT,"inhib",INHIB,E);
+				if(ok)
+					add_synapse(pre_id,post_id,g,tau,E);
+			}
+		}
+
+		string rest;
+		if(ok && ss >> rest)
+			ok = false;
+		if(!ok)
+		{
+			fprintf(stderr,"Error: %s:%d: invalid line \"%s\"\n",file,n_line,line.c_str());
+			return 0;
+		}
+	}
+
+	build();
+	return 1;
+}
+
+
+NetworkTopology NetworkTopology::feeding(int connection)
+{
+	NetworkTopology net;
+	net.add_neuron("SO",VavoulisModel::SO,0);
+	net.add_neuron("N1M",VavoulisModel::N1M,0);
+	net.add_neuron("N2v",VavoulisModel::N2v,0);
+	net.add_neuron("N3t",VavoulisModel::N3t,0);
+
+	//The synaptic current is accumulated in the order the synapses are added, so it is kept as in the original circuit.
+	if(connection >= 3) //All neurons connected
+	{
+		net.add_synapse(VavoulisModel::SO,VavoulisModel::N1M,4.0,SLOW,EXCIT);
+		net.add_synapse(VavoulisModel::SO,VavoulisModel::N2v,1.0,SLOW,EXCIT);
+		net.add_synapse(VavoulisModel::N2v,VavoulisModel::SO,8.0,FAST,INHIB);
+	}
+	if(connection >= 2) //N1M, N2v and N3t connected
+	{
+		net.add_synapse(VavoulisModel::N3t,VavoulisModel::N1M,8.0,FAST,INHIB);
+		net.add_synapse(VavoulisModel::N1M,VavoulisModel::N3t,0.5,FAST,INHIB);
+		net.add_synapse(VavoulisModel::N2v,VavoulisModel::N3t,2.0,FAST,INHIB);
+	}
+	if(connection >= 1) //N1M and N2v connected
+	{
+		net.add_synapse(VavoulisModel::N2v,VavoulisModel::N1M,50.0,FAST,INHIB);
+		net.add_synapse(VavoulisModel::N1M,VavoulisModel::N2v,0.077,SLOW,EXCIT);
+	}
+
+	net.build();
+	return net;
+}
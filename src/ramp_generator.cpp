@@ -14,8 +14,14 @@ using namespace std;
 
 RampGenerator::RampGenerator(double min, double max, double stim_inc, double stim_dur)
 {
+	//Without ramp, same as the empty constructor.
 	if(min==-1||max==-1||stim_inc==-1||stim_dur==-1)
-		RampGenerator();
+	{
+		this->min = 0;
+		this->max = 0;
+		this->stim_inc = 0;
+		this->stim_dur = 0;
+	}
 	else
 	{
 		this->min = min;
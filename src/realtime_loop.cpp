@@ -0,0 +1,336 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+
+
+#include "realtime_loop.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <iostream>
+#include <sstream>
+#include <chrono>
+using namespace std;
+
+
+LatencyHistogram::LatencyHistogram()
+{
+	for(int b=0; b<RT_BUCKETS; b++)
+		counts[b] = 0;
+	n = 0;
+	sum = 0;
+	max = 0;
+}
+
+
+void LatencyHistogram::print(FILE * f,const char * title)
+{
+	fprintf(f,"\n%s: %ld values, mean %.3f us, max %.3f us\n",title,n,n > 0 ? sum/n : 0,max);
+	for(int b=0; b<RT_BUCKETS; b++)
+	{
+		if(counts[b] == 0)
+			continue;
+		double low = b == 0 ? 0 : ldexp(1,b-1);
+		if(b == RT_BUCKETS-1)
+			fprintf(f,"  >= %-9g us %12ld\n",low,counts[b]);
+		else
+			fprintf(f,"  %9g-%-9g us %12ld\n",low,ldexp(1,b),counts[b]);
+	}
+}
+
+
+/*!
+* @brief Adds ns nanoseconds to a time.
+*/
+static void add_ns(timespec &t,long ns)
+{
+	t.tv_sec += ns/1000000000L;
+	t.tv_nsec += ns%1000000000L;
+	if(t.tv_nsec >= 1000000000L)
+	{
+		t.tv_sec++;
+		t.tv_nsec -= 1000000000L;
+	}
+}
+
+
+/*!
+* @brief Time from b to a in us.
+*/
+static double diff_us(const timespec &a,const timespec &b)
+{
+	return (a.tv_sec-b.tv_sec)*1e6+(a.tv_nsec-b.tv_nsec)*1e-3;
+}
+
+
+void RealTimeLoop::QueueSink::write(const SpikeEvent * events,int n)
+{
+	for(int k=0; k<n; k++)
+		if(!loop->spikes.push(events[k]))
+			loop->dropped_spikes++;
+}
+
+
+RealTimeLoop::RealTimeLoop(CPGSimulator * cpg,double period,int priority,bool lock_memory)
+	:ready(RT_QUEUE),spare(RT_QUEUE),spikes(RT_QUEUE),inputs(RT_QUEUE)
+{
+	this->cpg = cpg;
+	this->period = period;
+	this->priority = priority;
+	this->lock_memory = lock_memory;
+	n_neurons = cpg->getNNeurons();
+	rec_size = n_neurons+2;
+	slots.assign(RT_QUEUE*rec_size,0);
+	for(int s=0; s<RT_QUEUE; s++)
+		spare.push(s);
+
+	ticks = 0;
+	steps_per_tick = 0;
+	dropped_records = 0;
+	dropped_spikes = 0;
+	applied = 0;
+	running = false;
+	f = NULL;
+	sink = NULL;
+	publisher = NULL;
+	f_in = NULL;
+}
+
+
+int RealTimeLoop::run(FILE * f,SpikeSink * sink,FILE * f_in,long n_ticks,double dt,CPGSimulator::integrators integration)
+{
+	if(integration == CPGSimulator::ADAPTIVE || integration == CPGSimulator::ADAPTIVE_ROSENBROCK)
+	{
+		cerr << "Error: the real-time mode needs a fixed step integrator" << endl;
+		return 0;
+	}
+	steps_per_tick = llround(period/dt);
+	if(steps_per_tick < 1 || fabs(steps_per_tick*dt-period) > 1e-6*period)
+	{
+		cerr << "Error: the real-time period " << period << " ms is not a multiple of dt " << dt << endl;
+		return 0;
+	}
+
+	//Everything the control thread uses is allocated before the first tick.
+	long max_samples = steps_per_tick/OUT_DECIMATION+1;
+	tick_t.assign(max_samples,0);
+	tick_v.assign(max_samples*n_neurons,0);
+	tick_c.assign(max_samples,0);
+	cpg->getProtocol().extend(cpg->getTime()+n_ticks*period);
+	QueueSink queue_sink(this);
+
+	this->f = f;
+	this->sink = sink;
+	this->f_in = f_in;
+	running.store(true);
+	io = std::thread(&RealTimeLoop::write_loop,this);
+	if(f_in)
+		in = std::thread(&RealTimeLoop::read_loop,this);
+
+	//The helper threads are started before, so they keep the normal scheduler.
+	if(lock_memory && mlockall(MCL_CURRENT|MCL_FUTURE) != 0)
+		cerr << "Warning: mlockall failed (" << strerror(errno) << "), memory is not locked" << endl;
+	int policy;
+	sched_param old_param;
+	pthread_getschedparam(pthread_self(),&policy,&old_param);
+	if(priority > 0)
+	{
+		sched_param param;
+		param.sched_priority = priority;
+		int err = pthread_setschedparam(pthread_self(),SCHED_FIFO,&param);
+		if(err != 0)
+			cerr << "Warning: SCHED_FIFO priority " << priority << " not set (" << strerror(err) << "), running with the normal scheduler" << endl;
+	}
+
+	long period_ns = llround(period*1e6);
+	Input pending = Input();
+	bool has_pending = false;
+	timespec next, wake, done;
+	clock_gettime(CLOCK_MONOTONIC,&next);
+
+	for(ticks=0; ticks<n_ticks; ticks++)
+	{
+		add_ns(next,period_ns);
+		while(clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&next,NULL) == EINTR);
+		clock_gettime(CLOCK_MONOTONIC,&wake);
+		jitter.add(diff_us(wake,next));
+
+		//Inputs due at the start of the tick (up to the rounding of the accumulated time), a later one waits in pending.
+		double t = cpg->getTime()+dt/2;
+		while(has_pending || inputs.pop(pending))
+		{
+			has_pending = true;
+			if(pending.t > t)
+				break;
+			cpg->getProtocol().hold(pending.neuron,pending.value);
+			applied++;
+			has_pending = false;
+		}
+
+		long n;
+		cpg->advance(steps_per_tick,dt,integration,OUT_DECIMATION,tick_t.data(),tick_v.data(),tick_c.data(),max_samples,&n,queue_sink);
+		for(long k=0; k<n; k++)
+		{
+			int s;
+			if(!spare.pop(s))
+			{
+				dropped_records++;
+				continue;
+			}
+			double * rec = slots.data()+(long)s*rec_size;
+			rec[0] = tick_t[k];
+			for(int i=0; i<n_neurons; i++)
+				rec[i+1] = tick_v[k*n_neurons+i];
+			rec[n_neurons+1] = tick_c[k];
+			ready.push(s);
+		}
+
+		//The tick must end before the next release.
+		clock_gettime(CLOCK_MONOTONIC,&done);
+		compute.add(diff_us(done,wake));
+		timespec deadline = next;
+		add_ns(deadline,period_ns);
+		double late = diff_us(done,deadline);
+		if(late > 0)
+			misses.add(late);
+	}
+
+	if(priority > 0)
+		pthread_setschedparam(pthread_self(),policy,&old_param);
+	if(lock_memory)
+		munlockall();
+
+	running.store(false,std::memory_order_release);
+	io.join();
+	if(in.joinable())
+		in.join();
+	return 1;
+}
+
+
+void RealTimeLoop::write_loop()
+{
+	SpikeEvent batch[SPIKE_RING_SIZE];
+
+	for(;;)
+	{
+		//Everything pushed before the control thread stopped is written before leaving.
+		bool stop = !running.load(std::memory_order_acquire);
+		bool idle = true;
+
+		int s;
+		while(ready.pop(s))
+		{
+			const double * rec = slots.data()+(long)s*rec_size;
+			if(f)
+				for(int i=0; i<rec_size; i++)
+					fprintf(f,i==rec_size-1 ? "%f\n" : "%f ",rec[i]);
+			if(publisher && publisher->due())
+			{
+				memcpy(publisher->begin(),rec,rec_size*sizeof(double));
+				publisher->commit();
+			}
+			spare.push(s);
+			idle = false;
+		}
+
+		int n = 0;
+		while(n < SPIKE_RING_SIZE && spikes.pop(batch[n]))
+			n++;
+		if(n > 0)
+		{
+			if(sink)
+				sink->write(batch,n);
+			idle = false;
+		}
+
+		if(idle)
+		{
+			if(stop)
+				break;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+	if(f)
+		fflush(f);
+}
+
+
+void RealTimeLoop::read_loop()
+{
+	const std::vector<std::string> &names = cpg->getNames();
+	int fd = fileno(f_in);
+	string line;
+	char buf[4096];
+
+	while(running.load(std::memory_order_acquire))
+	{
+		//Polled, so the thread notices the end of the run while the experiment does not write.
+		pollfd p = {fd,POLLIN,0};
+		if(poll(&p,1,100) <= 0)
+			continue;
+		ssize_t n = read(fd,buf,sizeof(buf));
+		if(n <= 0)
+			break;
+
+		line.append(buf,n);
+		size_t end;
+		while((end = line.find('\n')) != string::npos)
+		{
+			istringstream ss(line.substr(0,end));
+			line.erase(0,end+1);
+
+			//The value is parsed with strtod, which reads nan.
+			Input input;
+			string name, value;
+			char * end_value;
+			if(!(ss >> input.t >> name >> value))
+				continue;
+			input.value = strtod(value.c_str(),&end_value);
+			if(*end_value != 0)
+			{
+				cerr << "Warning: input value " << value << " ignored" << endl;
+				continue;
+			}
+			input.neuron = -1;
+			for(unsigned int i=0; i<names.size(); i++)
+				if(names[i] == name)
+					input.neuron = i;
+			if(input.neuron < 0)
+			{
+				cerr << "Warning: input for unknown neuron " << name << " ignored" << endl;
+				continue;
+			}
+			while(!inputs.push(input) && running.load(std::memory_order_acquire))
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+}
+
+
+void RealTimeLoop::print(FILE * f)
+{
+	fprintf(f,"\nReal-time stats\n");
+	fprintf(f,"%-16s %12.6f ms\n","period",period);
+	fprintf(f,"%-16s %12ld\n","steps_per_tick",steps_per_tick);
+	fprintf(f,"%-16s %12ld\n","ticks",ticks);
+	fprintf(f,"%-16s %12ld %8.3f %%\n","deadline_misses",misses.getN(),ticks > 0 ? 100.0*misses.getN()/ticks : 0);
+	fprintf(f,"%-16s %12ld\n","dropped_records",dropped_records);
+	fprintf(f,"%-16s %12ld\n","dropped_spikes",dropped_spikes);
+	fprintf(f,"%-16s %12ld\n","inputs",applied);
+	jitter.print(f,"Wake-up jitter");
+	compute.print(f,"Tick compute time");
+	misses.print(f,"Deadline misses (time after the next release)");
+}
@@ -0,0 +1,277 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+
+
+#include "result_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <iostream>
+using namespace std;
+
+
+/*!
+* @brief Copies a file.
+* @return 1 on success, 0 otherwise
+*/
+static int copy_file(const string &src,const string &dst)
+{
+	FILE * in = fopen(src.c_str(),"rb");
+	if(!in)
+		return 0;
+	FILE * out = fopen(dst.c_str(),"wb");
+	if(!out)
+	{
+		fclose(in);
+		return 0;
+	}
+
+	std::vector<char> buf(1<<20);
+	size_t n;
+	bool ok = true;
+	while((n = fread(buf.data(),1,buf.size(),in)) > 0 && ok)
+		ok = fwrite(buf.data(),1,n,out) == n;
+	ok = ok && !ferror(in);
+	fclose(in);
+	return fclose(out) == 0 && ok;
+}
+
+
+/*!
+* @brief Removes a directory and the files in it.
+*/
+static void remove_dir(const string &path)
+{
+	DIR * d = opendir(path.c_str());
+	if(d)
+	{
+		struct dirent * e;
+		while((e = readdir(d)))
+			if(strcmp(e->d_name,".") && strcmp(e->d_name,".."))
+				unlink((path+"/"+e->d_name).c_str());
+		closedir(d);
+	}
+	rmdir(path.c_str());
+}
+
+
+/*!
+* @brief Reads a whole file.
+* @return 0 if it can not be read
+*/
+static int read_file(const string &file,string &contents)
+{
+	FILE * f = fopen(file.c_str(),"rb");
+	if(!f)
+		return 0;
+	char buf[1<<16];
+	size_t n;
+	contents.clear();
+	while((n = fread(buf,1,sizeof(buf),f)) > 0)
+		contents.append(buf,n);
+	bool ok = !ferror(f);
+	fclose(f);
+	return ok;
+}
+
+
+/*!
+* @brief Name of the i-th file of an entry.
+*/
+static string entry_file(const string &entry,int i)
+{
+	return entry+"/file"+to_string(i);
+}
+
+
+ResultCache::ResultCache(const char * dir,double max_mb)
+{
+	this->dir = dir;
+	max_bytes = max_mb*1024*1024;
+
+	if(mkdir(dir,0777) != 0 && errno != EEXIST)
+		lock_fd = -1;
+	else
+		lock_fd = open((this->dir+"/lock").c_str(),O_RDWR|O_CREAT,0666);
+	if(lock_fd < 0)
+		cerr << "Error: can not use the cache directory " << dir << ": " << strerror(errno) << endl;
+}
+
+
+ResultCache::~ResultCache()
+{
+	if(lock_fd >= 0)
+		close(lock_fd);
+}
+
+
+void ResultCache::lock(int op)
+{
+	while(flock(lock_fd,op) != 0 && errno == EINTR);
+}
+
+
+void ResultCache::unlock()
+{
+	flock(lock_fd,LOCK_UN);
+}
+
+
+string ResultCache::hash(const string &key)
+{
+	unsigned long long h = 14695981039346656037ULL;
+	for(unsigned int i=0; i<key.size(); i++)
+	{
+		h ^= (unsigned char)key[i];
+		h *= 1099511628211ULL;
+	}
+	char hex[17];
+	snprintf(hex,sizeof(hex),"%016llx",h);
+	return hex;
+}
+
+
+int ResultCache::add_file(string &key,const char * name,const char * file)
+{
+	string contents;
+	if(!read_file(file,contents))
+	{
+		cerr << "Error: can not read " << file << endl;
+		return 0;
+	}
+	key += string(name)+" "+to_string(contents.size())+" "+hash(contents)+"\n";
+	return 1;
+}
+
+
+int ResultCache::fetch(const string &key,const std::vector<string> &files)
+{
+	if(!isOpen())
+		return 0;
+
+	string entry = getEntry(key);
+	string stored;
+	int found = 0;
+
+	lock(LOCK_SH);
+	if(read_file(entry+"/key",stored) && stored == key)
+	{
+		found = 1;
+		for(unsigned int i=0; i<files.size() && found; i++)
+			found = copy_file(entry_file(entry,i),files[i]);
+		if(!found)
+			cerr << "Warning: the cache entry " << entry << " could not be copied, simulating" << endl;
+		else
+			utimes((entry+"/key").c_str(),NULL);
+	}
+	unlock();
+	return found;
+}
+
+
+int ResultCache::store(const string &key,const std::vector<string> &files)
+{
+	if(!isOpen())
+		return 0;
+
+	//The entry is complete before it appears in the cache.
+	string tmp = dir+"/tmp."+to_string(getpid());
+	remove_dir(tmp);
+	bool ok = mkdir(tmp.c_str(),0777) == 0;
+	for(unsigned int i=0; i<files.size() && ok; i++)
+		ok = copy_file(files[i],entry_file(tmp,i));
+	if(ok)
+	{
+		FILE * f = fopen((tmp+"/key").c_str(),"w");
+		ok = f && fwrite(key.data(),1,key.size(),f) == key.size();
+		ok = f && fclose(f) == 0 && ok;
+	}
+
+	string entry = getEntry(key);
+	if(ok)
+	{
+		lock(LOCK_EX);
+		remove_dir(entry);
+		ok = rename(tmp.c_str(),entry.c_str()) == 0;
+		if(ok)
+			evict(hash(key));
+		unlock();
+	}
+	if(!ok)
+	{
+		cerr << "Error: can not add the results to the cache " << dir << endl;
+		remove_dir(tmp);
+	}
+	return ok;
+}
+
+
+void ResultCache::evict(const string &keep)
+{
+	struct Entry
+	{
+		string name;
+		time_t used;
+		long bytes;
+	};
+	std::vector<Entry> entries;
+	long total = 0;
+
+	DIR * d = opendir(dir.c_str());
+	if(!d)
+		return;
+	struct dirent * e;
+	while((e = readdir(d)))
+	{
+		string name = e->d_name;
+		string path = dir+"/"+name;
+		struct stat st;
+
+		//Temporary entries of processes that ended before adding them.
+		if(name.compare(0,4,"tmp.") == 0)
+		{
+			if(kill(atoi(name.c_str()+4),0) != 0 && errno == ESRCH)
+				remove_dir(path);
+			continue;
+		}
+		if(name.size() != 16 || name.find_first_not_of("0123456789abcdef") != string::npos)
+			continue;
+		if(stat((path+"/key").c_str(),&st) != 0)
+		{
+			remove_dir(path);
+			continue;
+		}
+
+		Entry entry = {name,st.st_mtime,(long)st.st_size};
+		for(int i=0; stat(entry_file(path,i).c_str(),&st) == 0; i++)
+			entry.bytes += st.st_size;
+		entries.push_back(entry);
+		total += entry.bytes;
+	}
+	closedir(d);
+
+	std::sort(entries.begin(),entries.end(),[](const Entry &a,const Entry &b){return a.used < b.used;});
+	for(unsigned int i=0; i<entries.size() && total > max_bytes; i++)
+		if(entries[i].name != keep)
+		{
+			remove_dir(dir+"/"+entries[i].name);
+			total -= entries[i].bytes;
+		}
+}
@@ -0,0 +1,104 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+
+/*
+ Monitor of a running simulation published in shared memory (feeding_cpg -shm name): prints the new records as an ascii trace
+ ("t V... c" with every neuron), or the spike events, until the simulation ends. Records overwritten before they were read are reported.
+*/
+
+#include "shm_stream.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <vector>
+using namespace std;
+
+string format = "Format: ./shm_monitor name [-what records|spikes] [-from_start 0|1]\n\t name: shared memory segment given to feeding_cpg -shm\n\t from_start: 1 to print the records still in the ring, 0 (default) only the new ones\n";
+
+
+int main(int argc, char * argv[])
+{
+	if(argc < 2 || argc%2 != 0 || strcmp(argv[1],"--help")==0)
+	{
+		cout << format << endl;
+		return -1;
+	}
+
+	bool spikes = false, from_start = false;
+	for(int i=2; i<argc; i+=2)
+	{
+		if(strcmp(argv[i],"-what")==0 && (strcmp(argv[i+1],"records")==0 || strcmp(argv[i+1],"spikes")==0))
+			spikes = strcmp(argv[i+1],"spikes")==0;
+		else if(strcmp(argv[i],"-from_start")==0)
+			from_start = atoi(argv[i+1]) != 0;
+		else
+		{
+			cerr << "Error: unknown option " << argv[i] << " " << argv[i+1] << endl << format;
+			return -1;
+		}
+	}
+
+	ShmReader reader;
+	if(!reader.open(argv[1],from_start))
+		return -1;
+
+	int n_cols = reader.getNCols();
+	vector<string> names;
+	istringstream in(reader.getColumns());
+	string name;
+	while(in >> name)
+		names.push_back(name);
+
+	const long max = 4096;
+	vector<double> recs(max*n_cols);
+	vector<ShmSpike> spks(max);
+	long lost = 0, reported = 0;
+
+	printf("%s\n",spikes ? "t v neuron" : reader.getColumns());
+	for(;;)
+	{
+		//The state is read before, so the last elements are read after the simulation has ended.
+		bool finished = reader.finished();
+		long n;
+		if(spikes)
+		{
+			n = reader.read_spikes(spks.data(),max,&lost);
+			for(long k=0; k<n; k++)
+			{
+				int j = spks[k].neuron+1;
+				printf("%f %f %s\n",spks[k].t,spks[k].v,j > 0 && j < (int)names.size()-1 ? names[j].c_str() : "?");
+			}
+		}
+		else
+		{
+			n = reader.read_records(recs.data(),max,&lost);
+			for(long k=0; k<n; k++)
+				for(int c=0; c<n_cols; c++)
+					printf(c==n_cols-1 ? "%f\n" : "%f ",recs[k*n_cols+c]);
+		}
+		if(lost != reported)
+		{
+			cerr << "Warning: " << lost-reported << " " << (spikes ? "spikes" : "records") << " overwritten before they were read" << endl;
+			reported = lost;
+		}
+
+		if(n == 0)
+		{
+			if(finished)
+				break;
+			fflush(stdout);
+			usleep(20000);
+		}
+	}
+	return 0;
+}
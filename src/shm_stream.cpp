@@ -0,0 +1,216 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+
+
+#include "shm_stream.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <iostream>
+using namespace std;
+
+static_assert(sizeof(ShmHeader) == 192+SHM_COLUMNS && sizeof(ShmSpike) == 24,"Layout of the shared memory changed");
+
+
+ShmPublisher::ShmPublisher(SpikeSink * next)
+{
+	this->next = next;
+	header = NULL;
+	size = 0;
+	records = NULL;
+	spikes = NULL;
+	rec_head = 0;
+	spk_head = 0;
+	count = 0;
+	decimation = 1;
+}
+
+
+ShmPublisher::~ShmPublisher()
+{
+	if(!header)
+		return;
+	header->state.store(1,std::memory_order_release);
+	munmap(header,size);
+	shm_unlink(name.c_str());
+}
+
+
+int ShmPublisher::open(const char * name,const char * columns,double dt,int steps,int decimation,long rec_capacity,long spk_capacity)
+{
+	if(strlen(columns) >= SHM_COLUMNS || decimation < 1 || rec_capacity < 1 || spk_capacity < 1)
+	{
+		cerr << "Error: not valid shared memory parameters" << endl;
+		return 0;
+	}
+
+	int n_cols = 1;
+	for(const char * c=columns; *c; c++)
+		if(*c == ' ')
+			n_cols++;
+	size_t rec_bytes = rec_capacity*n_cols*sizeof(double);
+	size = SHM_HEADER_SIZE+rec_bytes+spk_capacity*sizeof(ShmSpike);
+
+	//A new segment each run, readers of the previous one keep their mapping.
+	shm_unlink(name);
+	int fd = shm_open(name,O_CREAT|O_EXCL|O_RDWR,0644);
+	if(fd < 0 || ftruncate(fd,size) != 0)
+	{
+		cerr << "Error: can not create shared memory " << name << " (" << strerror(errno) << ")" << endl;
+		if(fd >= 0)
+			close(fd);
+		return 0;
+	}
+	void * map = mmap(NULL,size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+	close(fd);
+	if(map == MAP_FAILED)
+	{
+		cerr << "Error: can not map shared memory " << name << " (" << strerror(errno) << ")" << endl;
+		shm_unlink(name);
+		return 0;
+	}
+
+	//The segment is zero filled, so the counters start at 0. The magic is written last, when the header is complete.
+	this->name = name;
+	header = (ShmHeader *)map;
+	header->version = SHM_VERSION;
+	header->n_cols = n_cols;
+	header->rec_capacity = rec_capacity;
+	header->spk_capacity = spk_capacity;
+	header->rec_offset = SHM_HEADER_SIZE;
+	header->spk_offset = SHM_HEADER_SIZE+rec_bytes;
+	header->dt = dt;
+	header->decimation = steps*decimation;
+	strcpy(header->columns,columns);
+	records = (double *)((char *)map+header->rec_offset);
+	spikes = (ShmSpike *)((char *)map+header->spk_offset);
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(header->magic,SHM_MAGIC,sizeof(SHM_MAGIC));
+
+	this->decimation = decimation;
+	count = decimation-1; //The first record is published
+	rec_head = 0;
+	spk_head = 0;
+	return 1;
+}
+
+
+void ShmPublisher::write(const SpikeEvent * events,int n)
+{
+	if(header)
+	{
+		for(int k=0; k<n; k++)
+		{
+			header->spk_seq.store(2*spk_head+1,std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			ShmSpike &s = spikes[spk_head%header->spk_capacity];
+			s.t = events[k].t;
+			s.v = events[k].v;
+			s.neuron = events[k].neuron;
+			spk_head++;
+			header->spk_seq.store(2*spk_head,std::memory_order_release);
+		}
+	}
+
+	if(next)
+		next->write(events,n);
+}
+
+
+ShmReader::~ShmReader()
+{
+	if(header)
+		munmap(header,size);
+}
+
+
+int ShmReader::open(const char * name,bool from_start)
+{
+	int fd = shm_open(name,O_RDONLY,0);
+	struct stat st;
+	if(fd < 0 || fstat(fd,&st) != 0 || st.st_size < SHM_HEADER_SIZE)
+	{
+		cerr << "Error: can not open shared memory " << name << " (" << (fd < 0 ? strerror(errno) : "too small") << ")" << endl;
+		if(fd >= 0)
+			close(fd);
+		return 0;
+	}
+	size = st.st_size;
+	void * map = mmap(NULL,size,PROT_READ,MAP_SHARED,fd,0);
+	close(fd);
+	if(map == MAP_FAILED)
+	{
+		cerr << "Error: can not map shared memory " << name << " (" << strerror(errno) << ")" << endl;
+		return 0;
+	}
+	header = (ShmHeader *)map;
+	if(memcmp(header->magic,SHM_MAGIC,sizeof(SHM_MAGIC)) != 0 || header->version != SHM_VERSION)
+	{
+		cerr << "Error: " << name << " is not a simulation stream" << endl;
+		munmap(map,size);
+		header = NULL;
+		return 0;
+	}
+
+	rec_next = from_start ? 0 : header->rec_seq.load(std::memory_order_acquire)/2;
+	spk_next = from_start ? 0 : header->spk_seq.load(std::memory_order_acquire)/2;
+	return 1;
+}
+
+
+long ShmReader::read_ring(std::atomic<uint64_t> &seq,const char * ring,size_t elem_size,uint64_t capacity,uint64_t &next,char * out,long max,long * lost)
+{
+	//Elements written so far. Older than capacity are already overwritten.
+	uint64_t done = seq.load(std::memory_order_acquire)/2;
+	uint64_t first = next;
+	if(done > capacity && first < done-capacity)
+		first = done-capacity;
+	uint64_t last = done < first+max ? done : first+max;
+
+	for(uint64_t i=first; i<last; )
+	{
+		uint64_t slot = i%capacity;
+		uint64_t n = capacity-slot < last-i ? capacity-slot : last-i;
+		memcpy(out+(i-first)*elem_size,ring+slot*elem_size,n*elem_size);
+		i += n;
+	}
+
+	//Elements whose slot was written again during the copy are dropped: slot i is valid while less than i+capacity elements were started.
+	std::atomic_thread_fence(std::memory_order_acquire);
+	uint64_t started = (seq.load(std::memory_order_relaxed)+1)/2;
+	uint64_t valid = started > capacity ? started-capacity : 0;
+	uint64_t kept = first;
+	if(kept < valid)
+	{
+		kept = valid < last ? valid : last;
+		memmove(out,out+(kept-first)*elem_size,(last-kept)*elem_size);
+	}
+
+	if(lost)
+		*lost += kept-next;
+	next = last;
+	return last-kept;
+}
+
+
+long ShmReader::read_records(double * out,long max,long * lost)
+{
+	return read_ring(header->rec_seq,(const char *)header+header->rec_offset,header->n_cols*sizeof(double),header->rec_capacity,rec_next,(char *)out,max,lost);
+}
+
+
+long ShmReader::read_spikes(ShmSpike * out,long max,long * lost)
+{
+	return read_ring(header->spk_seq,(const char *)header+header->spk_offset,sizeof(ShmSpike),header->spk_capacity,spk_next,(char *)out,max,lost);
+}
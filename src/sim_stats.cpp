@@ -0,0 +1,100 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+
+#include "sim_stats.h"
+
+#include <iostream>
+
+using namespace std;
+
+const char * SimStats::phase_names[SimStats::n_phases] = {"integration","spikes","output","protocol","checkpoint"};
+
+
+SimStats::SimStats()
+{
+	for(int p=0; p<n_phases; p++)
+		phase_time[p] = 0;
+	wall = 0;
+	cpu = 0;
+	steps = 0;
+	rhs_evals = 0;
+	exp_calls = 0;
+	spikes = 0;
+	trace_bytes = 0;
+	spike_bytes = 0;
+	cpu_begin = 0;
+}
+
+
+void SimStats::start()
+{
+	cpu_begin = ::clock();
+	wall_begin = clock::now();
+	mark = wall_begin;
+}
+
+
+void SimStats::stop()
+{
+	wall += chrono::duration<double>(clock::now()-wall_begin).count();
+	cpu += (double)(::clock()-cpu_begin) / CLOCKS_PER_SEC;
+}
+
+
+/*!
+* @brief Rate of a counter per second of wall time, 0 if no time was measured.
+*/
+static double rate(double n,double secs)
+{
+	return secs > 0 ? n/secs : 0;
+}
+
+
+void SimStats::print(FILE * f)
+{
+	double timed = 0;
+	for(int p=0; p<n_phases; p++)
+		timed += phase_time[p];
+
+	fprintf(f,"\nSimulation stats\n");
+	fprintf(f,"%-12s %12s %8s\n","phase","seconds","% wall");
+	for(int p=0; p<n_phases; p++)
+		fprintf(f,"%-12s %12.6f %8.2f\n",phase_names[p],phase_time[p],rate(100*phase_time[p],wall));
+	fprintf(f,"%-12s %12.6f %8.2f\n","other",wall-timed,rate(100*(wall-timed),wall));
+	fprintf(f,"%-12s %12.6f\n","wall",wall);
+	fprintf(f,"%-12s %12.6f\n","cpu",cpu);
+	fprintf(f,"%-12s %12ld %12.0f /s\n","steps",steps,rate(steps,wall));
+	fprintf(f,"%-12s %12ld %12.0f /s\n","rhs_evals",rhs_evals,rate(rhs_evals,wall));
+	fprintf(f,"%-12s %12ld %12.0f /s\n","exp_calls",exp_calls,rate(exp_calls,wall));
+	fprintf(f,"%-12s %12ld %12.0f /s\n","spikes",spikes,rate(spikes,wall));
+	fprintf(f,"%-12s %12ld %12.0f /s\n","trace_bytes",trace_bytes,rate(trace_bytes,wall));
+	fprintf(f,"%-12s %12ld %12.0f /s\n","spike_bytes",spike_bytes,rate(spike_bytes,wall));
+}
+
+
+int SimStats::write_json(const char * file)
+{
+	FILE * f = fopen(file,"w");
+	if(!f)
+	{
+		cerr << "Error: can not open " << file << endl;
+		return 0;
+	}
+
+	fprintf(f,"{\n\"phases\": {");
+	for(int p=0; p<n_phases; p++)
+		fprintf(f,"%s\"%s\": %.9f",p?", ":"",phase_names[p],phase_time[p]);
+	fprintf(f,"},\n");
+	fprintf(f,"\"wall\": %.9f,\n\"cpu\": %.9f,\n",wall,cpu);
+	fprintf(f,"\"steps\": %ld,\n\"rhs_evals\": %ld,\n\"exp_calls\": %ld,\n\"spikes\": %ld,\n\"trace_bytes\": %ld,\n\"spike_bytes\": %ld\n}\n",
+		steps,rhs_evals,exp_calls,spikes,trace_bytes,spike_bytes);
+	fclose(f);
+	return 1;
+}
@@ -0,0 +1,107 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+
+#include "spike_events.h"
+#include "cpg_simulator.h"
+
+#include <string.h>
+#include <sstream>
+using namespace std;
+
+
+void write_bin_header(FILE * f,const char * magic,int version,std::string body)
+{
+	char head[BIN_ALIGN];
+	snprintf(head,BIN_ALIGN,"%s %d\n",magic,version);
+	if(!body.empty() && body[body.size()-1]!='\n')
+		body += "\n";
+
+	//header_size line has a fixed width so the size is known before writing it.
+	int size = strlen(head) + strlen("header_size 00000000\n") + body.size() + 1;
+	size = ((size+BIN_ALIGN-1)/BIN_ALIGN)*BIN_ALIGN;
+
+	fprintf(f,"%sheader_size %08d\n%s",head,size,body.c_str());
+	int written = strlen(head) + strlen("header_size 00000000\n") + body.size();
+	for(int i=written; i<size-1; i++)
+		fputc(' ',f);
+	fputc('\n',f);
+}
+
+
+void TextSpikeSink::write_header(const char * columns,const char * params)
+{
+	fprintf(f,"%f\n",SPIKE_TH);
+	fprintf(f,"%s\n",columns);
+}
+
+
+void TextSpikeSink::write(const SpikeEvent * events,int n)
+{
+	char * line = this->line.data();
+	int size = this->line.size();
+
+	for(int k=0; k<n; k++)
+	{
+		int len = snprintf(line,size,"%f ",events[k].t);
+		for(int i=0; i<n_neurons && len<size; i++)
+		{
+			if(i == events[k].neuron)
+				len += snprintf(line+len,size-len,"%f ",events[k].v);
+			else
+				len += snprintf(line+len,size-len,", ");
+		}
+		if(len >= size-1) //Only with huge values, the record is truncated.
+			len = size-2;
+		line[len++] = '\n';
+
+		if(writer)
+			writer->write(f,line,len);
+		else
+			fwrite(line,1,len,f);
+	}
+}
+
+
+void BinSpikeSink::write_header(const char * columns,const char * params)
+{
+	stringstream cols(columns);
+	string name, neurons;
+	cols >> name; //time
+	for(int i=0; i<n_neurons && cols >> name; i++)
+		neurons += " " + name;
+
+	char line[BIN_ALIGN];
+	snprintf(line,BIN_ALIGN,"spike_th %.10g\n",SPIKE_TH);
+	string body = "columns t:f8 v:f4 neuron:i4\nneurons" + neurons + "\n" + line;
+	if(params)
+		body += params;
+
+	write_bin_header(f,SPIKES_MAGIC,SPIKES_VERSION,body);
+}
+
+
+void BinSpikeSink::write(const SpikeEvent * events,int n)
+{
+	char rec[sizeof(double)+sizeof(float)+sizeof(int)];
+
+	for(int k=0; k<n; k++)
+	{
+		float v = events[k].v;
+		int neuron = events[k].neuron;
+		memcpy(rec,&events[k].t,sizeof(double));
+		memcpy(rec+sizeof(double),&v,sizeof(float));
+		memcpy(rec+sizeof(double)+sizeof(float),&neuron,sizeof(int));
+
+		if(writer)
+			writer->write(f,rec,sizeof(rec));
+		else
+			fwrite(rec,1,sizeof(rec),f);
+	}
+}
@@ -0,0 +1,146 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+
+#include "step_pool.h"
+
+
+/*!
+* @brief Processor hint for busy-wait loops.
+*/
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
+
+StepPool::StepPool(int n_threads)
+{
+	this->n_threads = n_threads > 1 ? n_threads : 1;
+	spins = this->n_threads <= (int)std::thread::hardware_concurrency() ? POOL_SPINS : 0;
+	job = NULL;
+	job_gen = 0;
+	done = 0;
+	arrived = 0;
+	barrier_gen = 0;
+	sleepers = 0;
+	running = true;
+
+	for(int t=1; t<this->n_threads; t++)
+		workers.push_back(std::thread(&StepPool::worker,this,t));
+}
+
+
+StepPool::~StepPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		running = false;
+		job_gen++;
+	}
+	wake.notify_all();
+
+	for(unsigned int t=0; t<workers.size(); t++)
+		workers[t].join();
+}
+
+
+void StepPool::worker(int tid)
+{
+	long seen = 0;
+
+	while(true)
+	{
+		//Wait for the next job: spin, yield and finally block.
+		int waits = 0;
+		while(job_gen.load(std::memory_order_acquire) == seen)
+		{
+			if(waits < spins)
+				cpu_relax();
+			else if(waits < spins+POOL_YIELDS)
+				std::this_thread::yield();
+			else
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				sleepers++;
+				wake.wait(lock,[&]{return job_gen != seen;});
+				sleepers--;
+			}
+			waits++;
+		}
+		seen = job_gen.load(std::memory_order_acquire);
+
+		if(!running)
+			return;
+
+		(*job)(tid);
+		done.fetch_add(1,std::memory_order_acq_rel);
+	}
+}
+
+
+void StepPool::run(const std::function<void(int)> &job)
+{
+	if(n_threads == 1)
+	{
+		job(0);
+		return;
+	}
+
+	this->job = &job;
+	done.store(0,std::memory_order_relaxed);
+	job_gen++;
+
+	//A worker going to sleep increments sleepers holding the lock and checks job_gen before waiting, so either it sees the new job
+	//or it is counted here, and taking the lock waits until it is blocked in wait.
+	if(sleepers > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+		}
+		wake.notify_all();
+	}
+
+	job(0);
+
+	int waits = 0;
+	while(done.load(std::memory_order_acquire) < n_threads-1)
+	{
+		if(waits++ < spins)
+			cpu_relax();
+		else
+			std::this_thread::yield();
+	}
+}
+
+
+void StepPool::barrier()
+{
+	if(n_threads == 1)
+		return;
+
+	long gen = barrier_gen.load(std::memory_order_acquire);
+	if(arrived.fetch_add(1,std::memory_order_acq_rel) == n_threads-1)
+	{
+		arrived.store(0,std::memory_order_relaxed);
+		barrier_gen.fetch_add(1,std::memory_order_release);
+		return;
+	}
+
+	int waits = 0;
+	while(barrier_gen.load(std::memory_order_acquire) == gen)
+	{
+		if(waits++ < spins)
+			cpu_relax();
+		else
+			std::this_thread::yield();
+	}
+}
@@ -0,0 +1,346 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+
+#include "stim_protocol.h"
+#include "vavoulis_neuron.h"
+
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+using namespace std;
+
+const char * StimProtocol::kind_names[StimProtocol::n_kinds] = {"step","ramp","pulses"};
+
+
+/*!
+* @brief First time of value m of a ramp starting at t0: the smallest t with (t-t0)/dur >= m in floating point, so the change is exactly
+* where RampGenerator::get_ext changes value.
+*/
+static double ramp_change(double t0,double dur,long m)
+{
+	double t = t0+m*dur;
+	while((t-t0)/dur < m)
+		t = nextafter(t,INFINITY);
+	for(double prev = nextafter(t,-INFINITY); (prev-t0)/dur >= m; prev = nextafter(t,-INFINITY))
+		t = prev;
+	return t;
+}
+
+
+void StimProtocol::init(const std::vector<int> &types)
+{
+	this->types = types;
+	held.assign(types.size(),NAN);
+	base.clear();
+	items.clear();
+	sat_t0 = INFINITY;
+	sat_t1 = INFINITY;
+	t_cur = 0;
+	rebuild();
+}
+
+
+void StimProtocol::set_currents(const std::vector<double> &c_values,const RampGenerator &rg)
+{
+	base.clear();
+	for(unsigned int i=0; i<c_values.size() && i<types.size(); i++)
+	{
+		Item it = {STEP,(int)i,0,INFINITY,{c_values[i],0,0,0}};
+		if(c_values[i] == -1 && (rg.getStimInc() <= 0 || rg.getStimDur() <= 0))
+			it.p[0] = rg.getMin(); //No ramp given
+		else if(c_values[i] == -1)
+		{
+			it.kind = RAMP;
+			it.p[0] = rg.getMin();
+			it.p[1] = rg.getMax();
+			it.p[2] = rg.getStimInc();
+			it.p[3] = rg.getStimDur();
+		}
+		base.push_back(it);
+	}
+	rebuild();
+}
+
+
+int StimProtocol::add(const Item &it)
+{
+	bool ok = it.neuron >= 0 && it.neuron < (int)types.size() && it.kind >= 0 && it.kind < n_kinds && it.t0 >= 0 && it.t1 > it.t0;
+	if(it.kind == RAMP)
+		ok = ok && it.p[2] > 0 && it.p[3] > 0;
+	else if(it.kind == PULSES)
+		ok = ok && it.p[1] > 0 && it.p[2] > it.p[1];
+	if(!ok)
+	{
+		cerr << "Error: not valid " << (it.kind >= 0 && it.kind < n_kinds ? kind_names[it.kind] : "item") << " from " << it.t0 << " to " << it.t1 << endl;
+		return 0;
+	}
+	items.push_back(it);
+	rebuild();
+	return 1;
+}
+
+
+void StimProtocol::satiated(double t0,double t1)
+{
+	sat_t0 = t0;
+	sat_t1 = t1;
+	rebuild();
+}
+
+
+int StimProtocol::load(const char * file,const std::vector<std::string> &names)
+{
+	ifstream in(file);
+	if(!in)
+	{
+		cerr << "Error: error openning protocol file " << file << endl;
+		return 0;
+	}
+
+	string line;
+	int n_line = 0;
+	while(getline(in,line))
+	{
+		n_line++;
+		istringstream ss(line);
+		string key, name;
+		if(!(ss >> key) || key[0]=='#')
+			continue;
+
+		if(key == "satiated")
+		{
+			double t0, t1 = INFINITY;
+			if(!(ss >> t0) || t0 < 0)
+			{
+				cerr << "Error: satiated <t0> [t1] expected in line " << n_line << " of " << file << endl;
+				return 0;
+			}
+			ss >> t1;
+			satiated(t0,t1);
+			continue;
+		}
+
+		Item it = {-1,-1,0,INFINITY,{0,0,0,0}};
+		for(int k=0; k<n_kinds; k++)
+			if(key == kind_names[k])
+				it.kind = k;
+		int n_params = it.kind == STEP ? 1 : (it.kind == RAMP ? 4 : 3);
+		if(it.kind < 0 || !(ss >> name))
+		{
+			cerr << "Error: unknown item " << key << " in line " << n_line << " of " << file << endl;
+			return 0;
+		}
+		for(unsigned int i=0; i<names.size(); i++)
+			if(names[i] == name)
+				it.neuron = i;
+		bool ok = it.neuron >= 0;
+		for(int k=0; k<n_params; k++)
+			ok = ok && (ss >> it.p[k]);
+		ok = ok && (ss >> it.t0);
+		if(ok && !(ss >> it.t1))
+			it.t1 = INFINITY;
+		if(!ok || !add(it))
+		{
+			cerr << "Error: in line " << n_line << " of " << file << " (" << line << ")" << endl;
+			return 0;
+		}
+	}
+	return 1;
+}
+
+
+void StimProtocol::rebuild()
+{
+	i_ramp = -1;
+	for(unsigned int k=0; k<base.size()+items.size() && i_ramp < 0; k++)
+	{
+		const Item &it = k < base.size() ? base[k] : items[k-base.size()];
+		if(it.kind == RAMP)
+			i_ramp = it.neuron;
+	}
+
+	double t = t_cur;
+	compile(horizon > 0 ? horizon : PROTOCOL_HORIZON);
+	move(t > 0 ? t : 0);
+}
+
+
+double StimProtocol::item_value(const Item &it,double t)
+{
+	if(it.kind == STEP)
+		return it.p[0];
+
+	if(it.kind == RAMP)
+	{
+		//Same values as RampGenerator::get_ext.
+		double min = it.p[0], max = it.p[1], stim_inc = it.p[2], stim_dur = it.p[3];
+		int max_num_inc = (max-min)/stim_inc;
+		if(max_num_inc <= 0)
+			return min;
+		int inc_times = (t-it.t0)/stim_dur;
+		int inc_times_ramp = inc_times%max_num_inc;
+		if((inc_times/max_num_inc)%2 == 0)
+			return min + inc_times_ramp * stim_inc;
+		return max - inc_times_ramp * stim_inc;
+	}
+
+	//PULSES
+	double period = it.p[2];
+	double k = floor((t-it.t0)/period);
+	return t-(it.t0+k*period) < it.p[1] ? it.p[0] : 0;
+}
+
+
+void StimProtocol::item_changes(const Item &it,double horizon,std::vector<double> &times)
+{
+	times.push_back(it.t0);
+	if(it.t1 < horizon)
+		times.push_back(it.t1);
+	double end = std::min(it.t1,horizon);
+
+	if(it.kind == RAMP)
+	{
+		for(long m=1; ; m++)
+		{
+			double t = ramp_change(it.t0,it.p[3],m);
+			if(t >= end)
+				break;
+			times.push_back(t);
+		}
+	}
+	else if(it.kind == PULSES)
+	{
+		for(long k=0; ; k++)
+		{
+			double on = it.t0+k*it.p[2];
+			if(on >= end)
+				break;
+			times.push_back(on);
+			if(on+it.p[1] < end)
+				times.push_back(on+it.p[1]);
+		}
+	}
+}
+
+
+void StimProtocol::compile(double horizon)
+{
+	int n = types.size();
+	this->horizon = horizon;
+	starts.assign(n,std::vector<double>());
+	values.assign(n,std::vector<double>());
+
+	//Items of each neuron in order of application, the satiated window last.
+	std::vector<std::vector<Item> > neuron_items(n);
+	for(unsigned int k=0; k<base.size()+items.size(); k++)
+	{
+		const Item &it = k < base.size() ? base[k] : items[k-base.size()];
+		neuron_items[it.neuron].push_back(it);
+	}
+	for(int i=0; i<n && sat_t0 < INFINITY; i++)
+	{
+		Item it = {STEP,i,sat_t0,sat_t1,{0,0,0,0}};
+		if(types[i] == VavoulisModel::N3t)
+			it.p[0] = SATIATED_N3T;
+		if(types[i] == VavoulisModel::N1M || types[i] == VavoulisModel::N3t)
+			neuron_items[i].push_back(it);
+	}
+
+	std::vector<double> times;
+	for(int i=0; i<n; i++)
+	{
+		const std::vector<Item> &its = neuron_items[i];
+		times.assign(1,-INFINITY);
+		for(unsigned int k=0; k<its.size(); k++)
+			if(its[k].t0 < horizon)
+				item_changes(its[k],horizon,times);
+		std::sort(times.begin(),times.end());
+		times.erase(std::unique(times.begin(),times.end()),times.end());
+
+		for(unsigned int s=0; s<times.size(); s++)
+		{
+			//Items are evaluated inside the segment, away from their changes.
+			double end = s+1 < times.size() ? times[s+1] : horizon;
+			double t = s == 0 ? std::min(end,0.0)-1 : times[s]+(end-times[s])/2;
+			double set = 0, added = 0;
+			for(unsigned int k=0; k<its.size(); k++)
+				if(t >= its[k].t0 && t < its[k].t1)
+				{
+					if(its[k].kind == PULSES)
+						added += item_value(its[k],t);
+					else
+						set = item_value(its[k],t);
+				}
+
+			if(values[i].empty() || values[i].back() != set+added)
+			{
+				starts[i].push_back(times[s]);
+				values[i].push_back(set+added);
+			}
+		}
+	}
+
+	cursor.assign(n,0);
+	current.assign(n,0);
+	t_cur = -INFINITY;
+	t_next = -INFINITY;
+}
+
+
+void StimProtocol::move(double t)
+{
+	if(t >= horizon)
+	{
+		compile(std::max(2*horizon,2*t));
+	}
+	else if(t < t_cur)
+		cursor.assign(cursor.size(),0);
+
+	t_next = horizon;
+	for(unsigned int i=0; i<cursor.size(); i++)
+	{
+		const std::vector<double> &s = starts[i];
+		int c = cursor[i];
+		while(c+1 < (int)s.size() && s[c+1] <= t)
+			c++;
+		cursor[i] = c;
+		current[i] = std::isnan(held[i]) ? values[i][c] : held[i];
+		if(c+1 < (int)s.size() && s[c+1] < t_next)
+			t_next = s[c+1];
+	}
+	t_cur = t;
+}
+
+
+void StimProtocol::hold(int i,double value)
+{
+	held[i] = value;
+	current[i] = std::isnan(value) ? values[i][cursor[i]] : value;
+}
+
+
+void StimProtocol::extend(double t)
+{
+	if(t < horizon)
+		return;
+	double t_seek = t_cur;
+	compile(t+1);
+	move(t_seek > 0 ? t_seek : 0);
+}
+
+
+long StimProtocol::getNSegments() const
+{
+	long n = 0;
+	for(unsigned int i=0; i<values.size(); i++)
+		n += values[i].size();
+	return n;
+}
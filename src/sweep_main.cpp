@@ -0,0 +1,820 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <algorithm>
+#include <memory>
+
+#include "cpg_simulator.h"
+#include "burst_analysis.h"
+
+using namespace std;
+
+#define MAX_STRING 20000
+
+#define ERROR 0
+#define OK 1
+
+string format = "Format: ./sweep spec_file [-threads n]\n";//<Input format
+
+string methods[] = {"Euler","Runge-Kutta","Adaptive","Rush-Larsen","Rush-Larsen-mid","Rosenbrock","Adaptive-Rosenbrock"}; //<Integrator names in String
+string format_names[] = {"ascii","bin","bin64","none","delta"}; //<Output formats names, same order as CPGSimulator::formats
+string format_ext[] = {"asc","bin","bin","","dlt"}; //<Output file extension for each format
+string headers[] = {"t SO N1M N2v N3t c", "t N1M N2v","t N1M N2v N3t","t SO N1M N2v N3t c","t SO IsynSO N1M IsynN1M N2v IsynN2v N3t IsynN3t",
+		"t SO N1M N2v N3t"};//<File headers depending on the connection.
+
+/*!
+ Parameters that can be swept. Same names as feeding_cpg arguments (without -).
+*/
+enum sweep_params{CONNECTION,DT,C_SO,C_N1M,C_N2V,C_N3T,STIM_DUR,STIM_INC,MIN_C,MAX_C,SECS_DUR,ROUNDS,SATIATED_INI,SATIATED_END,n_sweep_params};
+string param_names[]={"connection","dt","c_so","c_n1m","c_n2v","c_n3t","stim_dur","stim_inc","MIN_c","MAX_c","secs_dur","rounds","satiated_ini","satiated_end"};
+double param_defaults[]={3,0.01,-1,-1,-1,-1,-1,-1,-1,-1,-1,4,-1,-1};
+
+/*!
+ Sweep specification read from the spec file.
+*/
+struct SweepSpec
+{
+	string file_name; ///<Output files prefix
+	CPGSimulator::integrators integration; ///<Integration method
+	CPGSimulator::formats format; ///<Trace file format, NONE for no trace file
+	double delta_res; ///<Quantization step of the delta format, 0 for bit-exact values
+	double out_interval; ///<Time between trace records in ms, 0 for one record each OUT_DECIMATION steps
+	bool spikes; ///<Write the spikes file
+	bool cycles; ///<Write the cycles file of the burst analysis (see BurstAnalysis)
+	double burst_isi; ///<Maximum interval between spikes of the same burst in ms
+	string protocol; ///<Stimulation protocol file applied to every point, empty for none
+	std::vector<std::vector<double> > values; ///<Values of each parameter, n_sweep_params lists
+	double fork_at; ///<Duration in seconds of the simulation shared by the points of a family, -1 to simulate each point from the beginning
+};
+
+/*!
+ Points that only differ in currents, satiated window and duration. With fork_at they share the simulation up to fork_at.
+*/
+struct Family
+{
+	std::vector<double> p; ///<Parameters of the shared prefix: first value of each current, no satiated window, fork_at duration
+	std::vector<int> points; ///<Pending points of the family
+	CPGSimulator cpg; ///<Simulator at fork_at, each point continues from a branch of it
+	string prefix_trace; ///<Trace records of the prefix, without header
+	string prefix_spikes; ///<Spikes lines of the prefix, without header
+	string prefix_cycles; ///<Cycles lines of the prefix, without header
+	std::shared_ptr<BurstAnalysis> analysis; ///<Burst analysis at fork_at, each point continues from a copy of it
+};
+
+/*!
+* @brief Reads the sweep specification.
+* Each line is "name value [value ...]" or "name start:end:step". Lines starting with # are ignored.
+* file_name, integrator (e, r, a, x, xm, s or as) and fork_at take one value, the rest of the parameters are swept in a grid.
+*/
+int read_spec(const char * spec_file, SweepSpec &spec);
+
+/*!
+* @brief Simulates one grid point. Output is written in temporary files renamed when the simulation finishes,
+* so an interrupted point is never taken as finished.
+* @param fam Family of the point, to continue from its prefix. NULL to simulate from the beginning.
+* @return OK if finished, ERROR if files could not be opened.
+*/
+int run_point(const SweepSpec &spec, const std::vector<double> &p, const Family * fam=NULL);
+
+/*!
+* @brief Simulates the prefix of a family up to fork_at, writing its output without headers in temporary files.
+* @return OK if finished, ERROR if files could not be opened.
+*/
+int run_prefix(const SweepSpec &spec, Family &fam);
+
+/*!
+* @brief Iterations and satiated window in iterations of a grid point, computed as in feeding_cpg.
+* @return Number of iterations, -1 if neither ramp nor secs_dur are given.
+*/
+int point_iters(const std::vector<double> &p, double &satiated_ini, double &satiated_end);
+
+/*!
+* @brief Runs task(0..n_tasks-1) in a pool of threads, each worker takes the next pending task.
+* @return Number of tasks that returned ERROR.
+*/
+int run_pool(int n_tasks, int n_threads, const char * what, std::function<int(int)> task);
+
+/*!
+* @brief Groups the pending points in families (see Family) and checks that they can be forked at spec.fork_at.
+*/
+int build_families(const SweepSpec &spec, const std::vector<std::vector<double> > &points, std::vector<Family> &families);
+
+/*!
+* @brief Builds the output files names for a grid point: feeding_cpg names with the connection after the prefix, followed by every swept parameter
+* with all the digits needed to tell its values apart (feeding_cpg names round the currents to 2 decimals and have no duration), and the satiated
+* window if it is not swept.
+* @return OK, or ERROR if a name does not fit in MAX_STRING (a truncated name could be shared by two points).
+*/
+int point_names(const SweepSpec &spec, const std::vector<double> &p, char * file_name, char * file_spikes, char * file_cycles);
+
+/*!
+* @brief True if the output files of a grid point written by this spec exist.
+*/
+bool point_done(const SweepSpec &spec, const std::vector<double> &p);
+
+int main(int argc, char * argv[])
+{
+	int n_threads = thread::hardware_concurrency();
+
+	if(argc < 2 || strcmp(argv[1],"--help")==0)
+	{
+		cout << format << endl;
+		cout << "Spec file: one parameter per line, \"name value [value ...]\" or \"name start:end:step\"" << endl;
+		cout << "\t file_name: output files prefix" << endl;
+		cout << "\t format: ascii (default), bin, bin64, none or delta, same as feeding_cpg -format. delta_res: quantization step of the delta format (default 1e-6, 0 bit-exact)" << endl;
+		cout << "\t spikes_format: ascii (default) or none" << endl;
+		cout << "\t cycles: 1 to write the burst analysis of each point (feeding_cpg -cycles), burst_isi: maximum interval between spikes of a burst in ms" << endl;
+		cout << "\t protocol: stimulation protocol file applied to every point, same as feeding_cpg -protocol" << endl;
+		cout << "\t out_interval: time between trace records in ms, same as feeding_cpg -out_interval (default 0, a record each 4 steps)" << endl;
+		cout << "\t integrator: e for Euler, r for Runge-Kutta, a for adaptive Runge-Kutta (default tolerances), x/xm for Rush-Larsen, s/as for Rosenbrock" << endl;
+		cout << "\t connection dt c_so c_n1m c_n2v c_n3t stim_dur stim_inc MIN_c MAX_c secs_dur rounds satiated_ini satiated_end:" << endl;
+		cout << "\t\t same meaning as in feeding_cpg, all combinations of values are simulated" << endl;
+		cout << "\t fork_at: seconds simulated once for all the points that only differ in currents, satiated window, secs_dur and rounds." << endl;
+		cout << "\t\t The shared part uses the first value of each current, then each point continues with its own values." << endl;
+		cout << "Finished points are skipped, so an interrupted sweep continues by running the same command again." << endl;
+		return -1;
+	}
+	if(argc == 4 && strcmp(argv[2],"-threads")==0)
+		n_threads = atoi(argv[3]);
+	if(n_threads < 1)
+		n_threads = 1;
+
+	SweepSpec spec;
+	if(read_spec(argv[1],spec)==ERROR)
+		return -1;
+
+	///////////////////////////////////////
+	//Build the grid, skipping finished points
+	///////////////////////////////////////
+
+	std::vector<std::vector<double> > points;
+	std::vector<int> idx(n_sweep_params,0);
+	int total = 0;
+
+	while(true)
+	{
+		std::vector<double> p(n_sweep_params);
+		for(int i=0; i<n_sweep_params; i++)
+			p[i] = spec.values[i][idx[i]];
+
+		total++;
+		char name[MAX_STRING], name_spikes[MAX_STRING], name_cycles[MAX_STRING];
+		if(point_names(spec,p,name,name_spikes,name_cycles)==ERROR)
+		{
+			cerr << "Error: output file name too long" << endl;
+			return -1;
+		}
+		if(!point_done(spec,p))
+			points.push_back(p);
+
+		int i=0;
+		for(; i<n_sweep_params; i++)
+		{
+			if(++idx[i] < (int)spec.values[i].size())
+				break;
+			idx[i]=0;
+		}
+		if(i==n_sweep_params)
+			break;
+	}
+
+	printf("Grid points: %d, already finished: %d, threads: %d\n",total,total-(int)points.size(),n_threads);
+
+	auto begin = chrono::steady_clock::now();
+	int failed = 0;
+
+	if(spec.fork_at > 0)
+	{
+		///////////////////////////////////////
+		//Shared prefixes first, then every point continues from a branch of its family
+		///////////////////////////////////////
+
+		std::vector<Family> families;
+		if(build_families(spec,points,families)==ERROR)
+			return -1;
+		printf("Families: %d, forked at %g s\n",(int)families.size(),spec.fork_at);
+
+		std::vector<const Family *> point_family(points.size());
+		for(int k=0; k<(int)families.size(); k++)
+			for(int i : families[k].points)
+				point_family[i] = &families[k];
+
+		failed = run_pool(families.size(),n_threads,"prefixes",[&](int k){return run_prefix(spec,families[k]);});
+		if(failed == 0)
+			failed = run_pool(points.size(),n_threads,"points",[&](int i){return run_point(spec,points[i],point_family[i]);});
+
+		for(int k=0; k<(int)families.size(); k++)
+		{
+			remove(families[k].prefix_trace.c_str());
+			remove(families[k].prefix_spikes.c_str());
+			remove(families[k].prefix_cycles.c_str());
+		}
+	}
+	else
+		failed = run_pool(points.size(),n_threads,"points",[&](int i){return run_point(spec,points[i]);});
+
+	double time_spent = chrono::duration<double>(chrono::steady_clock::now()-begin).count();
+	printf("Execution time: %f\n",time_spent);
+
+	if(failed > 0)
+	{
+		cerr << "Error: " << failed << " simulations failed" << endl;
+		return -1;
+	}
+
+	return 0;
+}
+
+
+int run_pool(int n_tasks, int n_threads, const char * what, std::function<int(int)> task)
+{
+	atomic<int> next(0);
+	atomic<int> done(0);
+	atomic<int> failed(0);
+	mutex out_mutex;
+
+	auto worker = [&]()
+	{
+		int i;
+		while((i = next++) < n_tasks)
+		{
+			if(task(i)==ERROR)
+				failed++;
+			int d = ++done;
+
+			lock_guard<mutex> lock(out_mutex);
+			printf("Finished %d/%d %s\n",d,n_tasks,what);
+			fflush(stdout);
+		}
+	};
+
+	std::vector<thread> pool;
+	for(int t=0; t<n_threads && t<n_tasks; t++)
+		pool.push_back(thread(worker));
+	for(int t=0; t<(int)pool.size(); t++)
+		pool[t].join();
+
+	return failed;
+}
+
+
+int build_families(const SweepSpec &spec, const std::vector<std::vector<double> > &points, std::vector<Family> &families)
+{
+	//Parameters that may change after the fork
+	const int free_params[] = {C_SO,C_N1M,C_N2V,C_N3T,SECS_DUR,ROUNDS,SATIATED_INI,SATIATED_END};
+	std::map<std::vector<double>,int> index;
+
+	for(int i=0; i<(int)points.size(); i++)
+	{
+		const std::vector<double> &p = points[i];
+		double sat_ini, sat_end;
+		int iters = point_iters(p,sat_ini,sat_end);
+		if(iters*p[DT] <= spec.fork_at*1000)
+		{
+			cerr << "Error: simulations must be longer than fork_at" << endl;
+			return ERROR;
+		}
+		if(p[SATIATED_INI]>0 && p[SATIATED_END]>0 && p[SATIATED_INI]<spec.fork_at)
+		{
+			cerr << "Error: satiated_ini " << p[SATIATED_INI] << " is before fork_at" << endl;
+			return ERROR;
+		}
+
+		std::vector<double> key = p;
+		for(int j : free_params)
+			key[j] = -1;
+
+		auto it = index.find(key);
+		if(it == index.end())
+		{
+			Family fam;
+			fam.p = key;
+			fam.p[C_SO] = spec.values[C_SO][0];
+			fam.p[C_N1M] = spec.values[C_N1M][0];
+			fam.p[C_N2V] = spec.values[C_N2V][0];
+			fam.p[C_N3T] = spec.values[C_N3T][0];
+			fam.p[SECS_DUR] = spec.fork_at;
+
+			char num[32];
+			snprintf(num,sizeof(num),"_fork%d",(int)families.size());
+			fam.prefix_trace = spec.file_name+num+".part";
+			fam.prefix_spikes = spec.file_name+num+"_spikes.part";
+			fam.prefix_cycles = spec.file_name+num+"_cycles.part";
+
+			it = index.insert(make_pair(key,(int)families.size())).first;
+			families.push_back(fam);
+		}
+		families[it->second].points.push_back(i);
+	}
+
+	return OK;
+}
+
+
+int point_iters(const std::vector<double> &p, double &satiated_ini, double &satiated_end)
+{
+	double dt = p[DT];
+	double secs_dur = p[SECS_DUR];
+	double stim_dur = p[STIM_DUR];
+	int iters;
+
+	satiated_ini = p[SATIATED_INI];
+	satiated_end = p[SATIATED_END];
+
+	if(p[STIM_DUR]==-1 && secs_dur==-1)
+		return -1;
+
+	//Same iterations computation as feeding_cpg
+	stim_dur*=1000;
+	int stim_dur_iters = stim_dur/dt;
+	if(secs_dur == -1)
+	{
+		secs_dur = ((p[MAX_C]-p[MIN_C])/p[STIM_INC])*p[ROUNDS];
+		iters = secs_dur*(stim_dur_iters);
+	}
+	else
+		iters = (secs_dur*1000 )/dt;
+
+	if(satiated_ini >0 and satiated_end >0)
+	{
+		satiated_ini= (satiated_ini*1000)/dt;
+		satiated_end= (satiated_end*1000)/dt;
+	}
+
+	return iters;
+}
+
+
+/*!
+* @brief Appends the contents of file src to dst.
+*/
+static bool append_file(FILE * dst, const char * src)
+{
+	FILE * in = fopen(src,"rb");
+	if(!in)
+		return false;
+	char buf[1<<16];
+	size_t n;
+	bool ok = true;
+	while(ok && (n = fread(buf,1,sizeof(buf),in)) > 0)
+		ok = fwrite(buf,1,n,dst)==n;
+	fclose(in);
+	return ok;
+}
+
+
+/*!
+* @brief Opens the output files of a simulation written by spec, NULL for the ones not written.
+* @return false if a file could not be opened, the ones opened are closed.
+*/
+static bool open_outputs(const SweepSpec &spec, const char * name, const char * name_spikes, const char * name_cycles, FILE ** f, FILE ** f_spks, FILE ** f_cyc)
+{
+	*f = spec.format != CPGSimulator::NONE ? fopen(name,"w") : NULL;
+	*f_spks = spec.spikes ? fopen(name_spikes,"w") : NULL;
+	*f_cyc = spec.cycles ? fopen(name_cycles,"w") : NULL;
+	if((spec.format != CPGSimulator::NONE && !*f) || (spec.spikes && !*f_spks) || (spec.cycles && !*f_cyc))
+	{
+		cerr << "Error: error openning files " << name << endl;
+		if(*f) fclose(*f);
+		if(*f_spks) fclose(*f_spks);
+		if(*f_cyc) fclose(*f_cyc);
+		return false;
+	}
+	return true;
+}
+
+
+/*!
+* @brief Closes the output files opened by open_outputs.
+*/
+static void close_outputs(FILE * f, FILE * f_spks, FILE * f_cyc)
+{
+	if(f_cyc) fclose(f_cyc);
+	if(f_spks) fclose(f_spks);
+	if(f) fclose(f);
+}
+
+
+/*!
+* @brief Closes the output files of a simulation that failed and removes them, so they are not taken as the output of a finished point.
+*/
+static void discard_outputs(FILE * f, FILE * f_spks, FILE * f_cyc, const char * name, const char * name_spikes, const char * name_cycles)
+{
+	close_outputs(f,f_spks,f_cyc);
+	if(f) remove(name);
+	if(f_spks) remove(name_spikes);
+	if(f_cyc) remove(name_cycles);
+}
+
+
+int run_prefix(const SweepSpec &spec, Family &fam)
+{
+	const std::vector<double> &p = fam.p;
+	double dt = p[DT];
+	double satiated_ini, satiated_end;
+	int iters = point_iters(p,satiated_ini,satiated_end);
+
+	FILE *f, *f_spks, *f_cyc;
+	if(!open_outputs(spec,fam.prefix_trace.c_str(),fam.prefix_spikes.c_str(),fam.prefix_cycles.c_str(),&f,&f_spks,&f_cyc))
+		return ERROR;
+
+	RampGenerator rg(p[MIN_C],p[MAX_C],p[STIM_INC],p[STIM_DUR]*1000);
+	std::vector<double> c_values({p[C_SO],p[C_N1M],p[C_N2V],p[C_N3T]});
+	fam.cpg = CPGSimulator(p[CONNECTION],c_values,rg);
+	if(!spec.protocol.empty() && fam.cpg.load_protocol(spec.protocol.c_str())==0)
+	{
+		discard_outputs(f,f_spks,f_cyc,fam.prefix_trace.c_str(),fam.prefix_spikes.c_str(),fam.prefix_cycles.c_str());
+		return ERROR;
+	}
+	fam.cpg.set_format(spec.format,spec.delta_res);
+	fam.cpg.set_output_interval(spec.out_interval);
+
+	TextSpikeSink text_sink(f_spks,N_NEU);
+	NullSpikeSink null_sink;
+	if(!spec.spikes)
+		fam.cpg.set_spike_sink(&null_sink);
+	if(spec.cycles)
+	{
+		fam.analysis = make_shared<BurstAnalysis>(BurstAnalysis::feeding_sequence(fam.cpg.getTypes()),fam.cpg.getNames(),spec.burst_isi,
+			f_cyc,spec.spikes ? &text_sink : NULL);
+		fam.cpg.set_spike_sink(fam.analysis.get());
+	}
+
+	fam.cpg.simulate(f,f_spks,iters,dt,spec.integration,satiated_ini,satiated_end);
+
+	//Branches get their own sinks.
+	fam.cpg.set_spike_sink(NULL);
+	if(fam.analysis)
+		fam.analysis->set_output(NULL,NULL);
+
+	close_outputs(f,f_spks,f_cyc);
+
+	return OK;
+}
+
+
+/*!
+* @brief Shortest decimal text of a value that reads back as the same double.
+*/
+static string exact_value(double v)
+{
+	char text[32];
+	snprintf(text,sizeof(text),"%.15g",v);
+	if(strtod(text,NULL) != v)
+		snprintf(text,sizeof(text),"%.17g",v);
+	return text;
+}
+
+
+int point_names(const SweepSpec &spec, const std::vector<double> &p, char * file_name, char * file_spikes, char * file_cycles)
+{
+	char file_ext[MAX_STRING];
+	char file_aux[MAX_STRING];
+	string swept;
+	bool fits = true;
+
+	fits &= snprintf(file_ext,MAX_STRING,"%s_%.4f_%.2f_%.2f_%.2f_%.2f",
+		methods[spec.integration].c_str(),p[DT],p[C_SO],p[C_N1M],p[C_N2V],p[C_N3T]) < MAX_STRING;
+
+	if(p[STIM_DUR]!=-1 && p[STIM_INC]!=-1 && p[MIN_C]!=-1 && p[MAX_C]!=-1)
+	{
+		fits &= snprintf(file_aux,MAX_STRING,"%s_%.2f_%.2f_%.2f_%.2f",file_ext,p[STIM_DUR],p[STIM_INC],p[MIN_C],p[MAX_C]) < MAX_STRING;
+		strcpy(file_ext,file_aux);
+	}
+
+	//Connection and satiated window are not in feeding_cpg names. Points must have different names, so swept parameters are added exactly.
+	for(int k=0; k<n_sweep_params; k++)
+		if(k != CONNECTION && spec.values[k].size() > 1)
+			swept += "_" + param_names[k] + exact_value(p[k]);
+	fits &= snprintf(file_aux,MAX_STRING,"%s_c%d%s",spec.file_name.c_str(),(int)p[CONNECTION],swept.c_str()) < MAX_STRING;
+	bool sat_swept = spec.values[SATIATED_INI].size() > 1 || spec.values[SATIATED_END].size() > 1;
+	if(p[SATIATED_INI]>0 && p[SATIATED_END]>0 && !sat_swept)
+	{
+		char sat[MAX_STRING];
+		fits &= snprintf(sat,MAX_STRING,"%s_sat_%.2f_%.2f",file_aux,p[SATIATED_INI],p[SATIATED_END]) < MAX_STRING;
+		strcpy(file_aux,sat);
+	}
+
+	fits &= snprintf(file_spikes,MAX_STRING,"%s_spikes_%s.asc",file_aux,file_ext) < MAX_STRING;
+	fits &= snprintf(file_cycles,MAX_STRING,"%s_cycles_%s.asc",file_aux,file_ext) < MAX_STRING;
+	fits &= snprintf(file_name,MAX_STRING,"%s_%s.%s",file_aux,file_ext,format_ext[spec.format].c_str()) < MAX_STRING;
+	return fits ? OK : ERROR;
+}
+
+
+bool point_done(const SweepSpec &spec, const std::vector<double> &p)
+{
+	char name[MAX_STRING], name_spikes[MAX_STRING], name_cycles[MAX_STRING];
+	point_names(spec,p,name,name_spikes,name_cycles);
+
+	return (spec.format == CPGSimulator::NONE || access(name,F_OK)==0) && (!spec.spikes || access(name_spikes,F_OK)==0) &&
+		(!spec.cycles || access(name_cycles,F_OK)==0);
+}
+
+
+int run_point(const SweepSpec &spec, const std::vector<double> &p, const Family * fam)
+{
+	char file_name[MAX_STRING], file_spikes[MAX_STRING], file_cycles[MAX_STRING];
+	string tmp_name, tmp_spikes, tmp_cycles;
+	int connection = p[CONNECTION];
+	double dt = p[DT];
+	double satiated_ini, satiated_end;
+	int iters = point_iters(p,satiated_ini,satiated_end);
+
+	if(iters == -1)
+	{
+		cerr << "Error: Ramp or secs_dur must be specified" << endl;
+		return ERROR;
+	}
+
+	if(point_names(spec,p,file_name,file_spikes,file_cycles)==ERROR)
+	{
+		cerr << "Error: output file name too long" << endl;
+		return ERROR;
+	}
+	tmp_name = string(file_name)+".part";
+	tmp_spikes = string(file_spikes)+".part";
+	tmp_cycles = string(file_cycles)+".part";
+
+	FILE *f, *f_spks, *f_cyc;
+	if(!open_outputs(spec,tmp_name.c_str(),tmp_spikes.c_str(),tmp_cycles.c_str(),&f,&f_spks,&f_cyc))
+		return ERROR;
+
+	RampGenerator rg(p[MIN_C],p[MAX_C],p[STIM_INC],p[STIM_DUR]*1000);
+	std::vector<double> c_values({p[C_SO],p[C_N1M],p[C_N2V],p[C_N3T]});
+	CPGSimulator cpg;
+	if(fam)
+	{
+		cpg = fam->cpg.branch();
+		cpg.setCurrents(c_values);
+	}
+	else
+	{
+		cpg = CPGSimulator(connection,c_values,rg);
+		if(!spec.protocol.empty() && cpg.load_protocol(spec.protocol.c_str())==0)
+		{
+			discard_outputs(f,f_spks,f_cyc,tmp_name.c_str(),tmp_spikes.c_str(),tmp_cycles.c_str());
+			return ERROR;
+		}
+	}
+	cpg.set_format(spec.format,spec.delta_res);
+	cpg.set_output_interval(spec.out_interval);
+
+	//Spikes go to the ascii file given to simulate unless they are analysed or discarded.
+	TextSpikeSink text_sink(f_spks,N_NEU);
+	NullSpikeSink null_sink;
+	if(!spec.spikes)
+		cpg.set_spike_sink(&null_sink);
+	std::shared_ptr<BurstAnalysis> analysis;
+	if(spec.cycles)
+	{
+		SpikeSink * next = spec.spikes ? &text_sink : NULL;
+		if(fam)
+		{
+			analysis = make_shared<BurstAnalysis>(*fam->analysis);
+			analysis->set_output(f_cyc,next);
+		}
+		else
+			analysis = make_shared<BurstAnalysis>(BurstAnalysis::feeding_sequence(cpg.getTypes()),cpg.getNames(),spec.burst_isi,f_cyc,next);
+		cpg.set_spike_sink(analysis.get());
+	}
+
+	char params[MAX_STRING];
+	int len = snprintf(params,MAX_STRING,"integrator %s\n",methods[spec.integration].c_str());
+	for(int i=0; i<n_sweep_params; i++)
+		if(i != DT) //dt is always in the header
+			len += snprintf(params+len,MAX_STRING-len,"%s %g\n",param_names[i].c_str(),p[i]);
+	if(fam)
+		len += snprintf(params+len,MAX_STRING-len,"fork_at %g\n",spec.fork_at);
+	cpg.write_header(f,headers[connection].c_str(),dt,params);
+	if(f_spks)
+		text_sink.write_header(headers[0].c_str(),NULL);
+	if(analysis)
+		analysis->write_header(NULL,params);
+
+	if(fam && ((f && !append_file(f,fam->prefix_trace.c_str())) || (f_spks && !append_file(f_spks,fam->prefix_spikes.c_str())) ||
+		(f_cyc && !append_file(f_cyc,fam->prefix_cycles.c_str()))))
+	{
+		cerr << "Error: error copying the prefix of " << tmp_name << endl;
+		discard_outputs(f,f_spks,f_cyc,tmp_name.c_str(),tmp_spikes.c_str(),tmp_cycles.c_str());
+		return ERROR;
+	}
+
+	cpg.simulate(f,f_spks,iters,dt,spec.integration,satiated_ini,satiated_end);
+	if(analysis)
+		analysis->finish();
+
+	close_outputs(f,f_spks,f_cyc);
+
+	//A point is finished when all its files exist, so each one is renamed when complete.
+	if((f && rename(tmp_name.c_str(),file_name)!=0) || (f_spks && rename(tmp_spikes.c_str(),file_spikes)!=0) ||
+		(f_cyc && rename(tmp_cycles.c_str(),file_cycles)!=0))
+	{
+		cerr << "Error: error renaming " << tmp_name << endl;
+		return ERROR;
+	}
+
+	return OK;
+}
+
+
+int read_spec(const char * spec_file, SweepSpec &spec)
+{
+	ifstream in(spec_file);
+	if(!in)
+	{
+		cerr << "Error: error openning spec file " << spec_file << endl;
+		return ERROR;
+	}
+
+	spec.integration = CPGSimulator::EULER;
+	spec.format = CPGSimulator::ASCII;
+	spec.delta_res = DELTA_RESOLUTION;
+	spec.out_interval = 0;
+	spec.spikes = true;
+	spec.cycles = false;
+	spec.burst_isi = BURST_ISI;
+	spec.fork_at = -1;
+	spec.values.resize(n_sweep_params);
+
+	string line;
+	int n_line = 0;
+	while(getline(in,line))
+	{
+		n_line++;
+		istringstream ss(line);
+		string key;
+		if(!(ss >> key) || key[0]=='#')
+			continue;
+
+		if(key == "file_name")
+		{
+			ss >> spec.file_name;
+			continue;
+		}
+		if(key == "fork_at")
+		{
+			ss >> spec.fork_at;
+			continue;
+		}
+		if(key == "cycles")
+		{
+			ss >> spec.cycles;
+			continue;
+		}
+		if(key == "burst_isi")
+		{
+			ss >> spec.burst_isi;
+			continue;
+		}
+		if(key == "delta_res")
+		{
+			ss >> spec.delta_res;
+			continue;
+		}
+		if(key == "protocol")
+		{
+			ss >> spec.protocol;
+			continue;
+		}
+		if(key == "out_interval")
+		{
+			ss >> spec.out_interval;
+			continue;
+		}
+		if(key == "spikes_format")
+		{
+			string m;
+			ss >> m;
+			if(m != "ascii" && m != "none")
+			{
+				cerr << "Error: unknown spikes format " << m << " in line " << n_line << endl;
+				return ERROR;
+			}
+			spec.spikes = m == "ascii";
+			continue;
+		}
+		if(key == "format")
+		{
+			string m;
+			ss >> m;
+			int i;
+			for(i=0; i<CPGSimulator::n_formats; i++)
+				if(format_names[i] == m)
+					break;
+			if(i == CPGSimulator::n_formats)
+			{
+				cerr << "Error: unknown format " << m << " in line " << n_line << endl;
+				return ERROR;
+			}
+			spec.format = (CPGSimulator::formats)i;
+			continue;
+		}
+		if(key == "integrator")
+		{
+			string m;
+			ss >> m;
+			if(m == "r" || m == "-r")
+				spec.integration = CPGSimulator::RUNGE;
+			else if(m == "e" || m == "-e")
+				spec.integration = CPGSimulator::EULER;
+			else if(m == "a" || m == "-a")
+				spec.integration = CPGSimulator::ADAPTIVE;
+			else if(m == "x" || m == "-x")
+				spec.integration = CPGSimulator::RUSH_LARSEN;
+			else if(m == "xm" || m == "-xm")
+				spec.integration = CPGSimulator::RUSH_LARSEN_MID;
+			else if(m == "s" || m == "-s")
+				spec.integration = CPGSimulator::ROSENBROCK;
+			else if(m == "as" || m == "-as")
+				spec.integration = CPGSimulator::ADAPTIVE_ROSENBROCK;
+			else
+			{
+				cerr << "Error: unknown integrator " << m << " in line " << n_line << endl;
+				return ERROR;
+			}
+			continue;
+		}
+
+		int i;
+		for(i=0; i<n_sweep_params; i++)
+			if(param_names[i] == key)
+				break;
+		if(i == n_sweep_params)
+		{
+			cerr << "Error: unknown parameter " << key << " in line " << n_line << endl;
+			return ERROR;
+		}
+
+		string val;
+		while(ss >> val)
+		{
+			if(val[0]=='#')
+				break;
+
+			double start,end,step;
+			if(sscanf(val.c_str(),"%lf:%lf:%lf",&start,&end,&step)==3)
+			{
+				if(step <= 0)
+				{
+					cerr << "Error: step must be positive in line " << n_line << endl;
+					return ERROR;
+				}
+				//Half step tolerance so that end is included despite rounding.
+				for(int k=0; start+k*step <= end+step/2; k++)
+					spec.values[i].push_back(start+k*step);
+			}
+			else
+				spec.values[i].push_back(atof(val.c_str()));
+		}
+	}
+
+	if(spec.file_name.empty())
+	{
+		cerr << "Error: no file_name in spec file" << endl;
+		return ERROR;
+	}
+	if(spec.format == CPGSimulator::NONE && !spec.spikes && !spec.cycles)
+	{
+		cerr << "Error: no output, set format, spikes_format or cycles" << endl;
+		return ERROR;
+	}
+
+	for(int i=0; i<n_sweep_params; i++)
+	{
+		if(spec.values[i].empty())
+			spec.values[i].push_back(param_defaults[i]);
+
+		//A repeated value would give two points with the same output files.
+		std::vector<double> &v = spec.values[i];
+		for(unsigned int k=1; k<v.size(); )
+			if(std::find(v.begin(),v.begin()+k,v[k]) != v.begin()+k)
+				v.erase(v.begin()+k);
+			else
+				k++;
+	}
+
+	return OK;
+}
@@ -0,0 +1,198 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+
+#include "trace_codec.h"
+
+#include <math.h>
+#include <string.h>
+#include <iostream>
+#include <sstream>
+using namespace std;
+
+
+void DeltaEncoder::init(int n_cols,double resolution,int block_records)
+{
+	this->n_cols = n_cols;
+	this->resolution = resolution;
+	this->block_records = block_records;
+	n_recs = 0;
+	recs.assign((size_t)n_cols*block_records,0);
+}
+
+
+bool DeltaEncoder::add(const double * vals)
+{
+	int64_t * rec = recs.data()+(size_t)n_recs*n_cols;
+	rec[0] = to_int(vals[0],0);
+	for(int c=1; c<n_cols; c++)
+		rec[c] = to_int(vals[c],resolution);
+	n_recs++;
+	return n_recs == block_records;
+}
+
+
+const std::vector<unsigned char> & DeltaEncoder::encode()
+{
+	block.resize(2*sizeof(uint32_t));
+	if(n_recs == 0)
+	{
+		block.clear();
+		return block;
+	}
+
+	for(int c=0; c<n_cols; c++)
+	{
+		//Unsigned arithmetic, the residual of bit patterns may overflow.
+		uint64_t p1 = 0, p2 = 0;
+		for(int r=0; r<n_recs; r++)
+		{
+			uint64_t q = recs[(size_t)r*n_cols+c];
+			int64_t res = q-(2*p1-p2);
+			uint64_t z = ((uint64_t)res<<1)^(uint64_t)(res>>63);
+			while(z >= 0x80)
+			{
+				block.push_back((z&0x7f)|0x80);
+				z >>= 7;
+			}
+			block.push_back(z);
+			p2 = p1;
+			p1 = q;
+		}
+	}
+
+	uint32_t head[2] = {(uint32_t)n_recs,(uint32_t)(block.size()-sizeof(head))};
+	memcpy(block.data(),head,sizeof(head));
+	n_recs = 0;
+	return block;
+}
+
+
+int64_t DeltaEncoder::to_int(double x,double resolution)
+{
+	if(resolution > 0)
+		return llround(x/resolution);
+	int64_t q;
+	memcpy(&q,&x,sizeof(q));
+	return q;
+}
+
+
+double DeltaEncoder::from_int(int64_t q,double resolution)
+{
+	if(resolution > 0)
+		return q*resolution;
+	double x;
+	memcpy(&x,&q,sizeof(x));
+	return x;
+}
+
+
+int DeltaDecoder::open(FILE * f)
+{
+	char magic[32];
+	int version;
+	long size;
+	if(fscanf(f,"%31s %d header_size %ld",magic,&version,&size) != 3 || strcmp(magic,DELTA_MAGIC) != 0 || version != DELTA_VERSION || size <= 0)
+	{
+		cerr << "Error: not a delta trace file" << endl;
+		return 0;
+	}
+
+	string text(size,' ');
+	rewind(f);
+	if(fread(&text[0],1,size,f) != (size_t)size)
+	{
+		cerr << "Error: truncated header" << endl;
+		return 0;
+	}
+
+	stringstream in(text);
+	string line;
+	getline(in,line);
+	getline(in,line);
+	while(getline(in,line))
+	{
+		stringstream ls(line);
+		string key, name;
+		if(!(ls >> key))
+			continue;
+		if(key == "columns")
+		{
+			while(ls >> name)
+				columns.push_back(name);
+		}
+		else if(key == "resolution")
+			ls >> resolution;
+		else if(key == "block_records")
+			continue;
+		else
+			params += line+"\n";
+	}
+	if(columns.empty())
+	{
+		cerr << "Error: no columns in the header" << endl;
+		return 0;
+	}
+
+	this->f = f;
+	return 1;
+}
+
+
+int DeltaDecoder::read_block(std::vector<double> &vals)
+{
+	uint32_t head[2];
+	size_t got = fread(head,1,sizeof(head),f);
+	if(got == 0)
+		return 0;
+	if(got != sizeof(head) || head[0] == 0)
+	{
+		cerr << "Error: truncated block header" << endl;
+		return -1;
+	}
+
+	payload.resize(head[1]);
+	if(fread(payload.data(),1,head[1],f) != head[1])
+	{
+		cerr << "Error: truncated block" << endl;
+		return -1;
+	}
+
+	int n_recs = head[0], n_cols = columns.size();
+	vals.resize((size_t)n_recs*n_cols);
+	size_t pos = 0;
+	for(int c=0; c<n_cols; c++)
+	{
+		uint64_t p1 = 0, p2 = 0;
+		double res = c == 0 ? 0 : resolution;
+		for(int r=0; r<n_recs; r++)
+		{
+			uint64_t z = 0;
+			int shift = 0;
+			do
+			{
+				if(pos >= payload.size() || shift > 63)
+				{
+					cerr << "Error: corrupt block" << endl;
+					return -1;
+				}
+				z |= (uint64_t)(payload[pos]&0x7f)<<shift;
+				shift += 7;
+			}while(payload[pos++] & 0x80);
+
+			uint64_t q = (z>>1)^(~(z&1)+1);
+			q += 2*p1-p2;
+			vals[(size_t)r*n_cols+c] = DeltaEncoder::from_int(q,res);
+			p2 = p1;
+			p1 = q;
+		}
+	}
+	return n_recs;
+}
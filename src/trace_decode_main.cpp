@@ -0,0 +1,109 @@
+/*************************************************************
+	Developed by Alicia Garrido Peña (2020)
+
+	Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+	and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+
+	Please, if you use this implementation cite the two papers above in your work.
+*************************************************************/
+
+
+/*
+ Decoder of the delta trace format (feeding_cpg -format delta): writes the records as an ascii trace, the same as -format ascii
+ (identical with -delta_res 0), or as a bin64 trace.
+*/
+
+#include "trace_codec.h"
+#include "cpg_simulator.h"
+
+#include <string.h>
+#include <iostream>
+#include <string>
+using namespace std;
+
+string format = "Format: ./trace_decode file.dlt [-o out_file] [-format ascii|bin64]\n\t out_file: default file with .asc or .bin extension, - for stdout\n";
+
+
+int main(int argc, char * argv[])
+{
+	if(argc < 2 || argc%2 != 0 || strcmp(argv[1],"--help")==0)
+	{
+		cout << format << endl;
+		return -1;
+	}
+
+	string in_name = argv[1], out_name;
+	bool bin = false;
+	for(int i=2; i<argc; i+=2)
+	{
+		if(strcmp(argv[i],"-o")==0)
+			out_name = argv[i+1];
+		else if(strcmp(argv[i],"-format")==0 && (strcmp(argv[i+1],"ascii")==0 || strcmp(argv[i+1],"bin64")==0))
+			bin = strcmp(argv[i+1],"bin64")==0;
+		else
+		{
+			cerr << "Error: unknown option " << argv[i] << " " << argv[i+1] << endl << format;
+			return -1;
+		}
+	}
+	if(out_name.empty())
+	{
+		size_t dot = in_name.rfind('.');
+		out_name = (dot == string::npos ? in_name : in_name.substr(0,dot)) + (bin ? ".bin" : ".asc");
+	}
+
+	FILE * f = fopen(in_name.c_str(),"rb");
+	if(!f)
+	{
+		cerr << "Error: error openning " << in_name << endl;
+		return -1;
+	}
+	DeltaDecoder dec;
+	if(!dec.open(f))
+		return -1;
+
+	FILE * out = out_name == "-" ? stdout : fopen(out_name.c_str(),"wb");
+	if(!out)
+	{
+		cerr << "Error: error openning " << out_name << endl;
+		return -1;
+	}
+
+	int n_cols = dec.columns.size();
+	if(bin)
+	{
+		string body = "columns";
+		for(int c=0; c<n_cols; c++)
+			body += " "+dec.columns[c]+":f8";
+		write_bin_header(out,BIN_MAGIC,BIN_VERSION,body+"\n"+dec.params);
+	}
+	else
+	{
+		for(int c=0; c<n_cols; c++)
+			fprintf(out,c==n_cols-1 ? "%s\n" : "%s ",dec.columns[c].c_str());
+	}
+
+	std::vector<double> vals;
+	long records = 0;
+	int n;
+	while((n = dec.read_block(vals)) > 0)
+	{
+		if(bin)
+			fwrite(vals.data(),sizeof(double),vals.size(),out);
+		else
+			for(size_t i=0; i<vals.size(); i++)
+				fprintf(out,(int)(i%n_cols)==n_cols-1 ? "%f\n" : "%f ",vals[i]);
+		records += n;
+	}
+
+	fclose(f);
+	if(out != stdout)
+		fclose(out);
+	if(n < 0)
+	{
+		cerr << "Error: " << records << " records decoded before the error" << endl;
+		return -1;
+	}
+	cerr << records << " records" << endl;
+	return 0;
+}
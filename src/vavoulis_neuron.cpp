@@ -9,10 +9,70 @@
 
 
 #include "vavoulis_neuron.h"
+#include "neuron_traits.h"
 
 #include <iostream>
 using namespace std;
 
+bool VavoulisModel::use_tables = false;
+GatingTable * VavoulisModel::tables[n_types][n_gates];
+std::vector<GatingTable *> VavoulisModel::table_list;
+
+
+void VavoulisModel::build_tables(GatingTable::interpolations interp,double step)
+{
+	for(unsigned int i=0; i<table_list.size(); i++)
+		delete table_list[i];
+	table_list.clear();
+
+	for(int t=0; t<n_types; t++)
+		for(int g=0; g<n_gates; g++)
+			tables[t][g] = NULL;
+
+	//Axon functions do not depend on the neuron type.
+	GatingTable * axon[] = {new GatingTable("h_inf",AxonGates::h_inf,step,interp),new GatingTable("tau_h",AxonGates::tau_h,step,interp),
+		new GatingTable("n_inf",AxonGates::n_inf,step,interp),new GatingTable("tau_n",AxonGates::tau_n,step,interp),new GatingTable("m_inf",AxonGates::m_inf,step,interp)};
+	for(int t=0; t<n_types; t++)
+		for(int g=H_INF; g<n_gates; g++)
+			tables[t][g] = axon[g-H_INF];
+	table_list.assign(axon,axon+n_gates-H_INF);
+
+	tables[N1M][P_INF] = new GatingTable("p_inf N1M",NeuronTraits<N1M>::p_inf,step,interp);
+	tables[N2v][P_INF] = new GatingTable("p_inf N2v",NeuronTraits<N2v>::p_inf,step,interp);
+	tables[N2v][TAU_P] = new GatingTable("tau_p N2v",NeuronTraits<N2v>::tau_p,step,interp);
+	tables[N2v][Q_INF] = new GatingTable("q_inf N2v",NeuronTraits<N2v>::q_inf,step,interp);
+	tables[N2v][TAU_Q] = new GatingTable("tau_q N2v",NeuronTraits<N2v>::tau_q,step,interp);
+	tables[N3t][P_INF] = new GatingTable("p_inf N3t",NeuronTraits<N3t>::p_inf,step,interp);
+	tables[N3t][Q_INF] = new GatingTable("q_inf N3t",NeuronTraits<N3t>::q_inf,step,interp);
+	table_list.push_back(tables[N1M][P_INF]);
+	table_list.push_back(tables[N2v][P_INF]);
+	table_list.push_back(tables[N2v][TAU_P]);
+	table_list.push_back(tables[N2v][Q_INF]);
+	table_list.push_back(tables[N2v][TAU_Q]);
+	table_list.push_back(tables[N3t][P_INF]);
+	table_list.push_back(tables[N3t][Q_INF]);
+
+	use_tables = true;
+}
+
+
+double VavoulisModel::tables_error(const char ** worst)
+{
+	double err = 0;
+	for(unsigned int i=0; i<table_list.size(); i++)
+	{
+		double e = table_list[i]->max_error();
+		if(e > err)
+		{
+			err = e;
+			if(worst)
+				*worst = table_list[i]->getName();
+		}
+	}
+	return err;
+}
+
+
 VavoulisModel::VavoulisModel(types neu){
 	type = neu;
 
@@ -24,6 +84,7 @@ VavoulisModel::VavoulisModel(types neu){
 			_variables[v] = -65.0; _variables[va] = -65.0; _variables[p] = p_init_SO; _variables[q] = q_init_SO; _variables[h] = h_init; _variables[n] = n_init; 
 			params[g_ecs]= g_ec_general; params[g_eca] = g_ec_general;
 			
+			set_rhs<SO>();
 			// names[type]="SO";
 			break;
 
@@ -32,6 +93,7 @@ VavoulisModel::VavoulisModel(types neu){
 			_variables[v] = -65.0; _variables[va] = -65.0; _variables[p] = p_init_N1M; _variables[q] = q_init_N1M; _variables[h] = h_init; _variables[n] = n_init; 
 			params[g_ecs]= g_ec_general; params[g_eca] = g_ec_general;
 
+			set_rhs<N1M>();
 			// names[type]="N1M";
 			break;
 
@@ -39,6 +101,7 @@ VavoulisModel::VavoulisModel(types neu){
 			_variables[v] = -65.0; _variables[va] = -65.0; _variables[p] = p_init_N2v; _variables[q] = q_init_N2v; _variables[h] = h_init; _variables[n] = n_init; 
 			params[g_ecs]= g_ecs_N2v; params[g_eca] = g_eca_N2v;
 			
+			set_rhs<N2v>();
 			// names[type]="N2v";
 
 			break;
@@ -48,6 +111,7 @@ VavoulisModel::VavoulisModel(types neu){
 			_variables[v] = -65.0; _variables[va] = -65.0; _variables[p] = p_init_N3t; _variables[q] = q_init_N3t; _variables[h] = h_init; _variables[n] = n_init; 
 			params[g_ecs]= g_ec_general; params[g_eca] = g_ec_general;
 			
+			set_rhs<N3t>();
 			// names[type]="N3t";
 			
 			break;
@@ -55,175 +119,159 @@ VavoulisModel::VavoulisModel(types neu){
 			_variables[v] = -65; _variables[va] = -65; _variables[p] = p_init_SO; _variables[q] = q_init_SO; _variables[h] = h_init; _variables[n] = n_init; 
 			params[g_ecs]= g_ec_general; params[g_eca] = g_ec_general;
 
+			set_rhs<SO>();
 			// names[type]="None";
 			break;
 
 
 	}	
 }
-/////////////////////////////////////////////////////////////////
-//////////// 			SOMA 		///////////////////////
-/////////////////////////////////////////////////////////////////
 
-double VavoulisModel::dp(double _v,double _va,double _p)
-{
-	double p_inf = 0.0;
-	double tau_p = 0.0;
-	switch(type)
-	{
-		case N1M:
-			p_inf = 1 / (1+exp((-38.8 - _v)/10));
-			tau_p = tau_p_N1M;
-			break;
-
-		case N2v:
-			p_inf = 1 / (1+exp((-51 - _v)/10.3));
-			tau_p = 28.3 + 44.1 * exp(-(((-11.8 - _va)/26.6)*((-11.8 - _va)/26.6))); 
-			break;
 
-		case N3t:
-			p_inf = 1 / (1+exp((-61.6 - _v)/5.6));
-			tau_p = tau_p_N3t;
-			break;
-		default:
-			return 0.0;
-	}
+template<int T,bool TABLES>
+void VavoulisModel::rhs(VavoulisModel &neu,const double * vars,double * fvec,double iext,double i_syn,double * tau)
+{
+	typedef NeuronTraits<T> Tr;
+	double _v = vars[v];
+	double _va = vars[va];
 
-	return (p_inf - _p)/tau_p;
-}
+	neu.isyn = i_syn;
 
+	/////////////////////////////////////////////////////////////////
+	//////////// 			SOMA 		///////////////////////
+	/////////////////////////////////////////////////////////////////
 
-double VavoulisModel::dq(double _v,double _va,double _q)
-{
+	double ils = _v + 67;
+	double iecs = Tr::g_ecs *(_v-_va);
+	if(Tr::g_x != 0)
+	{
+		double ix = Tr::g_x * vars[p]*vars[p]*vars[p];
+		if(Tr::has_q)
+			ix = ix*vars[q];
+		ix = ix*(_v-Tr::E_x);
+		neu.dv_value = (iext - ils - ix - iecs - i_syn)/tau_s;
+	}
+	else
+		neu.dv_value = (iext - ils - iecs - i_syn)/tau_s;
+	fvec[v] = neu.dv_value;
 
-	double q_inf = 0.0;
-	double tau_q =0.0;
-	switch(type)
+	if(Tr::has_p)
 	{
-		case N2v:
-			q_inf = 1 / (1+exp((-45-_v)/-3));
-			tau_q = 187.6 + 637.7 * exp(-(((-9.5-_va)/23.3)*(((-9.5-_va)/23.3))));
-			break;
-		case N3t:
-			q_inf = 1 / (1+exp((-73.2-_v)/-5.1));
-			tau_q = tau_q_N3t;
-			break;
-		default:
-			return 0.0;
+		double p_inf = gate<TABLES>(T,P_INF,Tr::p_inf,_v);
+		double tau_p = Tr::tau_p_varies ? gate<TABLES>(T,TAU_P,Tr::tau_p,_va) : Tr::tau_p(_va);
+		fvec[p] = (p_inf - vars[p])/tau_p;
+		if(tau)
+			tau[p] = tau_p;
+	}
+	else
+	{
+		fvec[p] = 0.0;
+		if(tau)
+			tau[p] = 0.0;
 	}
 
-	return (q_inf - _q)/tau_q;
+	if(Tr::has_q)
+	{
+		double q_inf = gate<TABLES>(T,Q_INF,Tr::q_inf,_v);
+		double tau_q = Tr::tau_q_varies ? gate<TABLES>(T,TAU_Q,Tr::tau_q,_va) : Tr::tau_q(_va);
+		fvec[q] = (q_inf - vars[q])/tau_q;
+		if(tau)
+			tau[q] = tau_q;
+	}
+	else
+	{
+		fvec[q] = 0.0;
+		if(tau)
+			tau[q] = 0.0;
+	}
 
-}
+	/////////////////////////////////////////////////////////////////
+	//////////// 			AXON 		///////////////////////
+	/////////////////////////////////////////////////////////////////
 
+	double m = gate<TABLES>(T,M_INF,AxonGates::m_inf,_va);
+	double ina = 350 * m*m*m * vars[h] * (_va-55);
+	double ik = 90 * vars[n]*vars[n]*vars[n]*vars[n] * (_va + 90);
+	double ila = (_va + 67);
+	double ieca = Tr::g_eca * (_va - _v);
+	fvec[va] = (-ila - ina - ik - ieca)/tau_a;
 
-//Channel current based on the current neuron
+	double h_inf = gate<TABLES>(T,H_INF,AxonGates::h_inf,_va);
+	double tau_h = gate<TABLES>(T,TAU_H,AxonGates::tau_h,_va);
+	fvec[h] = (h_inf - vars[h])/tau_h;
 
-double VavoulisModel::Ixs(double _v,double _p,double _q)
-{
+	double n_inf = gate<TABLES>(T,N_INF,AxonGates::n_inf,_va);
+	double tau_n = gate<TABLES>(T,TAU_N,AxonGates::tau_n,_va);
+	fvec[n] = (n_inf - vars[n])/tau_n;
 
-	switch(type)
+	if(tau)
 	{
-		case N1M:
-			// Iach
-			return 200 * _p*_p*_p *(_v+30); 
-		case N2v:
-			// Inal
-			return 2 *_p*_p*_p * _q*(_v-55);
-		case N3t:
-			// It
-			return 3.27 * _p*_p*_p *_q*(_v-80);
-		case SO:
-			return 0.0;
-		default:
-			return 0.0;
-
+		tau[v] = 0.0;
+		tau[va] = 0.0;
+		tau[h] = tau_h;
+		tau[n] = tau_n;
 	}
 }
 
 
-
-//Differential for Soma Voltage
-double VavoulisModel::dvs(double _v,double _va,double _p,double _q, double iext,double isyn)
+void VavoulisModel::diffs_fun(double _time, vector<double> &vars, vector<double> &fvec, double iext,double i_syn)
 {
-
-	double ils = _v + 67;
-	double ix = Ixs(_v,_p,_q);
-	double iecs = params[g_ecs] *(_v-_va);
-	
-	dv_value = (iext - ils - ix - iecs - isyn)/tau_s;
-
-
-	return (iext - ils - ix - iecs - isyn)/tau_s;
+	diffs_fun(_time,vars.data(),fvec.data(),iext,i_syn);
 }
 
 
-/////////////////////////////////////////////////////////////////
-//////////// 			AXON 		///////////////////////
-/////////////////////////////////////////////////////////////////
-
-double VavoulisModel::dh(double _va,double _h)
-{
-	double h_inf = 1/(1 + exp((-55.2 - _va)/-7.1));
-	double tau_h = 1.1 + 7.2 * exp(-(pow(((-61.3 - _va)/22.7),2)));
-	return (h_inf - _h)/tau_h;
-
+void VavoulisModel::diffs_fun(double _time, const double * vars, double * fvec, double iext,double i_syn)
+{	
+	rhs_ptr[use_tables](*this,vars,fvec,iext,i_syn,NULL);
 }
 
-double VavoulisModel::dn(double _va,double _n)
-{
-	double n_inf = 1/(1 + exp((-30 - _va)/17.4));
-	double tau_n = 1.1 + 4.6 * exp(-(pow(((-61 - _va)/54.3),2)));
-	return (n_inf - _n)/tau_n;
 
+void VavoulisModel::diffs_fun(double _time, const double * vars, double * fvec, double iext,double i_syn,double * tau)
+{	
+	rhs_ptr[use_tables](*this,vars,fvec,iext,i_syn,tau);
 }
 
 
-double VavoulisModel::Ina (double _va,double _h)
-{
-	double m = 1/(1+exp((-34.6-_va)/9.6));
-	double inaT = 350 * m*m*m * _h * (_va-55);
-	return inaT;
-}
 
 
-double VavoulisModel::Ik (double _va,double _n)
+/*!
+* @brief Calls to exp in one evaluation of rhs<T> with exact gating functions: 5 axon functions, p_inf and q_inf and the voltage dependent time constants.
+*/
+template<int T>
+static int rhs_exps()
 {
-	double ik = 90 * _n*_n*_n*_n * (_va + 90);
-	return ik;
+	typedef NeuronTraits<T> Tr;
+	return 5 + Tr::has_p*(1+Tr::tau_p_varies) + Tr::has_q*(1+Tr::tau_q_varies);
 }
 
 
-//Differential for Axon Voltage
-double VavoulisModel::dva(double _v,double _va,double _h,double _n)
+int VavoulisModel::getNExp()
 {
-	double ila = (_va + 67);
-	double ina = Ina(_va,_h);
-	double ik = Ik(_va,_n);
-	double ieca = params[g_eca] * (_va - _v);
-
+	if(use_tables)
+		return 0;
 
-	return (-ila - ina - ik - ieca)/tau_a;
+	switch(type)
+	{
+		case N1M: return rhs_exps<N1M>();
+		case N2v: return rhs_exps<N2v>();
+		case N3t: return rhs_exps<N3t>();
+		default: return rhs_exps<SO>();
+	}
 }
 
 
-void VavoulisModel::diffs_fun(double _time, vector<double> &vars, vector<double> &fvec, double iext,double i_syn)
-{	
-	this->isyn=i_syn;
-
-	fvec[v] = dvs(vars[v],vars[va],vars[p],vars[q],iext,i_syn); 
-	fvec[p] = dp(vars[v],vars[va],vars[p]);
-	fvec[q] = dq(vars[v],vars[va],vars[q]);
-	fvec[va] = dva(vars[v],vars[va],vars[h],vars[n]);
-	fvec[h] = dh(vars[va],vars[h]);
-	fvec[n] = dn(vars[va],vars[n]);
-
-   return;
+int VavoulisModel::getNGated()
+{
+	switch(type)
+	{
+		case N1M: return 2 + NeuronTraits<N1M>::has_p + NeuronTraits<N1M>::has_q;
+		case N2v: return 2 + NeuronTraits<N2v>::has_p + NeuronTraits<N2v>::has_q;
+		case N3t: return 2 + NeuronTraits<N3t>::has_p + NeuronTraits<N3t>::has_q;
+		default: return 2 + NeuronTraits<SO>::has_p + NeuronTraits<SO>::has_q;
+	}
 }
 
 
-
-
 const char * VavoulisModel::getName()
 {
 	return names[type];
@@ -235,6 +283,14 @@ std::vector<double> VavoulisModel::getVariables()
 	return v;
 }
 
+void VavoulisModel::getVariables(double * vars)
+{
+	for (int i = 0; i < n_variables; ++i)
+	{
+		vars[i]=_variables[i];
+	}
+}
+
 
 
 void VavoulisModel::set_variables(const std::vector<double> &v)
@@ -245,15 +301,22 @@ void VavoulisModel::set_variables(const std::vector<double> &v)
 	}
 }
 
+void VavoulisModel::set_variables(const double * v)
+{
+	for (int i = 0; i < n_variables; ++i)
+	{
+		_variables[i]=v[i];
+	}
+}
+
 
 
 
 void VavoulisModel::update_variables(double dt, double time, double iext,double i_syn)
 {
-	std::vector<double>  fvec(n_variables);
-	std::vector<double> vars(_variables,_variables+n_variables);
+	double fvec[n_variables];
 
-	diffs_fun(time,vars,fvec,iext, i_syn);
+	diffs_fun(time,_variables,fvec,iext, i_syn);
 
 	for (int i = 0; i < n_variables; ++i)
 	{
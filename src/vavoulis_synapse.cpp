@@ -12,6 +12,17 @@
 #include <iostream>
 using namespace std;
 
+static double r_inf(double _vpre){return 1/(1 + exp((-40 - _vpre)/2.5));}
+
+GatingTable * VavoulisSynapse::r_table = NULL;
+
+
+void VavoulisSynapse::build_tables(GatingTable::interpolations interp,double step)
+{
+	delete r_table;
+	r_table = new GatingTable("r_inf",r_inf,step,interp);
+}
+
 VavoulisSynapse::VavoulisSynapse(VavoulisModel *n1, VavoulisModel* n2,double _conduc_syn,double _activation_syn,double _Esyn)
 {
 	pos = n1;
@@ -27,6 +38,21 @@ VavoulisSynapse::VavoulisSynapse(VavoulisModel *n1, VavoulisModel* n2,double _co
 }
 
 
+VavoulisSynapse::VavoulisSynapse(int pre,double _conduc_syn,double _activation_syn,double _Esyn)
+{
+	pos = 0;
+	this->pre = 0;
+	params[conduc_syn] = _conduc_syn;
+	params[activation_syn] = _activation_syn;
+	params[Esyn] = _Esyn;
+
+	_variables[s] = s_init;
+	_variables[r] = r_init;
+
+	pre_type = pre;
+}
+
+
 VavoulisSynapse::VavoulisSynapse()
 {
 	pos = 0;
@@ -56,8 +82,8 @@ void VavoulisSynapse::setSynapse(VavoulisModel *n1, VavoulisModel* n2,double _co
 
 double VavoulisSynapse::dr(double _vpre,double _r)
 {
-	double r_inf = 1/(1 + exp((-40 - _vpre)/2.5));
-	double r_value = (r_inf - _r)/params[activation_syn];
+	double r_inf_v = r_table ? (*r_table)(_vpre) : r_inf(_vpre);
+	double r_value = (r_inf_v - _r)/params[activation_syn];
 	return r_value;
 }
 
@@ -72,6 +98,11 @@ double VavoulisSynapse::Isyn(const vector<double> &variables,double v)
 	return params[conduc_syn] * variables[s] * (v - params[Esyn]);
 }
 
+double VavoulisSynapse::Isyn(const double * variables,double v)
+{
+	return params[conduc_syn] * variables[s] * (v - params[Esyn]);
+}
+
 double VavoulisSynapse::Isyn(double v)
 {
 	return params[conduc_syn] * _variables[s] * (v - params[Esyn]);
@@ -86,6 +117,11 @@ double VavoulisSynapse::Isyn()
 
 
 void VavoulisSynapse::diffs_fun(double time, const std::vector<double> & vars, std::vector<double> &fvec, double vpre)
+{
+	diffs_fun(time,vars.data(),fvec.data(),vpre);
+}
+
+void VavoulisSynapse::diffs_fun(double time, const double * vars, double * fvec, double vpre)
 {
 	fvec[s] = ds(vars[r],vars[s]); 
 	fvec[r] = dr(vpre,vars[r]);
@@ -93,6 +129,13 @@ void VavoulisSynapse::diffs_fun(double time, const std::vector<double> & vars, s
    return;
 }
 
+void VavoulisSynapse::diffs_fun(double time, const double * vars, double * fvec, double vpre,double * tau)
+{
+	diffs_fun(time,vars,fvec,vpre);
+	tau[s] = params[activation_syn];
+	tau[r] = params[activation_syn];
+}
+
 void VavoulisSynapse::diffs_fun(double time, std::vector<double> &fvec, double vpre)
 {
 	fvec[s] = ds(_variables[r],_variables[s]); 
@@ -107,6 +150,14 @@ std::vector<double> VavoulisSynapse::getVariables()
 	return v;
 }
 
+void VavoulisSynapse::getVariables(double * vars)
+{
+	for (int i = 0; i < n_variables; ++i)
+	{
+		vars[i]=_variables[i];
+	}
+}
+
 void VavoulisSynapse::set_variables(const std::vector<double>& v)
 {
 	// cout <<"N_VARS"<< " "<<  n_variables<<endl;
@@ -116,12 +167,19 @@ void VavoulisSynapse::set_variables(const std::vector<double>& v)
 	}
 }
 
+void VavoulisSynapse::set_variables(const double * v)
+{
+	for (int i = 0; i < n_variables; ++i)
+	{
+		_variables[i]=v[i];
+	}
+}
+
 void VavoulisSynapse::update_variables(double dt, double time, double vpre)
 {
-	std::vector<double>  fvec(n_variables);
-	std::vector<double> vars(_variables,_variables+n_variables);
+	double fvec[n_variables];
 
-	diffs_fun(time,vars,fvec,vpre);
+	diffs_fun(time,_variables,fvec,vpre);
 
 	for (int i = 0; i < n_variables; ++i)
 	{
@@ -146,6 +204,11 @@ void VavoulisSynapse::print_params()
 
 void VavoulisSynapse::print()
 {
+	if(!pos || !pre)
+	{
+		cout << "\tPre: " << pre_type << " Params: "; print_params(); cout << endl;
+		return;
+	}
 	cout << "\tPos: ";
 	pos->print(); cout<< endl;
 	cout << "\tPre: "; pre->print();  cout<< endl;
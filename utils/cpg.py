@@ -0,0 +1,188 @@
+# Developed by Alicia Garrido Peña (2020)
+#
+# Python bindings of the Lymnaea CPG Simulator Model shared library (make lib).
+#
+# Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+# and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+#
+# Please, if you use this implementation cite the two papers above in your work. 
+############################################################################################
+#
+# Usage:
+#	from cpg import Simulator
+#	sim = Simulator(connection=3,currents=(8.5,6,2,0),integrator='e',dt=0.001)
+#	sim.step(secs=1)                 (transient, no output)
+#	res = sim.run(secs=10)
+#	res.v[:,sim.index('N1M')], res.t, res.spikes['t'][res.spikes['neuron']==1]
+#	sim.set_currents((8.5,0,2,25)); res2 = sim.run(secs=10)   (continues from the end of the previous run)
+#
+# Samples and spikes are written by the library straight into numpy arrays, which are returned without copying.
+# Arrays can also be given with out=(t,v,c) to reuse them between runs. The library is ../libcpg.so or the path in CPG_LIB.
+
+import os
+import ctypes
+import numpy as np
+
+INTEGRATORS = {'e':0,'r':1,'x':3,'xm':4,'s':5} #Fixed step integrators with the -integrator names
+OUT_DECIMATION = 4
+
+_lib = None
+
+def load_library(path=None):
+	global _lib
+	if _lib is not None:
+		return _lib
+	if path is None:
+		path = os.environ.get('CPG_LIB',os.path.join(os.path.dirname(os.path.abspath(__file__)),'..','libcpg.so'))
+	lib = ctypes.CDLL(path)
+
+	c_double_p = ctypes.POINTER(ctypes.c_double)
+	c_long_p = ctypes.POINTER(ctypes.c_long)
+	c_int_p = ctypes.POINTER(ctypes.c_int)
+	lib.cpg_create.restype = ctypes.c_void_p
+	lib.cpg_create.argtypes = [ctypes.c_int,c_double_p,ctypes.c_double,ctypes.c_double,ctypes.c_double,ctypes.c_double]
+	lib.cpg_create_network.restype = ctypes.c_void_p
+	lib.cpg_create_network.argtypes = [ctypes.c_char_p]
+	lib.cpg_destroy.argtypes = [ctypes.c_void_p]
+	lib.cpg_n_neurons.argtypes = [ctypes.c_void_p]
+	lib.cpg_neuron_name.restype = ctypes.c_char_p
+	lib.cpg_neuron_name.argtypes = [ctypes.c_void_p,ctypes.c_int]
+	lib.cpg_configure.argtypes = [ctypes.c_void_p,ctypes.c_int,ctypes.c_double]
+	lib.cpg_set_threads.argtypes = [ctypes.c_void_p,ctypes.c_int]
+	lib.cpg_set_currents.argtypes = [ctypes.c_void_p,c_double_p,ctypes.c_int]
+	lib.cpg_load_protocol.argtypes = [ctypes.c_void_p,ctypes.c_char_p]
+	lib.cpg_use_gating_tables.restype = ctypes.c_double
+	lib.cpg_use_gating_tables.argtypes = [ctypes.c_int,ctypes.c_double]
+	lib.cpg_time.restype = ctypes.c_double
+	lib.cpg_time.argtypes = [ctypes.c_void_p]
+	lib.cpg_step.restype = ctypes.c_long
+	lib.cpg_step.argtypes = [ctypes.c_void_p,ctypes.c_long]
+	lib.cpg_run.restype = ctypes.c_long
+	lib.cpg_run.argtypes = [ctypes.c_void_p,ctypes.c_long,ctypes.c_int,c_double_p,c_double_p,c_double_p,ctypes.c_long,c_long_p,
+		c_double_p,c_double_p,c_int_p,ctypes.c_long,c_long_p]
+	_lib = lib
+	return lib
+
+def _ptr(a,ctype):
+	#Pointer to the data of a contiguous array of the right type, NULL for None.
+	if a is None:
+		return None
+	if not a.flags['C_CONTIGUOUS'] or not a.flags['WRITEABLE']:
+		raise ValueError("Buffers must be C contiguous and writeable")
+	return a.ctypes.data_as(ctypes.POINTER(ctype))
+
+def use_gating_tables(cubic=True,step=0.05):
+	return load_library().cpg_use_gating_tables(int(cubic),step)
+
+class Result:
+	#Samples (t, v with one column per neuron, c) and spikes (dict of arrays t, v, neuron) of a run, views of the buffers.
+	def __init__(self,t,v,c,spikes,names):
+		self.t = t
+		self.v = v
+		self.c = c
+		self.spikes = spikes
+		self.names = names
+
+	def __getitem__(self,name):
+		return self.v[:,self.names.index(name)]
+
+class Simulator:
+	def __init__(self,connection=3,currents=(8.5,6,2,0),ramp=None,network=None,integrator='e',dt=0.01,threads=0,lib=None):
+		#ramp: (min_c, max_c, stim_inc, stim_dur in ms) for the -1 current.
+		self.lib = load_library(lib)
+		if network is not None:
+			h = self.lib.cpg_create_network(network.encode())
+		else:
+			c = np.ascontiguousarray(currents,dtype=np.float64)
+			if len(c) != 4:
+				raise ValueError("4 currents expected (SO, N1M, N2v, N3t)")
+			r = ramp if ramp is not None else (-1,-1,-1,-1)
+			h = self.lib.cpg_create(connection,_ptr(c,ctypes.c_double),*r)
+		if not h:
+			raise RuntimeError("Can not create the simulator")
+		self.h = ctypes.c_void_p(h)
+		self.n_neurons = self.lib.cpg_n_neurons(self.h)
+		self.names = [self.lib.cpg_neuron_name(self.h,i).decode() for i in range(self.n_neurons)]
+		self.configure(integrator,dt)
+		if threads:
+			self.set_threads(threads)
+
+	def __del__(self):
+		if getattr(self,'h',None) is not None:
+			self.lib.cpg_destroy(self.h)
+			self.h = None
+
+	def configure(self,integrator,dt):
+		m = INTEGRATORS.get(integrator.lstrip('-'))
+		if m is None or self.lib.cpg_configure(self.h,m,dt) < 0:
+			raise ValueError("Integrator %s with dt %g not supported, fixed step integrators: %s"%(integrator,dt,list(INTEGRATORS)))
+		self.dt = dt
+
+	def set_threads(self,n):
+		if self.lib.cpg_set_threads(self.h,n) < 0:
+			raise RuntimeError("Can not start %d threads"%n)
+
+	def set_currents(self,currents):
+		c = np.ascontiguousarray(currents,dtype=np.float64)
+		if self.lib.cpg_set_currents(self.h,_ptr(c,ctypes.c_double),len(c)) < 0:
+			raise ValueError("%d currents expected"%self.n_neurons)
+
+	def load_protocol(self,file):
+		if self.lib.cpg_load_protocol(self.h,file.encode()) < 0:
+			raise ValueError("Can not load protocol "+file)
+
+	def index(self,name):
+		return self.names.index(name)
+
+	@property
+	def time(self):
+		return self.lib.cpg_time(self.h)
+
+	def _steps(self,secs,steps):
+		if steps is None:
+			steps = int(round(secs*1000/self.dt))
+		return steps
+
+	def step(self,secs=None,steps=None):
+		steps = self._steps(secs,steps)
+		if self.lib.cpg_step(self.h,steps) < 0:
+			raise RuntimeError("Simulation error")
+
+	def run(self,secs=None,steps=None,decimation=OUT_DECIMATION,out=None,max_spikes=None):
+		steps = self._steps(secs,steps)
+		n_max = -(-steps//decimation)
+		if out is None:
+			t = np.empty(n_max)
+			v = np.empty((n_max,self.n_neurons))
+			c = np.empty(n_max)
+		else:
+			t,v,c = out
+			if len(t) < n_max or v.shape[0] < n_max or v.shape[1] != self.n_neurons or len(c) < n_max:
+				raise ValueError("Buffers too small, %d samples of %d neurons needed"%(n_max,self.n_neurons))
+		if max_spikes is None:
+			#100 Hz in every neuron is above the fastest firing of the model. Pages not written are never allocated.
+			max_spikes = self.n_neurons*(int(steps*self.dt/10)+1)
+		spike_t = np.empty(max_spikes)
+		spike_v = np.empty(max_spikes)
+		spike_n = np.empty(max_spikes,dtype=np.int32)
+
+		n_samples = ctypes.c_long(0)
+		n_spikes = ctypes.c_long(0)
+		done = self.lib.cpg_run(self.h,steps,decimation,_ptr(t,ctypes.c_double),_ptr(v,ctypes.c_double),_ptr(c,ctypes.c_double),n_max,
+			ctypes.byref(n_samples),_ptr(spike_t,ctypes.c_double),_ptr(spike_v,ctypes.c_double),_ptr(spike_n,ctypes.c_int),max_spikes,ctypes.byref(n_spikes))
+		if done < 0:
+			raise RuntimeError("Simulation error")
+		if n_spikes.value > max_spikes:
+			raise RuntimeError("%d spikes detected, only %d fit in the buffer (max_spikes)"%(n_spikes.value,max_spikes))
+
+		k = n_spikes.value
+		spikes = {'t':spike_t[:k],'v':spike_v[:k],'neuron':spike_n[:k]}
+		s = n_samples.value
+		return Result(t[:s],v[:s],c[:s],spikes,self.names)
+
+if __name__ == "__main__":
+	sim = Simulator(connection=3,currents=(8.5,6,2,0),integrator='e',dt=0.001)
+	res = sim.run(secs=5)
+	print(len(res.t),"samples",len(res.spikes['t']),"spikes until",sim.time,"ms")
+	for i,name in enumerate(sim.names):
+		print(name,np.count_nonzero(res.spikes['neuron']==i),"spikes")
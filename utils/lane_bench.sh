@@ -0,0 +1,35 @@
+#!/bin/bash
+# Throughput of the CPGEnsemble kernels against the vector width (x86, gcc).
+# Usage: sh ./utils/lane_bench.sh [min_time]
+# cpg_bench is built with the ensemble flags (CSIMD in the Makefile) limited to 1 lane (no vectorization), 2 (128 bits), 4 (256 bits)
+# and, if the processor has AVX-512, 8 lanes (512 bits). The ensemble benchmarks of 256 instances are run with each build.
+# ./cpg_bench is rebuilt with the default flags at the end.
+
+min_time=${1:-0.5}
+csimd="-O3 -march=native -ffp-contract=off"
+
+dir=`mktemp -d`
+widths="0 128 256"
+grep -q avx512f /proc/cpuinfo && widths="$widths 512"
+
+for w in $widths
+do
+	if [ $w = 0 ]; then flags="$csimd -fno-tree-vectorize"; else flags="$csimd -mprefer-vector-width=$w"; fi
+	make -s -B benchmark COPT="$flags" >/dev/null 2>&1 || { echo "Error: build with $flags failed"; rm -rf $dir; exit 1; }
+	./cpg_bench -min_time $min_time -filter CPGEnsemble | awk '/n256/{print $1,$4}' > $dir/$w
+done
+
+echo "CPGEnsemble, 256 instances, instance steps per second"
+printf "%-6s %-6s %14s %8s %14s %8s\n" lanes bits euler speedup runge speedup
+for w in $widths
+do
+	lanes=$((w/64)); [ $w = 0 ] && lanes=1
+	awk -v lanes=$lanes -v bits=$w -v base=$dir/0 '
+		BEGIN{while((getline l < base) > 0){split(l,a," "); b[a[1]]=a[2]}}
+		{v[$1]=$2; s[$1]=$2/b[$1]}
+		END{e="CPGEnsemble::update_euler/n256"; r="CPGEnsemble::update_runge/n256";
+			printf "%-6d %-6s %14.0f %8.2f %14.0f %8.2f\n",lanes,bits?bits:"-",v[e],s[e],v[r],s[r]}' $dir/$w
+done
+
+make -s -B benchmark >/dev/null 2>&1
+rm -rf $dir
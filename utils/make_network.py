@@ -0,0 +1,54 @@
+# Developed by Alicia Garrido Peña (2020)
+#
+# Network file generator for feeding_cpg -network: copies of the feeding CPG coupled by random synapses.
+#
+# Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+# and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+#
+# Please, if you use this implementation cite the two papers above in your work.
+############################################################################################
+#
+# Usage:
+#	python3 make_network.py n_circuits [-coupling k] [-g g] [-c c_so c_n1m c_n2v c_n3t] [-jitter j] [-seed s] > net.txt
+#
+# Each circuit has the 4 neurons and 8 synapses of the complete feeding CPG (connection 3), named SO_<i>, N1M_<i>...
+# Each neuron also receives k fast inhibitory synapses of conductance g from neurons of other circuits chosen at random.
+# Injected currents are c multiplied by a random factor in [1-j,1+j] for each circuit.
+
+import sys
+import random
+import argparse
+
+CIRCUIT = [("SO","N1M",4.0,"slow","excit"),("SO","N2v",1.0,"slow","excit"),("N2v","SO",8.0,"fast","inhib"),
+	("N3t","N1M",8.0,"fast","inhib"),("N1M","N3t",0.5,"fast","inhib"),("N2v","N3t",2.0,"fast","inhib"),
+	("N2v","N1M",50.0,"fast","inhib"),("N1M","N2v",0.077,"slow","excit")]
+TYPES = ["SO","N1M","N2v","N3t"]
+
+ap = argparse.ArgumentParser(description="Generates a network file for feeding_cpg -network")
+ap.add_argument("n_circuits",type=int)
+ap.add_argument("-coupling",type=int,default=2,help="random synapses received by each neuron from other circuits")
+ap.add_argument("-g",type=float,default=0.05,help="conductance of the random synapses")
+ap.add_argument("-c",type=float,nargs=4,default=[8.5,6,2,0],help="currents of SO N1M N2v N3t")
+ap.add_argument("-jitter",type=float,default=0.1,help="relative variation of the currents between circuits")
+ap.add_argument("-seed",type=int,default=0)
+args = ap.parse_args()
+
+random.seed(args.seed)
+n = args.n_circuits
+out = sys.stdout
+
+out.write("# %d feeding circuits, coupling %d g %g seed %d\n"%(n,args.coupling,args.g,args.seed))
+for i in range(n):
+	factor = 1+random.uniform(-args.jitter,args.jitter)
+	for t,c in zip(TYPES,args.c):
+		out.write("neuron %s_%d %s %g\n"%(t,i,t,c*factor if c != -1 else -1))
+
+for i in range(n):
+	for pre,post,g,tau,E in CIRCUIT:
+		out.write("synapse %s_%d %s_%d %g %s %s\n"%(pre,i,post,i,g,tau,E))
+	if n > 1:
+		for post in TYPES:
+			for k in range(args.coupling):
+				j = random.randrange(n-1)
+				j += j >= i
+				out.write("synapse %s_%d %s_%d %g fast inhib\n"%(random.choice(TYPES),j,post,i,args.g))
@@ -29,12 +29,17 @@ print("Ploting file from ",file_name)
 path = path+file_name
 
 
-f = open(path)
-headers = f.readline().split()
+if path.endswith((".bin",".dlt")):
+	from read_bin import load_trace
+	trace, header = load_trace(path)
+	headers = list(trace.dtype.names)
+	data = pd.DataFrame(trace)
+else:
+	f = open(path)
+	headers = f.readline().split()
+	f.close()
+	data = pd.read_csv(path, delimiter = " ", names=headers,skiprows=1,low_memory=False)
 print(headers)
-f.close()
-
-data = pd.read_csv(path, delimiter = " ", names=headers,skiprows=1,low_memory=False)
 
 rows = data.shape[1]
 
@@ -30,27 +30,44 @@ print("Ploting file from ",path)
 path = path+file_name
 
 #Parsing name, in case it does not contain spikes_ string.
-try:
-	idx = path.index("Euler")
-except:
-	idx = path.index("Runge")
+for method in ["Euler","Runge","Adaptive"]:
+	idx = path.rfind(method)
+	if idx != -1:
+		break
 
 path_spk = path[:idx] + "spikes_" + path[idx:]
+#Spikes file format does not depend on the trace format
+for ext in (".asc",".bin"):
+	if not os.path.exists(path_spk):
+		path_spk = path_spk[:-4] + ext
 
 print(path_spk)
 
-
-f = open(path)
-f_spk = open(path_spk)
-no_spike_value = float(f_spk.readline())
-headers = f.readline().split()
-headers_spk = f_spk.readline().split()
+if path.endswith((".bin",".dlt")):
+	from read_bin import load_trace
+	trace, header = load_trace(path)
+	headers = list(trace.dtype.names)
+	data = pd.DataFrame(trace)
+else:
+	f = open(path)
+	headers = f.readline().split()
+	f.close()
+	data = pd.read_csv(path, delimiter = " ", names=headers,skiprows=1,low_memory=False)
 print(headers)
-f_spk.close()
-f.close()
 
-data = pd.read_csv(path, delimiter = " ", names=headers,skiprows=1,low_memory=False)
-spikes = pd.read_csv(path_spk, delimiter = " ", names=headers_spk,skiprows=2,low_memory=False,na_values=",")
+if path_spk.endswith(".bin"):
+	from read_bin import load_spikes
+	spk, header_spk = load_spikes(path_spk)
+	#Same layout as the ascii file: one column per neuron, NaN where the neuron does not spike.
+	spikes = pd.DataFrame({'t':spk['t']})
+	for i,name in enumerate(header_spk['neurons']):
+		spikes[name] = np.where(spk['neuron']==i,spk['v'],np.nan)
+else:
+	f_spk = open(path_spk)
+	no_spike_value = float(f_spk.readline())
+	headers_spk = f_spk.readline().split()
+	f_spk.close()
+	spikes = pd.read_csv(path_spk, delimiter = " ", names=headers_spk,skiprows=2,low_memory=False,na_values=",")
 
 
 rows = data.shape[1]
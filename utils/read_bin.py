@@ -0,0 +1,118 @@
+# Developed by Alicia Garrido Peña (2020)
+#
+# Reader for binary trace and spikes files of Lymnaea CPG Simulator Model (-format bin/bin64/delta, -spikes_format bin). 
+#
+# Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+# and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+#
+# Please, if you use this implementation cite the two papers above in your work. 
+############################################################################################
+#
+# Usage:
+#	from read_bin import load_trace
+#	data, header = load_trace(path)
+#	data['N1M'], data['t']   (numpy arrays mapped from the file, no copy; delta files are decoded in memory)
+#	from read_bin import load_spikes
+#	spikes, header = load_spikes(path)
+#	spikes['t'][spikes['neuron']==1]   (N1M spike times, neurons order in header['neurons'])
+#
+# File layout: text header "key value" lines padded with spaces to header_size bytes,
+# followed by fixed-width little-endian records described in the columns line.
+# Delta files (magic CPGDELTA) have blocks instead of records: uint32 records, uint32 bytes and the varints of the zigzag
+# second differences of each column (see include/trace_codec.h).
+
+import os
+import sys
+import numpy as np
+
+MAGIC = "CPGTRACE"
+SPIKES_MAGIC = "CPGSPIKES"
+DELTA_MAGIC = "CPGDELTA"
+
+def read_header(path):
+	with open(path,'rb') as f:
+		first = f.readline().decode().split()
+		if len(first) != 2 or first[0] not in (MAGIC,SPIKES_MAGIC,DELTA_MAGIC):
+			raise ValueError("Not a binary trace or spikes file: "+path)
+		key,size = f.readline().decode().split()
+		f.seek(0)
+		text = f.read(int(size)).decode()
+
+	header = {'type':first[0],'version':int(first[1])}
+	for line in text.split('\n')[1:]:
+		parts = line.split()
+		if len(parts) < 2:
+			continue
+		if parts[0] == 'columns':
+			header['columns'] = [tuple(c.split(':')) for c in parts[1:]]
+		elif parts[0] == 'neurons':
+			header['neurons'] = parts[1:]
+		else:
+			try:
+				header[parts[0]] = float(parts[1]) if '.' in parts[1] or 'e' in parts[1] else int(parts[1])
+			except ValueError:
+				header[parts[0]] = parts[1]
+	return header
+
+def decode_varints(b):
+	#LEB128: the last byte of each value is the one below 0x80.
+	b = b.astype(np.uint64)
+	ends = np.flatnonzero(b < 0x80)
+	starts = np.concatenate(([0],ends[:-1]+1))
+	lens = ends-starts+1
+	vals = np.zeros(len(ends),dtype=np.uint64)
+	for j in range(lens.max() if len(lens) else 0):
+		m = lens > j
+		vals[m] |= (b[starts[m]+j] & np.uint64(0x7f)) << np.uint64(7*j)
+	return vals
+
+def load_delta(path):
+	header = read_header(path)
+	names = [c[0] for c in header['columns']]
+	n_cols = len(names)
+	res = header['resolution']
+	raw = np.fromfile(path,dtype=np.uint8,offset=header['header_size'])
+
+	blocks = []
+	pos = 0
+	#Incomplete last block (interrupted simulation) is ignored.
+	while pos+8 <= len(raw):
+		n_recs,n_bytes = np.frombuffer(raw[pos:pos+8].tobytes(),dtype='<u4')
+		if pos+8+n_bytes > len(raw):
+			break
+		z = decode_varints(raw[pos+8:pos+8+n_bytes]).reshape(n_cols,n_recs)
+		r = ((z >> np.uint64(1)) ^ (np.uint64(0)-(z & np.uint64(1)))).view(np.int64)
+		with np.errstate(over='ignore'):
+			q = np.cumsum(np.cumsum(r,axis=1),axis=1)
+		blocks.append(q)
+		pos += 8+int(n_bytes)
+
+	q = np.concatenate(blocks,axis=1) if blocks else np.zeros((n_cols,0),dtype=np.int64)
+	data = np.empty(q.shape[1],dtype=[(name,'<f8') for name in names])
+	data[names[0]] = q[0].view(np.float64)
+	for c in range(1,n_cols):
+		data[names[c]] = q[c]*res if res > 0 else q[c].view(np.float64)
+	return data, header
+
+def load_trace(path):
+	header = read_header(path)
+	if header['type'] == DELTA_MAGIC:
+		return load_delta(path)
+	dtype = np.dtype([(name,'<'+t) for name,t in header['columns']])
+	#Incomplete last record (interrupted simulation) is ignored.
+	n_records = (os.path.getsize(path)-header['header_size'])//dtype.itemsize
+	data = np.memmap(path,dtype=dtype,mode='r',offset=header['header_size'],shape=(n_records,))
+	return data, header
+
+def load_spikes(path):
+	#Same layout as traces, one record per spike.
+	return load_trace(path)
+
+if __name__ == "__main__":
+	if len(sys.argv) < 2:
+		print("Format: read_bin.py <file>")
+		exit()
+	data, header = load_trace(sys.argv[1])
+	print(header)
+	print(len(data),"records")
+	print(data[:5])
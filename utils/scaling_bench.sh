@@ -0,0 +1,31 @@
+#!/bin/bash
+# Strong scaling of the parallel stepping (feeding_cpg -threads) from 1 to all cores.
+# Usage: sh ./utils/scaling_bench.sh [n_circuits] [secs_dur] [integrator] [max_threads]
+# A network of n_circuits coupled feeding CPGs (4 neurons each) is generated with make_network.py and simulated
+# without threads and with 1..max_threads threads. Output is written in binary to /tmp and removed.
+
+circuits=${1:-250}
+secs=${2:-0.2}
+integrator=${3:-r}
+max_threads=${4:-`nproc`}
+
+dir=`mktemp -d`
+net=$dir/bench.net
+python3 ./utils/make_network.py $circuits > $net || exit 1
+
+run()
+{
+	./feeding_cpg -network $net -file_name $dir/out -integrator -$integrator -dt 0.01 -secs_dur $secs -format bin -spikes_format bin $1 | awk '/Wall time/{print $3}'
+}
+
+echo "Network: $((circuits*4)) neurons, integrator -$integrator, $secs s, dt 0.01, $(nproc) processors"
+serial=`run ""`
+printf "%-8s %10s %8s %10s\n" threads wall_s speedup efficiency
+printf "%-8s %10.3f\n" serial $serial
+for t in `seq 1 $max_threads`
+do
+	wall=`run "-threads $t"`
+	awk -v t=$t -v w=$wall -v s=$serial 'BEGIN{printf "%-8d %10.3f %8.2f %10.2f\n",t,w,s/w,s/w/t}'
+done
+
+rm -rf $dir
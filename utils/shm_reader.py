@@ -0,0 +1,113 @@
+# Developed by Alicia Garrido Peña (2020)
+#
+# Reader of the live trace published in shared memory by feeding_cpg -shm name (see include/shm_stream.h for the layout).
+#
+# Implementation of the Lymnaea feeding CPG originally proposed by Vavoulis et al. (2007). Dynamic control of a central pattern generator circuit: A computational model of the snail feeding network. European Journal of Neuroscience, 25(9), 2805–2818. https://doi.org/10.1111/j.1460-9568.2007.05517.x
+# and used in study of dynamical invaraiants in Alicia Garrido-Peña, Irene Elices and Pablo Varona (2020). Characterization of interval variability in the sequential activity of a central pattern generator model. Neurocomputing 2020.
+#
+# Please, if you use this implementation cite the two papers above in your work. 
+############################################################################################
+#
+# Usage:
+#	from shm_reader import ShmReader
+#	r = ShmReader('/cpg')                  (while feeding_cpg -shm /cpg ... is running)
+#	recs = r.read_records()                (new records, one row "t V... c" per record, columns in r.columns)
+#	spikes = r.read_spikes()               (new spike events, fields t, v and neuron)
+#	r.finished, r.lost_records, r.lost_spikes
+#
+#	python3 shm_reader.py /cpg [seconds]   live plot of the last seconds of every neuron (needs matplotlib)
+
+import sys
+import mmap
+import numpy as np
+
+MAGIC = b'CPGSHM'
+VERSION = 1
+SPIKE_DTYPE = np.dtype([('t','<f8'),('v','<f8'),('neuron','<i4'),('pad','<i4')])
+
+
+class ShmReader:
+	def __init__(self,name,from_start=False):
+		with open('/dev/shm/'+name.lstrip('/'),'rb') as f:
+			self._map = mmap.mmap(f.fileno(),0,access=mmap.ACCESS_READ)
+		buf = memoryview(self._map)
+		if bytes(buf[0:6]) != MAGIC or np.frombuffer(buf,'<u4',1,8)[0] != VERSION:
+			raise ValueError('%s is not a CPG shared memory trace'%name)
+
+		self.n_cols = int(np.frombuffer(buf,'<u4',1,12)[0])
+		rec_cap,spk_cap,rec_off,spk_off = [int(x) for x in np.frombuffer(buf,'<u8',4,16)]
+		self.dt = float(np.frombuffer(buf,'<f8',1,48)[0])
+		self.decimation = int(np.frombuffer(buf,'<u4',1,56)[0])
+		self._state = np.frombuffer(buf,'<u4',1,60)
+		self._rec_seq = np.frombuffer(buf,'<u8',1,64)
+		self._spk_seq = np.frombuffer(buf,'<u8',1,128)
+		self.columns = bytes(buf[192:192+1024]).split(b'\0')[0].decode().split()
+
+		self._recs = np.frombuffer(buf,'<f8',rec_cap*self.n_cols,rec_off).reshape(rec_cap,self.n_cols)
+		self._spks = np.frombuffer(buf,SPIKE_DTYPE,spk_cap,spk_off)
+		self._rec_next = 0 if from_start else int(self._rec_seq[0])//2
+		self._spk_next = 0 if from_start else int(self._spk_seq[0])//2
+		self.lost_records = 0
+		self.lost_spikes = 0
+
+	@property
+	def finished(self):
+		return self._state[0] != 0
+
+	def _read(self,seq,ring,nxt):
+		#Same checks as ShmReader::read_ring: copy the slots, then drop those started again during the copy.
+		cap = len(ring)
+		done = int(seq[0])//2
+		first = max(nxt,done-cap)
+		idx = np.arange(first,done)%cap
+		out = ring[idx].copy()
+		started = (int(seq[0])+1)//2
+		kept = min(max(first,started-cap),done)
+		return out[kept-first:],kept-nxt,done
+
+	def read_records(self):
+		out,lost,self._rec_next = self._read(self._rec_seq,self._recs,self._rec_next)
+		self.lost_records += lost
+		return out
+
+	def read_spikes(self):
+		out,lost,self._spk_next = self._read(self._spk_seq,self._spks,self._spk_next)
+		self.lost_spikes += lost
+		return out
+
+	def close(self):
+		self._state = self._rec_seq = self._spk_seq = self._recs = self._spks = None
+		self._map.close()
+
+
+if __name__ == '__main__':
+	if len(sys.argv) < 2:
+		print('Usage: python3 shm_reader.py name [seconds]')
+		sys.exit(-1)
+	import matplotlib.pyplot as plt
+
+	window = float(sys.argv[2])*1000 if len(sys.argv) > 2 else 5000.0
+	r = ShmReader(sys.argv[1])
+	names = r.columns[1:-1]
+	data = np.empty((0,r.n_cols))
+
+	fig,axes = plt.subplots(len(names),1,sharex=True,squeeze=False)
+	lines = [ax[0].plot([],[])[0] for ax in axes]
+	for ax,name in zip(axes,names):
+		ax[0].set_ylabel(name)
+		ax[0].set_ylim(-90,50)
+	axes[-1][0].set_xlabel('Time (ms)')
+	plt.ion()
+	plt.show()
+
+	while not r.finished and plt.fignum_exists(fig.number):
+		new = r.read_records()
+		if len(new):
+			data = np.vstack((data,new))
+			data = data[data[:,0] > data[-1,0]-window]
+			for j,line in enumerate(lines):
+				line.set_data(data[:,0],data[:,j+1])
+			axes[-1][0].set_xlim(data[0,0],max(data[-1,0],data[0,0]+1))
+		plt.pause(0.1)
+	if r.lost_records:
+		print('Warning: %d records overwritten before they were read'%r.lost_records)